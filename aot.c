@@ -0,0 +1,840 @@
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <dlfcn.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+#include "aot.h"
+#include "heap.h"
+
+/* Changes whenever the interface below or the values of Operation do. */
+#define AOT_VERSION 2
+
+#define STRINGIFY(...) #__VA_ARGS__
+#define EXPAND_STRINGIFY(...) STRINGIFY(__VA_ARGS__)
+
+/* What a module and lox agree on. It is compiled here and pasted into
+ * every module, so the two cannot drift apart. */
+#define AOT_INTERFACE                                                   \
+    typedef struct {                                                    \
+        void *(*arg)(void *env, size_t slot, int line);                 \
+        int (*arg_kind)(void *env, size_t slot);                        \
+        double (*arg_number)(void *env, size_t slot);                   \
+        int (*arg_bool)(void *env, size_t slot);                        \
+        void *(*number)(double value);                                  \
+        void *(*boolean)(int value);                                    \
+        int (*condition)(int operation, void *condition);               \
+        void *(*unary)(int operation, void *right);                     \
+        void *(*binary)(int operation, void *left, void *right);        \
+        void (*push)(void *obj);                                        \
+        void *(*pop)(void);                                             \
+    } LoxAotRuntime;                                                    \
+                                                                        \
+    typedef struct {                                                    \
+        int type;                                                       \
+        uint64_t bits;                                                  \
+        const char *chars;                                              \
+        size_t len;                                                     \
+    } LoxAotConstant;
+
+AOT_INTERFACE
+
+typedef void *(*AotEval)(const LoxAotRuntime *rt, void *env, void *const *k);
+
+extern char **environ;
+
+struct AotModule {
+    void *handle;
+    AotEval eval;
+    Object *constants;
+    void **pointers;
+    size_t n_constants;
+};
+
+typedef enum {
+    VALUE_OBJECT,
+    VALUE_NUMBER,
+    VALUE_BOOL
+} ValueKind;
+
+/* The temporary the emitted code leaves a value in. A literal is
+ * remembered so that boxing it takes a constant instead of an
+ * allocation. */
+typedef struct {
+    ValueKind kind;
+    size_t temp;
+    Literal *literal;
+} Value;
+
+/* Guesses, for every parameter, whether it is used as a number or as a
+ * boolean, from what its parents do with it. A parameter used both ways,
+ * or in neither, gets no guess. Also notes whether the source is a
+ * Script, with functions or classes, which are not compiled. */
+typedef struct {
+    ExprVisitor base;
+    int want;
+    int *hints;
+    size_t n_hints;
+    bool functions;
+} Hinter;
+
+#define HINT_NONE (-1)
+
+typedef struct {
+    ExprVisitor base;
+    FILE *out;
+    Value value;
+
+    /* When set, the parameters guessed native are read as such. */
+    const int *hints;
+    size_t n_hints;
+
+    ValueKind *temps;
+    size_t n_temps;
+    size_t temps_cap;
+
+    Literal **constants;
+    size_t n_constants;
+    size_t constants_cap;
+
+    /* Objects on the heap's stack at this point of the emitted code, which
+     * a failure has to pop. */
+    size_t depth;
+} Emitter;
+
+static const char prefixes[] = { [VALUE_OBJECT] = 'o', [VALUE_NUMBER] = 'n', [VALUE_BOOL] = 'b' };
+
+/* ---- RUNTIME ---- */
+
+static void *runtimeArg(void *env, size_t slot, int line) {
+    return InterpreterArgument(env, slot, line);
+}
+
+static int runtimeArgKind(void *env, size_t slot) {
+    Interpreter *i = env;
+
+    if (slot >= i->n_args)
+        return VALUE_OBJECT;
+
+    switch (i->args[slot].type) {
+    case OBJECT_NUMBER: return VALUE_NUMBER;
+    case OBJECT_BOOL: return VALUE_BOOL;
+    default: return VALUE_OBJECT;
+    }
+}
+
+static double runtimeArgNumber(void *env, size_t slot) {
+    return ((Interpreter*)env)->args[slot].value.f;
+}
+
+static int runtimeArgBool(void *env, size_t slot) {
+    return ((Interpreter*)env)->args[slot].value.b;
+}
+
+static void *runtimeNumber(double value) {
+    return ObjectNum(value);
+}
+
+static void *runtimeBoolean(int value) {
+    return ObjectBool(value);
+}
+
+static int runtimeCondition(int operation, void *condition) {
+    bool value;
+    return InterpreterCondition((Operation)operation, condition, &value) ? value : -1;
+}
+
+static void *runtimeUnary(int operation, void *right) {
+    return InterpreterUnary((Operation)operation, right);
+}
+
+static void *runtimeBinary(int operation, void *left, void *right) {
+    return InterpreterBinary((Operation)operation, left, right);
+}
+
+static void runtimePush(void *obj) {
+    HeapPush(obj);
+}
+
+static void *runtimePop(void) {
+    return HeapPop();
+}
+
+static const LoxAotRuntime runtime = {
+    .arg = runtimeArg,
+    .arg_kind = runtimeArgKind,
+    .arg_number = runtimeArgNumber,
+    .arg_bool = runtimeArgBool,
+    .number = runtimeNumber,
+    .boolean = runtimeBoolean,
+    .condition = runtimeCondition,
+    .unary = runtimeUnary,
+    .binary = runtimeBinary,
+    .push = runtimePush,
+    .pop = runtimePop
+};
+
+/* ---- HELPER FUNCTIONS ---- */
+
+static Value emit(Emitter *e, Expr *expr) {
+    expr->accept(&e->base, expr);
+    return e->value;
+}
+
+static void *produce(Emitter *e, ValueKind kind, size_t temp, Literal *literal) {
+    e->value = (Value){ .kind = kind, .temp = temp, .literal = literal };
+    return NULL;
+}
+
+static size_t newTemp(Emitter *e, ValueKind kind) {
+    if (e->n_temps == e->temps_cap) {
+        e->temps_cap = e->temps_cap ? e->temps_cap * 2 : 64;
+        e->temps = realloc(e->temps, e->temps_cap * sizeof(ValueKind));
+    }
+
+    e->temps[e->n_temps] = kind;
+    return e->n_temps++;
+}
+
+static size_t newConstant(Emitter *e, Literal *l) {
+    if (e->n_constants == e->constants_cap) {
+        e->constants_cap = e->constants_cap ? e->constants_cap * 2 : 16;
+        e->constants = realloc(e->constants, e->constants_cap * sizeof(Literal*));
+    }
+
+    e->constants[e->n_constants] = l;
+    return e->n_constants++;
+}
+
+/* Emits a check that bails out when the evaluator reported an error. */
+static void check(Emitter *e, size_t temp) {
+    fprintf(e->out, "    if (o%zu == NULL) return fail(rt, %zu);\n", temp, e->depth);
+}
+
+/* Gives the object temporary holding v, boxing it if it is native. */
+static size_t box(Emitter *e, Value v) {
+    if (v.kind == VALUE_OBJECT)
+        return v.temp;
+
+    size_t temp = newTemp(e, VALUE_OBJECT);
+
+    if (v.literal != NULL)
+        fprintf(e->out, "    o%zu = k[%zu];\n", temp, newConstant(e, v.literal));
+    else if (v.kind == VALUE_NUMBER)
+        fprintf(e->out, "    o%zu = rt->number(n%zu);\n", temp, v.temp);
+    else
+        fprintf(e->out, "    o%zu = rt->boolean(b%zu);\n", temp, v.temp);
+
+    return temp;
+}
+
+/* Literals box to constants and booleans to the shared ones; only
+ * computed numbers take an allocation. */
+static inline bool boxAllocates(Value v) {
+    return v.kind == VALUE_NUMBER && v.literal == NULL;
+}
+
+static void push(Emitter *e, size_t temp) {
+    fprintf(e->out, "    rt->push(o%zu);\n", temp);
+}
+
+static void pop(Emitter *e, size_t temp) {
+    fprintf(e->out, "    o%zu = rt->pop();\n", temp);
+}
+
+static const char *cOperator(Operation operation) {
+    switch (operation) {
+    case OPER_ADD: return "+";
+    case OPER_SUB: return "-";
+    case OPER_MUL: return "*";
+    case OPER_DIV: return "/";
+    case OPER_EQUAL: return "==";
+    case OPER_NOT_EQUAL: return "!=";
+    case OPER_LESS: return "<";
+    case OPER_LESS_EQUAL: return "<=";
+    case OPER_GREATER: return ">";
+    case OPER_GREATER_EQUAL: return ">=";
+    default: return NULL;
+    }
+}
+
+static void writeString(FILE *out, const char *chars, size_t len) {
+    fputc('"', out);
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = chars[i];
+
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == ' ')
+            fputc(c, out);
+        else
+            fprintf(out, "\\%03o", c);
+    }
+    fputc('"', out);
+}
+
+static uint64_t bitsOf(double value) {
+    uint64_t retval;
+    memcpy(&retval, &value, sizeof(retval));
+    return retval;
+}
+
+/* ---- ExprVisitorS ---- */
+
+static void *visitLiteralExpr(ExprVisitor *v, Literal *l) {
+    Emitter *e = (Emitter*)v;
+    Object *obj = &l->object;
+    size_t temp;
+
+    switch (obj->type) {
+    case OBJECT_NUMBER:
+        temp = newTemp(e, VALUE_NUMBER);
+        fprintf(e->out, "    n%zu = bits(UINT64_C(0x%016" PRIx64 "));\n", temp, bitsOf(obj->value.f));
+        return produce(e, VALUE_NUMBER, temp, l);
+    case OBJECT_BOOL:
+        temp = newTemp(e, VALUE_BOOL);
+        fprintf(e->out, "    b%zu = %d;\n", temp, obj->value.b);
+        return produce(e, VALUE_BOOL, temp, l);
+    default:
+        temp = newTemp(e, VALUE_OBJECT);
+        fprintf(e->out, "    o%zu = k[%zu];\n", temp, newConstant(e, l));
+        return produce(e, VALUE_OBJECT, temp, NULL);
+    }
+}
+
+static void *visitVariableExpr(ExprVisitor *v, Variable *var) {
+    Emitter *e = (Emitter*)v;
+    int hint = e->hints != NULL && var->slot < e->n_hints ? e->hints[var->slot] : HINT_NONE;
+    size_t temp;
+
+    if (hint == VALUE_NUMBER || hint == VALUE_BOOL) {
+        temp = newTemp(e, hint);
+        fprintf(e->out, "    %c%zu = v%c[%zu];\n", prefixes[hint], temp, prefixes[hint], var->slot);
+        return produce(e, hint, temp, NULL);
+    }
+
+    temp = newTemp(e, VALUE_OBJECT);
+
+    fprintf(e->out, "    o%zu = rt->arg(env, %zu, %d);\n", temp, var->slot, var->base.line);
+    check(e, temp);
+    return produce(e, VALUE_OBJECT, temp, NULL);
+}
+
+static void *visitGroupingExpr(ExprVisitor *v, Grouping *g) {
+    return g->expr->accept(v, g->expr);
+}
+
+static void *visitUnaryExpr(ExprVisitor *v, Unary *u) {
+    Emitter *e = (Emitter*)v;
+    Value right = emit(e, u->right);
+    size_t temp;
+
+    if (u->operation == OPER_NEGATE && right.kind == VALUE_NUMBER) {
+        temp = newTemp(e, VALUE_NUMBER);
+        fprintf(e->out, "    n%zu = -n%zu;\n", temp, right.temp);
+        return produce(e, VALUE_NUMBER, temp, NULL);
+    }
+
+    if (u->operation == OPER_BOOL_NOT && right.kind == VALUE_BOOL) {
+        temp = newTemp(e, VALUE_BOOL);
+        fprintf(e->out, "    b%zu = !b%zu;\n", temp, right.temp);
+        return produce(e, VALUE_BOOL, temp, NULL);
+    }
+
+    size_t obj = box(e, right);
+    temp = newTemp(e, VALUE_OBJECT);
+    fprintf(e->out, "    o%zu = rt->unary(%d, o%zu);\n", temp, u->operation, obj);
+    check(e, temp);
+    return produce(e, VALUE_OBJECT, temp, NULL);
+}
+
+/*
+ * Native operands are combined in C. Otherwise both are boxed and handed
+ * to the evaluator, keeping an object on the heap's stack whenever
+ * something that may allocate runs while it is held, as the evaluator
+ * does.
+ */
+static void *visitBinaryExpr(ExprVisitor *v, Binary *b) {
+    Emitter *e = (Emitter*)v;
+    Value left = emit(e, b->left);
+
+    /* The left operand only matters for its errors, which it has already
+     * bailed out on. */
+    if (b->operation == OPER_COMMA)
+        return b->right->accept(v, b->right);
+
+    if (left.kind == VALUE_OBJECT) {
+        push(e, left.temp);
+        e->depth++;
+    }
+
+    Value right = emit(e, b->right);
+
+    if (left.kind == VALUE_OBJECT) {
+        e->depth--;
+        pop(e, left.temp);
+    }
+
+    bool equality = b->operation == OPER_EQUAL || b->operation == OPER_NOT_EQUAL;
+    size_t temp;
+
+    if (left.kind == VALUE_NUMBER && right.kind == VALUE_NUMBER) {
+        bool arithmetic = b->operation == OPER_ADD || b->operation == OPER_SUB ||
+                          b->operation == OPER_MUL || b->operation == OPER_DIV;
+        ValueKind kind = arithmetic ? VALUE_NUMBER : VALUE_BOOL;
+
+        temp = newTemp(e, kind);
+        fprintf(e->out, "    %c%zu = n%zu %s n%zu;\n", prefixes[kind], temp, left.temp,
+                cOperator(b->operation), right.temp);
+        return produce(e, kind, temp, NULL);
+    }
+
+    if (left.kind == VALUE_BOOL && right.kind == VALUE_BOOL && equality) {
+        temp = newTemp(e, VALUE_BOOL);
+        fprintf(e->out, "    b%zu = b%zu %s b%zu;\n", temp, left.temp,
+                cOperator(b->operation), right.temp);
+        return produce(e, VALUE_BOOL, temp, NULL);
+    }
+
+    /* A number and a boolean are never equal. */
+    if (left.kind != VALUE_OBJECT && right.kind != VALUE_OBJECT && equality) {
+        temp = newTemp(e, VALUE_BOOL);
+        fprintf(e->out, "    b%zu = %d;\n", temp, b->operation == OPER_NOT_EQUAL);
+        return produce(e, VALUE_BOOL, temp, NULL);
+    }
+
+    size_t l, r;
+
+    if (left.kind == VALUE_OBJECT && right.kind == VALUE_OBJECT) {
+        l = left.temp;
+        r = right.temp;
+    } else if (left.kind == VALUE_OBJECT) {
+        l = left.temp;
+        if (boxAllocates(right))
+            push(e, l);
+        r = box(e, right);
+        if (boxAllocates(right))
+            pop(e, l);
+    } else if (right.kind == VALUE_OBJECT) {
+        r = right.temp;
+        if (boxAllocates(left))
+            push(e, r);
+        l = box(e, left);
+        if (boxAllocates(left))
+            pop(e, r);
+    } else {
+        l = box(e, left);
+        if (boxAllocates(right))
+            push(e, l);
+        r = box(e, right);
+        if (boxAllocates(right))
+            pop(e, l);
+    }
+
+    temp = newTemp(e, VALUE_OBJECT);
+    fprintf(e->out, "    o%zu = rt->binary(%d, o%zu, o%zu);\n", temp, b->operation, l, r);
+    check(e, temp);
+    return produce(e, VALUE_OBJECT, temp, NULL);
+}
+
+/* Each branch is emitted on its own first, as only once both are known can
+ * it be said whether the result stays native. */
+static void *visitTertiaryExpr(ExprVisitor *v, Tertiary *t) {
+    Emitter *e = (Emitter*)v;
+    Value condition = emit(e, t->condition);
+    size_t test = condition.temp;
+
+    if (condition.kind != VALUE_BOOL) {
+        size_t obj = box(e, condition);
+        test = newTemp(e, VALUE_BOOL);
+        fprintf(e->out, "    b%zu = rt->condition(%d, o%zu);\n", test, OPER_COMMA, obj);
+        fprintf(e->out, "    if (b%zu < 0) return fail(rt, %zu);\n", test, e->depth);
+    }
+
+    FILE *out = e->out;
+    Expr *branches[2] = { t->ifTrue, t->ifFalse };
+    Value values[2];
+    char *text[2];
+    size_t len[2];
+    FILE *streams[2];
+
+    for (size_t i = 0; i < 2; i++) {
+        e->out = streams[i] = open_memstream(&text[i], &len[i]);
+        values[i] = emit(e, branches[i]);
+    }
+
+    ValueKind kind = values[0].kind == values[1].kind ? values[0].kind : VALUE_OBJECT;
+    size_t temp = newTemp(e, kind);
+
+    for (size_t i = 0; i < 2; i++) {
+        e->out = streams[i];
+        size_t from = kind == VALUE_OBJECT ? box(e, values[i]) : values[i].temp;
+        fprintf(e->out, "    %c%zu = %c%zu;\n", prefixes[kind], temp, prefixes[kind], from);
+        fclose(streams[i]);
+    }
+
+    e->out = out;
+    fprintf(out, "    if (b%zu) {\n%s    } else {\n%s    }\n", test, text[0], text[1]);
+    free(text[0]);
+    free(text[1]);
+
+    return produce(e, kind, temp, NULL);
+}
+
+/* A chain is a run of tests into one result, each jumping past the rest
+ * once it decides the whole. */
+static void *visitLogicalExpr(ExprVisitor *v, Logical *l) {
+    Emitter *e = (Emitter*)v;
+    size_t temp = newTemp(e, VALUE_BOOL);
+
+    for (size_t i = 0; i < l->n_operands; i++) {
+        Value operand = emit(e, l->operands[i]);
+        size_t test = operand.temp;
+
+        if (operand.kind != VALUE_BOOL) {
+            size_t obj = box(e, operand);
+            test = newTemp(e, VALUE_BOOL);
+            fprintf(e->out, "    b%zu = rt->condition(%d, o%zu);\n", test, l->operation, obj);
+            fprintf(e->out, "    if (b%zu < 0) return fail(rt, %zu);\n", test, e->depth);
+        }
+
+        fprintf(e->out, "    b%zu = b%zu;\n", temp, test);
+        if (i + 1 < l->n_operands)
+            fprintf(e->out, "    if (%sb%zu) goto d%zu;\n",
+                    l->operation == OPER_AND ? "!" : "", temp, temp);
+    }
+
+    fprintf(e->out, "d%zu:;\n", temp);
+    return produce(e, VALUE_BOOL, temp, NULL);
+}
+
+/* ---- HINTERS ---- */
+
+static void hint(ExprVisitor *v, Expr *expr, int want) {
+    ((Hinter*)v)->want = want;
+    expr->accept(v, expr);
+}
+
+static void *hintBinary(ExprVisitor *v, Binary *b) {
+    int want = ((Hinter*)v)->want;
+
+    switch (b->operation) {
+    case OPER_COMMA:
+        hint(v, b->left, HINT_NONE);
+        hint(v, b->right, want);
+        break;
+    case OPER_EQUAL:
+    case OPER_NOT_EQUAL:
+        hint(v, b->left, HINT_NONE);
+        hint(v, b->right, HINT_NONE);
+        break;
+    default:
+        hint(v, b->left, VALUE_NUMBER);
+        hint(v, b->right, VALUE_NUMBER);
+        break;
+    }
+
+    return NULL;
+}
+
+static void *hintTertiary(ExprVisitor *v, Tertiary *t) {
+    int want = ((Hinter*)v)->want;
+
+    hint(v, t->condition, VALUE_BOOL);
+    hint(v, t->ifTrue, want);
+    hint(v, t->ifFalse, want);
+    return NULL;
+}
+
+static void *hintLogical(ExprVisitor *v, Logical *l) {
+    for (size_t i = 0; i < l->n_operands; i++)
+        hint(v, l->operands[i], VALUE_BOOL);
+    return NULL;
+}
+
+static void *hintGrouping(ExprVisitor *v, Grouping *g) {
+    hint(v, g->expr, ((Hinter*)v)->want);
+    return NULL;
+}
+
+static void *hintLiteral(ExprVisitor *v, Literal *l) {
+    return NULL;
+}
+
+static void *hintUnary(ExprVisitor *v, Unary *u) {
+    hint(v, u->right, u->operation == OPER_NEGATE ? VALUE_NUMBER : VALUE_BOOL);
+    return NULL;
+}
+
+static void *hintVariable(ExprVisitor *v, Variable *var) {
+    Hinter *h = (Hinter*)v;
+
+    if (h->want == HINT_NONE)
+        return NULL;
+
+    if (var->slot >= h->n_hints) {
+        h->hints = realloc(h->hints, (var->slot + 1) * sizeof(int));
+        for (size_t i = h->n_hints; i <= var->slot; i++)
+            h->hints[i] = HINT_NONE;
+        h->n_hints = var->slot + 1;
+    }
+
+    int *slot = &h->hints[var->slot];
+    *slot = *slot == HINT_NONE || *slot == h->want ? h->want : VALUE_OBJECT;
+    return NULL;
+}
+
+static void *hintCall(ExprVisitor *v, Call *c) {
+    ((Hinter*)v)->functions = true;
+    return NULL;
+}
+
+static void *hintScript(ExprVisitor *v, Script *s) {
+    ((Hinter*)v)->functions = true;
+    return NULL;
+}
+
+/* Writes a function evaluating expr, in the mode e is set up for. */
+static void emitFunction(Emitter *e, Expr *expr, const char *signature, FILE *out) {
+    char *body;
+    size_t len;
+
+    e->n_temps = 0;
+    e->depth = 0;
+    e->out = open_memstream(&body, &len);
+    size_t result = box(e, emit(e, expr));
+    fclose(e->out);
+
+    fprintf(out, "%s {\n", signature);
+    for (size_t i = 0; i < e->n_temps; i++) {
+        const char *type = e->temps[i] == VALUE_OBJECT ? "void *" :
+                           e->temps[i] == VALUE_NUMBER ? "double " : "int ";
+        fprintf(out, "    %s%c%zu;\n", type, prefixes[e->temps[i]], i);
+    }
+    fprintf(out, "\n%s    return o%zu;\n}\n\n", body, result);
+
+    free(body);
+}
+
+static bool build(const char *source, const char *target) {
+    const char *cc = getenv("CC");
+    char *argv[] = {
+        (char*)(cc != NULL && *cc != '\0' ? cc : "cc"), "-shared", "-fPIC", "-O2",
+        "-ffp-contract=off", "-o", (char*)target, (char*)source, NULL
+    };
+    pid_t pid;
+    int status;
+
+    if (posix_spawnp(&pid, argv[0], NULL, NULL, argv, environ) != 0)
+        return false;
+
+    return waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/* ---- MAIN METHODS ---- */
+
+/*
+ * Two versions are written when some parameters look like numbers or
+ * booleans: one that reads them as such, and one that makes no guesses.
+ * Which runs is decided from the arguments on every call.
+ */
+bool AotEmit(Expr *expr, uint64_t hash, FILE *out) {
+    Hinter h = {
+        .base = (ExprVisitor){
+            .visitBinaryExpr = hintBinary,
+            .visitTertiaryExpr = hintTertiary,
+            .visitLogicalExpr = hintLogical,
+            .visitGroupingExpr = hintGrouping,
+            .visitLiteralExpr = hintLiteral,
+            .visitUnaryExpr = hintUnary,
+            .visitVariableExpr = hintVariable,
+            .visitCallExpr = hintCall,
+            .visitScriptExpr = hintScript
+        }
+    };
+    Emitter e = {
+        .base = (ExprVisitor){
+            .visitBinaryExpr = visitBinaryExpr,
+            .visitTertiaryExpr = visitTertiaryExpr,
+            .visitLogicalExpr = visitLogicalExpr,
+            .visitGroupingExpr = visitGroupingExpr,
+            .visitLiteralExpr = visitLiteralExpr,
+            .visitUnaryExpr = visitUnaryExpr,
+            .visitVariableExpr = visitVariableExpr
+        }
+    };
+    char *code;
+    size_t len;
+    bool guessed = false;
+
+    hint(&h.base, expr, HINT_NONE);
+    if (h.functions) {
+        free(h.hints);
+        return false;
+    }
+
+    for (size_t i = 0; i < h.n_hints; i++)
+        guessed |= h.hints[i] == VALUE_NUMBER || h.hints[i] == VALUE_BOOL;
+
+    FILE *functions = open_memstream(&code, &len);
+    emitFunction(&e, expr, "static void *generic(const LoxAotRuntime *rt, void *env, "
+                           "void *const *k)", functions);
+
+    if (guessed) {
+        e.hints = h.hints;
+        e.n_hints = h.n_hints;
+        emitFunction(&e, expr, "static inline void *native(const LoxAotRuntime *rt, void *env, "
+                               "void *const *k, const double *vn, const int *vb)", functions);
+    }
+    fclose(functions);
+
+    fprintf(out, "/* Generated by lox --aot. Do not edit. */\n\n");
+    fprintf(out, "#include <stddef.h>\n#include <stdint.h>\n#include <string.h>\n\n");
+    fprintf(out, "%s\n\n", EXPAND_STRINGIFY(AOT_INTERFACE));
+    fprintf(out, "const unsigned lox_aot_version = %d;\n", AOT_VERSION);
+    fprintf(out, "const uint64_t lox_aot_hash = UINT64_C(0x%016" PRIx64 ");\n", hash);
+    fprintf(out, "const size_t lox_aot_n_constants = %zu;\n", e.n_constants);
+    fprintf(out, "const LoxAotConstant lox_aot_constants[] = {\n");
+
+    for (size_t i = 0; i < e.n_constants; i++) {
+        Object *obj = &e.constants[i]->object;
+        uint64_t bits = obj->type == OBJECT_NUMBER ? bitsOf(obj->value.f) :
+                        obj->type == OBJECT_BOOL ? obj->value.b : 0;
+
+        fprintf(out, "    { %d, UINT64_C(0x%016" PRIx64 "), ", obj->type, bits);
+        if (obj->type == OBJECT_STRING)
+            writeString(out, ObjectStrChars(obj), ObjectStrLen(obj));
+        else
+            fprintf(out, "NULL");
+        fprintf(out, ", %zu },\n", obj->type == OBJECT_STRING ? (size_t)ObjectStrLen(obj) : 0);
+    }
+
+    fprintf(out, "    { 0 }\n};\n\n");
+    fprintf(out, "static inline double bits(uint64_t b) {\n"
+                 "    double d;\n    memcpy(&d, &b, sizeof(d));\n    return d;\n}\n\n");
+    fprintf(out, "static void *fail(const LoxAotRuntime *rt, size_t depth) {\n"
+                 "    while (depth-- > 0)\n        rt->pop();\n    return NULL;\n}\n\n");
+    fprintf(out, "%s", code);
+    fprintf(out, "void *lox_aot_eval(const LoxAotRuntime *rt, void *env, void *const *k) {\n");
+
+    if (guessed) {
+        fprintf(out, "    double vn[%zu];\n    int vb[%zu];\n\n", h.n_hints, h.n_hints);
+
+        for (size_t i = 0; i < h.n_hints; i++) {
+            int kind = h.hints[i];
+            if (kind != VALUE_NUMBER && kind != VALUE_BOOL)
+                continue;
+
+            fprintf(out, "    if (rt->arg_kind(env, %zu) != %d)\n"
+                         "        return generic(rt, env, k);\n", i, kind);
+            fprintf(out, "    v%c[%zu] = rt->arg_%s(env, %zu);\n", prefixes[kind], i,
+                    kind == VALUE_NUMBER ? "number" : "bool", i);
+        }
+
+        fprintf(out, "\n    return native(rt, env, k, vn, vb);\n}\n");
+    } else {
+        fprintf(out, "    return generic(rt, env, k);\n}\n");
+    }
+
+    free(code);
+    free(h.hints);
+    free(e.temps);
+    free(e.constants);
+    return true;
+}
+
+AotModule *AotCompile(Expr *expr, uint64_t hash, const char *path) {
+    size_t len = strlen(path);
+    char *source = malloc(len + sizeof(".c"));
+    char *target = malloc(len + sizeof(".tmp"));
+    bool built = false;
+
+    sprintf(source, "%s.c", path);
+    sprintf(target, "%s.tmp", path);
+
+    FILE *f = fopen(source, "w");
+    if (f != NULL) {
+        bool emitted = AotEmit(expr, hash, f);
+        fclose(f);
+
+        /* Renamed into place, so that nobody loads half a module. */
+        built = emitted && build(source, target) && rename(target, path) == 0;
+        remove(source);
+        if (!built)
+            remove(target);
+    }
+
+    free(source);
+    free(target);
+    return built ? AotLoad(path, hash) : NULL;
+}
+
+AotModule *AotLoad(const char *path, uint64_t hash) {
+    /* Without a slash dlopen would search the library path instead. */
+    char *name = malloc(strlen(path) + 3);
+    sprintf(name, "%s%s", strchr(path, '/') != NULL ? "" : "./", path);
+
+    void *handle = dlopen(name, RTLD_NOW | RTLD_LOCAL);
+    free(name);
+    if (handle == NULL)
+        return NULL;
+
+    const unsigned *version = dlsym(handle, "lox_aot_version");
+    const uint64_t *built = dlsym(handle, "lox_aot_hash");
+    const size_t *n_constants = dlsym(handle, "lox_aot_n_constants");
+    const LoxAotConstant *constants = dlsym(handle, "lox_aot_constants");
+    AotEval eval = (AotEval)dlsym(handle, "lox_aot_eval");
+
+    if (version == NULL || built == NULL || n_constants == NULL || constants == NULL ||
+        eval == NULL || *version != AOT_VERSION || *built != hash) {
+        dlclose(handle);
+        return NULL;
+    }
+
+    AotModule *retval = malloc(sizeof(AotModule));
+    *retval = (AotModule){
+        .handle = handle,
+        .eval = eval,
+        .constants = malloc((*n_constants + 1) * sizeof(Object)),
+        .pointers = malloc((*n_constants + 1) * sizeof(void*)),
+        .n_constants = *n_constants
+    };
+
+    for (size_t i = 0; i < retval->n_constants; i++) {
+        const LoxAotConstant *c = &constants[i];
+        double number;
+
+        switch ((ObjectType)c->type) {
+        case OBJECT_NUMBER:
+            memcpy(&number, &c->bits, sizeof(number));
+            retval->constants[i] = ObjectConstNum(number);
+            break;
+        case OBJECT_BOOL:
+            retval->constants[i] = ObjectConstBool(c->bits != 0);
+            break;
+        case OBJECT_STRING:
+            retval->constants[i] = ObjectConstStr(c->chars, c->len);
+            break;
+        default:
+            retval->constants[i] = ObjectConstNil;
+            break;
+        }
+
+        retval->pointers[i] = &retval->constants[i];
+    }
+
+    return retval;
+}
+
+Object *AotRun(AotModule *m, Interpreter *env) {
+    return m->eval(&runtime, env, m->pointers);
+}
+
+void AotUnload(AotModule *m) {
+    for (size_t i = 0; i < m->n_constants; i++)
+        ObjectStrRelease(&m->constants[i]);
+
+    dlclose(m->handle);
+    free(m->constants);
+    free(m->pointers);
+    free(m);
+}
@@ -0,0 +1,39 @@
+#ifndef AOT_H_
+#define AOT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "expr.h"
+#include "interpreter.h"
+
+/*
+ * Ahead-of-time compilation of an expression to a shared object. Operands
+ * the tree proves are numbers or booleans become plain C doubles and ints;
+ * everything else goes back into the evaluator through InterpreterUnary and
+ * friends, so values, errors and their order are exactly those of
+ * InterpreterInterpret.
+ *
+ * A module records the hash of the source it was built from, and the
+ * version of the interface it was built against, and is only loaded if
+ * both still match.
+ */
+typedef struct AotModule AotModule;
+
+/* NULL if there is no module at path, or it is stale. */
+AotModule *AotLoad(const char *path, uint64_t hash);
+
+/* Translates expr, which must be a tree rather than a DAG, and builds it
+ * into path with $CC, or cc if that is unset. NULL if it does not build. */
+AotModule *AotCompile(Expr *expr, uint64_t hash, const char *path);
+
+/* False, having written nothing, for a source that declares functions or
+ * classes, or accesses properties: those are left to the interpreter. */
+bool AotEmit(Expr *expr, uint64_t hash, FILE *out);
+
+/* Evaluates the module with the parameters bound to env. */
+Object *AotRun(AotModule *m, Interpreter *env);
+void AotUnload(AotModule *m);
+
+#endif
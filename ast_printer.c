@@ -21,6 +21,24 @@ void parenthesize(ExprVisitor *v, const char *name, int n, ...) {
     va_end(exprs);
 }
 
+static void printArgs(ExprVisitor *v, Expr **args, size_t n_args) {
+    for (size_t i = 0; i < n_args; i++) {
+        putchar(' ');
+        args[i]->accept(v, args[i]);
+    }
+}
+
+static void printFunction(ExprVisitor *v, Function *f) {
+    printf("(fun %s (", f->name);
+
+    for (size_t j = 0; j < f->arity; j++)
+        printf(j > 0 ? " %s" : "%s", f->params[j]);
+
+    printf(") ");
+    f->body->accept(v, f->body);
+    putchar(')');
+}
+
 /* ---- ExprVisitorS ---- */
 
 void *visitTertiaryExpr(ExprVisitor *v, Tertiary *t) {
@@ -28,6 +46,13 @@ void *visitTertiaryExpr(ExprVisitor *v, Tertiary *t) {
     return NULL;
 }
 
+void *visitLogicalExpr(ExprVisitor *v, Logical *l) {
+    printf("(%s", l->operation == OPER_AND ? "and" : "or");
+    printArgs(v, l->operands, l->n_operands);
+    putchar(')');
+    return NULL;
+}
+
 void *visitBinaryExpr(ExprVisitor *v, Binary *b) {
     char lexeme[3] = {0};
 
@@ -60,6 +85,9 @@ void *visitBinaryExpr(ExprVisitor *v, Binary *b) {
     case OPER_EQUAL:
         lexeme[0] = lexeme[1] = '=';
         break;
+    case OPER_COMMA:
+        lexeme[0] = ',';
+        break;
 
     default:
         break;
@@ -71,7 +99,7 @@ void *visitBinaryExpr(ExprVisitor *v, Binary *b) {
 }
 
 void *visitUnaryExpr(ExprVisitor *v, Unary *u) {
-    char lexeme[1] = {0};
+    char lexeme[2] = {0};
 
     switch (u->operation) {
     case OPER_BOOL_NOT:
@@ -95,7 +123,7 @@ void *visitGroupingExpr(ExprVisitor *v, Grouping *g) {
 }
 
 void *visitLiteralExpr(__attribute__((unused)) ExprVisitor *v, Literal *l) {
-    Object *obj = l->object;
+    Object *obj = &l->object;
     switch (obj->type) {
     case OBJECT_BOOL:
         printf("%s", obj->value.b ? "true" : "false");
@@ -107,9 +135,75 @@ void *visitLiteralExpr(__attribute__((unused)) ExprVisitor *v, Literal *l) {
         printf("%.3lf", obj->value.f);
         break;
     case OBJECT_STRING:
-        printf("'%s'", obj->value.str);
+        printf("'%s'", ObjectStrChars(obj));
+    }
+
+    return NULL;
+}
+
+void *visitVariableExpr(__attribute__((unused)) ExprVisitor *v, Variable *var) {
+    printf("%s", var->name);
+    return NULL;
+}
+
+void *visitCallExpr(ExprVisitor *v, Call *c) {
+    printf("(call %s", c->callee->name);
+    printArgs(v, c->args, c->callee->arity);
+    putchar(')');
+    return NULL;
+}
+
+void *visitNewExpr(ExprVisitor *v, New *n) {
+    printf("(new %s", n->klass->name);
+    printArgs(v, n->args, n->klass->init != NULL ? n->klass->init->arity - 1 : 0);
+    putchar(')');
+    return NULL;
+}
+
+void *visitGetExpr(ExprVisitor *v, Get *g) {
+    printf("(. ");
+    g->object->accept(v, g->object);
+    printf(" %s)", g->name);
+    return NULL;
+}
+
+void *visitSetExpr(ExprVisitor *v, Set *s) {
+    printf("(= ");
+    s->object->accept(v, s->object);
+    printf(" %s ", s->name);
+    s->value->accept(v, s->value);
+    putchar(')');
+    return NULL;
+}
+
+void *visitInvokeExpr(ExprVisitor *v, Invoke *i) {
+    printf("(invoke ");
+    i->object->accept(v, i->object);
+    printf(" %s", i->name);
+    printArgs(v, i->args, i->n_args);
+    putchar(')');
+    return NULL;
+}
+
+void *visitScriptExpr(ExprVisitor *v, Script *s) {
+    for (size_t i = 0; i < s->n_functions; i++) {
+        printFunction(v, &s->functions[i]);
+        putchar(' ');
+    }
+
+    for (size_t i = 0; i < s->n_classes; i++) {
+        Class *c = &s->classes[i];
+        printf("(class %s", c->name);
+
+        for (size_t j = 0; j < c->n_methods; j++) {
+            putchar(' ');
+            printFunction(v, &c->methods[j]);
+        }
+
+        printf(") ");
     }
 
+    s->body->accept(v, s->body);
     return NULL;
 }
 
@@ -119,10 +213,18 @@ AstPrinter AstPrinterInit() {
     return (AstPrinter){
         .base = (ExprVisitor){
             .visitTertiaryExpr = visitTertiaryExpr,
+            .visitLogicalExpr = visitLogicalExpr,
             .visitBinaryExpr = visitBinaryExpr,
             .visitUnaryExpr = visitUnaryExpr,
             .visitGroupingExpr = visitGroupingExpr,
             .visitLiteralExpr = visitLiteralExpr,
+            .visitVariableExpr = visitVariableExpr,
+            .visitCallExpr = visitCallExpr,
+            .visitNewExpr = visitNewExpr,
+            .visitGetExpr = visitGetExpr,
+            .visitSetExpr = visitSetExpr,
+            .visitInvokeExpr = visitInvokeExpr,
+            .visitScriptExpr = visitScriptExpr
         }
     };
 }
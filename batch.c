@@ -0,0 +1,304 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "batch.h"
+#include "logging.h"
+#include "lexer.h"
+#include "parser.h"
+#include "interpreter.h"
+#include "heap.h"
+#include "pool.h"
+#include "trace.h"
+#include "optimize.h"
+
+typedef struct {
+    pthread_mutex_t lock;
+    size_t lo;
+    size_t hi;
+} WorkDeque;
+
+typedef struct Batch Batch;
+
+typedef struct {
+    Batch *batch;
+    size_t id;
+    WorkDeque deque;
+    pthread_t thread;
+} Worker;
+
+struct Batch {
+    const char *source;
+    const size_t *line_starts;
+    size_t n_lines;
+    size_t n_blocks;
+    int level;
+
+    Worker *workers;
+    size_t n_workers;
+
+    /* The reorder buffer: one result per line, released a block at a time. */
+    char **results;
+    bool *block_done;
+    pthread_mutex_t done_lock;
+    pthread_cond_t done_cond;
+};
+
+/* ---- HELPER FUNCTIONS ---- */
+
+static double nowSeconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char *readFile(const char *path, size_t *size) {
+    FILE *f;
+    char *buffer;
+
+    if ((f = fopen(path, "rb")) == NULL)
+        return NULL;
+
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    rewind(f);
+
+    buffer = malloc(*size + 1);
+    *size = fread(buffer, sizeof(char), *size, f);
+    buffer[*size] = '\0';
+
+    fclose(f);
+    return buffer;
+}
+
+static bool isBlank(const char *str, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (str[i] != ' ' && str[i] != '\t' && str[i] != '\r')
+            return false;
+    }
+
+    return true;
+}
+
+static char *evaluateLine(Lexer *lexer, TokenList *tokens, Optimizer *optimizer,
+                          Interpreter *interpreter, const char *line, size_t len) {
+    if (isBlank(line, len))
+        return strdup("");
+
+    hadError = false;
+    tokens->len = 0;
+
+    LexerReset(lexer, line, len);
+    if (!LexerTokenizeAll(lexer, tokens))
+        return strdup("error");
+    TokenListPush(tokens, TokenEOF);
+
+    Parser parser = ParserInit(tokens->tokens);
+    Expr *expr = ParserParse(&parser);
+    if (expr == NULL)
+        return strdup("error");
+
+    expr = OptimizerRun(optimizer, expr);
+    Object *value = InterpreterInterpret(interpreter, expr);
+    char *retval = value != NULL ? ObjectToString(value) : strdup("error");
+
+    ExprFini(expr);
+    return retval;
+}
+
+static bool takeOwn(Worker *w, size_t *block) {
+    bool retval = false;
+
+    pthread_mutex_lock(&w->deque.lock);
+    if (w->deque.lo < w->deque.hi) {
+        *block = w->deque.lo++;
+        retval = true;
+    }
+    pthread_mutex_unlock(&w->deque.lock);
+
+    return retval;
+}
+
+static bool steal(Worker *w, size_t *block) {
+    Batch *b = w->batch;
+
+    for (size_t i = 1; i < b->n_workers; i++) {
+        WorkDeque *victim = &b->workers[(w->id + i) % b->n_workers].deque;
+        size_t lo, hi;
+
+        pthread_mutex_lock(&victim->lock);
+        lo = victim->lo;
+        hi = victim->hi;
+        if (lo < hi)
+            victim->hi = lo + (hi - lo) / 2;
+        pthread_mutex_unlock(&victim->lock);
+
+        if (lo >= hi)
+            continue;
+
+        /* We took [lo + (hi - lo) / 2, hi); run the first and keep the rest. */
+        size_t mid = lo + (hi - lo) / 2;
+        TRACE_INSTANT("steal", hi - mid);
+        *block = mid;
+
+        pthread_mutex_lock(&w->deque.lock);
+        w->deque.lo = mid + 1;
+        w->deque.hi = hi;
+        pthread_mutex_unlock(&w->deque.lock);
+
+        return true;
+    }
+
+    return false;
+}
+
+static void *workerMain(void *arg) {
+    Worker *w = arg;
+    Batch *b = w->batch;
+
+    Heap heap = HeapInit(HEAP_NURSERY_SIZE);
+    Lexer lexer = LexerInit(NULL, 0);
+    TokenList tokens = TokenListInit();
+    Interpreter interpreter = InterpreterInit();
+    Optimizer optimizer = OptimizerInit(b->level);
+    size_t block;
+
+    HeapSetCurrent(&heap);
+
+    if (traceEnabled) {
+        char name[32];
+        snprintf(name, sizeof(name), "batch worker %zu", w->id);
+        TraceThreadName(name);
+    }
+
+    while (takeOwn(w, &block) || steal(w, &block)) {
+        TRACE_BEGIN("block", NULL, block);
+        size_t first = block * BATCH_BLOCK_LINES;
+        size_t last = first + BATCH_BLOCK_LINES;
+        if (last > b->n_lines)
+            last = b->n_lines;
+
+        for (size_t i = first; i < last; i++) {
+            const char *line = b->source + b->line_starts[i];
+            size_t len = b->line_starts[i + 1] - b->line_starts[i];
+
+            if (len > 0 && line[len - 1] == '\n')
+                len--;
+
+            TRACE_BEGIN("expression", NULL, i + 1);
+            b->results[i] = evaluateLine(&lexer, &tokens, &optimizer, &interpreter, line, len);
+            TRACE_END("expression");
+        }
+        TRACE_END("block");
+
+        pthread_mutex_lock(&b->done_lock);
+        b->block_done[block] = true;
+        pthread_cond_broadcast(&b->done_cond);
+        pthread_mutex_unlock(&b->done_lock);
+    }
+
+    InterpreterFini(&interpreter);
+    TokenListFini(&tokens);
+    LexerFini(&lexer);
+    HeapFini(&heap);
+    PoolReleaseAll();
+    return NULL;
+}
+
+/* ---- MAIN METHODS ---- */
+
+int BatchRun(const char *path, int threads, int level, FILE *out) {
+    size_t size;
+    char *source = readFile(path, &size);
+    if (source == NULL)
+        return -1;
+
+    if (threads < 1)
+        threads = 1;
+
+    size_t n_lines = 0;
+    for (const char *p = source; p < source + size; n_lines++) {
+        const char *nl = memchr(p, '\n', source + size - p);
+        p = nl == NULL ? source + size : nl + 1;
+    }
+
+    size_t *line_starts = malloc((n_lines + 1) * sizeof(size_t));
+    const char *p = source;
+    for (size_t i = 0; i < n_lines; i++) {
+        line_starts[i] = p - source;
+        const char *nl = memchr(p, '\n', source + size - p);
+        p = nl == NULL ? source + size : nl + 1;
+    }
+    line_starts[n_lines] = size;
+
+    Batch b = {
+        .source = source,
+        .level = level,
+        .line_starts = line_starts,
+        .n_lines = n_lines,
+        .n_blocks = (n_lines + BATCH_BLOCK_LINES - 1) / BATCH_BLOCK_LINES,
+        .workers = calloc(threads, sizeof(Worker)),
+        .n_workers = threads,
+        .results = calloc(n_lines, sizeof(char*)),
+        .block_done = calloc(n_lines / BATCH_BLOCK_LINES + 1, sizeof(bool))
+    };
+    pthread_mutex_init(&b.done_lock, NULL);
+    pthread_cond_init(&b.done_cond, NULL);
+
+    double start = nowSeconds();
+
+    for (size_t i = 0; i < b.n_workers; i++) {
+        Worker *w = &b.workers[i];
+
+        w->batch = &b;
+        w->id = i;
+        w->deque.lo = b.n_blocks * i / b.n_workers;
+        w->deque.hi = b.n_blocks * (i + 1) / b.n_workers;
+        pthread_mutex_init(&w->deque.lock, NULL);
+    }
+
+    /* Any worker may steal from any other, so every deque has to exist
+     * before the first thread starts and until the last one is joined. */
+    for (size_t i = 0; i < b.n_workers; i++)
+        pthread_create(&b.workers[i].thread, NULL, workerMain, &b.workers[i]);
+
+    for (size_t block = 0; block < b.n_blocks; block++) {
+        TRACE_BEGIN("reorder wait", NULL, block);
+        pthread_mutex_lock(&b.done_lock);
+        while (!b.block_done[block])
+            pthread_cond_wait(&b.done_cond, &b.done_lock);
+        pthread_mutex_unlock(&b.done_lock);
+        TRACE_END("reorder wait");
+
+        size_t last = (block + 1) * BATCH_BLOCK_LINES;
+        if (last > n_lines)
+            last = n_lines;
+
+        for (size_t i = block * BATCH_BLOCK_LINES; i < last; i++) {
+            fputs(b.results[i], out);
+            fputc('\n', out);
+            free(b.results[i]);
+        }
+    }
+
+    for (size_t i = 0; i < b.n_workers; i++)
+        pthread_join(b.workers[i].thread, NULL);
+    for (size_t i = 0; i < b.n_workers; i++)
+        pthread_mutex_destroy(&b.workers[i].deque.lock);
+
+    double elapsed = nowSeconds() - start;
+    fprintf(stderr, "Batch: %zu expressions in %.3f s on %d threads (%.0f expressions/s)\n",
+            n_lines, elapsed, threads, elapsed > 0 ? n_lines / elapsed : 0.0);
+
+    pthread_cond_destroy(&b.done_cond);
+    pthread_mutex_destroy(&b.done_lock);
+    free(b.block_done);
+    free(b.results);
+    free(b.workers);
+    free(line_starts);
+    free(source);
+    return 0;
+}
@@ -0,0 +1,22 @@
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include <stdio.h>
+
+/* Lines are handed out to workers in blocks of this many. */
+#define BATCH_BLOCK_LINES 64
+
+/*
+ * Evaluates every line of path as an independent expression on a pool of
+ * threads and writes one result per line to out, in input order. Blank
+ * lines give blank output and lines that fail give "error".
+ *
+ * Each worker owns its lexer, interpreter, heap and pool slabs, so the only
+ * shared state is the work queues and the reorder buffer. Blocks of lines
+ * are dealt out evenly up front; a worker that runs dry steals the back
+ * half of another worker's remaining range. Every expression is optimized
+ * at level first.
+ */
+int BatchRun(const char *path, int threads, int level, FILE *out);
+
+#endif
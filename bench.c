@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "strkernel.h"
+#include "perf.h"
+
+#define BENCH_MIN_NS 100000000u
+
+typedef struct {
+    const char *name;
+    size_t len;
+    uint64_t (*run)(const char *a, const char *b, size_t len, size_t iterations);
+} Bench;
+
+static volatile uint64_t sink;
+static PerfCounters counters;
+
+/* ---- HELPER FUNCTIONS ---- */
+
+static uint64_t runEqual(const char *a, const char *b, size_t len, size_t n) {
+    uint64_t acc = 0;
+    for (size_t i = 0; i < n; i++)
+        acc += StrEqual(a, len, b, len);
+    return acc;
+}
+
+static uint64_t runEqualScalar(const char *a, const char *b, size_t len, size_t n) {
+    uint64_t acc = 0;
+    for (size_t i = 0; i < n; i++)
+        acc += StrEqualScalar(a, len, b, len);
+    return acc;
+}
+
+static uint64_t runCompare(const char *a, const char *b, size_t len, size_t n) {
+    uint64_t acc = 0;
+    for (size_t i = 0; i < n; i++)
+        acc += StrCompare(a, len, b, len);
+    return acc;
+}
+
+static uint64_t runCompareScalar(const char *a, const char *b, size_t len, size_t n) {
+    uint64_t acc = 0;
+    for (size_t i = 0; i < n; i++)
+        acc += StrCompareScalar(a, len, b, len);
+    return acc;
+}
+
+static uint64_t runHash(const char *a, const char *b, size_t len, size_t n) {
+    uint64_t acc = 0;
+    for (size_t i = 0; i < n; i++)
+        acc += StrHash(a, len);
+    return acc;
+}
+
+static uint64_t runHashScalar(const char *a, const char *b, size_t len, size_t n) {
+    uint64_t acc = 0;
+    for (size_t i = 0; i < n; i++)
+        acc += StrHashScalar(a, len);
+    return acc;
+}
+
+static const Bench benches[] = {
+    { "StrEqual",         16,   runEqual },
+    { "StrEqual",         64,   runEqual },
+    { "StrEqual",         1024, runEqual },
+    { "StrEqualScalar",   16,   runEqualScalar },
+    { "StrEqualScalar",   64,   runEqualScalar },
+    { "StrEqualScalar",   1024, runEqualScalar },
+    { "StrCompare",       16,   runCompare },
+    { "StrCompare",       64,   runCompare },
+    { "StrCompare",       1024, runCompare },
+    { "StrCompareScalar", 16,   runCompareScalar },
+    { "StrCompareScalar", 64,   runCompareScalar },
+    { "StrCompareScalar", 1024, runCompareScalar },
+    { "StrHash",          16,   runHash },
+    { "StrHash",          64,   runHash },
+    { "StrHash",          1024, runHash },
+    { "StrHashScalar",    16,   runHashScalar },
+    { "StrHashScalar",    64,   runHashScalar },
+    { "StrHashScalar",    1024, runHashScalar },
+};
+
+#define BENCH_COUNT (sizeof(benches) / sizeof(benches[0]))
+
+/* Doubles the iteration count until a run takes at least BENCH_MIN_NS.
+ * The counters of that last run are left in sample. */
+static double measure(const Bench *bench, const char *a, const char *b, size_t *iterations,
+                      PerfSample *sample) {
+    for (size_t n = 1024;; n *= 2) {
+        PerfSample start, end;
+
+        PerfRead(&counters, &start);
+        sink += bench->run(a, b, bench->len, n);
+        PerfRead(&counters, &end);
+
+        uint64_t elapsed = end.ns - start.ns;
+        if (elapsed >= BENCH_MIN_NS) {
+            *sample = (PerfSample){0};
+            PerfAccumulate(sample, &start, &end);
+            *iterations = n;
+            return (double)elapsed / n;
+        }
+    }
+}
+
+/* ---- MAIN ---- */
+
+int main(void) {
+    size_t max_len = 0;
+    for (size_t i = 0; i < BENCH_COUNT; i++) {
+        if (benches[i].len > max_len)
+            max_len = benches[i].len;
+    }
+
+    /* Equal buffers, so equality and ordering have to scan all of them. */
+    char *a = malloc(max_len);
+    char *b = malloc(max_len);
+    for (size_t i = 0; i < max_len; i++)
+        a[i] = b[i] = 'a' + i % 26;
+
+    if (StrHash(a, max_len) != StrHashScalar(a, max_len)) {
+        fprintf(stderr, "StrHash and StrHashScalar disagree.\n");
+        return 1;
+    }
+
+    counters = PerfCountersInit();
+    printf("{\n  \"kernel\": \"%s\",\n  \"benchmarks\": [\n", StrKernelName());
+
+    for (size_t i = 0; i < BENCH_COUNT; i++) {
+        size_t iterations;
+        PerfSample sample;
+        double ns = measure(&benches[i], a, b, &iterations, &sample);
+
+        printf("    { \"name\": \"%s/%zu\", \"iterations\": %zu, \"ns_per_op\": %.3f, "
+               "\"counters_per_op\": ", benches[i].name, benches[i].len, iterations, ns);
+        PerfWriteJson(&counters, &sample, iterations, stdout);
+        printf(" }%s\n", i + 1 < BENCH_COUNT ? "," : "");
+    }
+
+    printf("  ]\n}\n");
+    PerfCountersFini(&counters);
+
+    free(a);
+    free(b);
+    return 0;
+}
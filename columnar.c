@@ -0,0 +1,585 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "columnar.h"
+#include "logging.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define COLUMN_KERNEL "avx"
+#define VEC_WIDTH 4
+typedef __m256d Vec;
+#define vecLoad(p) _mm256_loadu_pd(&(p)->f)
+#define vecStore(p, v) _mm256_storeu_pd(&(p)->f, (v))
+#define vecSet(x) _mm256_set1_pd(x)
+#define vecOnes() _mm256_castsi256_pd(_mm256_set1_epi64x(-1))
+#define vecAdd _mm256_add_pd
+#define vecSub _mm256_sub_pd
+#define vecMul _mm256_mul_pd
+#define vecDiv _mm256_div_pd
+#define vecAnd _mm256_and_pd
+#define vecAndNot _mm256_andnot_pd
+#define vecOr _mm256_or_pd
+#define vecXor _mm256_xor_pd
+#define vecEq(a, b) _mm256_cmp_pd(a, b, _CMP_EQ_OQ)
+#define vecNe(a, b) _mm256_cmp_pd(a, b, _CMP_NEQ_UQ)
+#define vecLt(a, b) _mm256_cmp_pd(a, b, _CMP_LT_OQ)
+#define vecLe(a, b) _mm256_cmp_pd(a, b, _CMP_LE_OQ)
+#define vecGt(a, b) _mm256_cmp_pd(a, b, _CMP_GT_OQ)
+#define vecGe(a, b) _mm256_cmp_pd(a, b, _CMP_GE_OQ)
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define COLUMN_KERNEL "sse2"
+#define VEC_WIDTH 2
+typedef __m128d Vec;
+#define vecLoad(p) _mm_loadu_pd(&(p)->f)
+#define vecStore(p, v) _mm_storeu_pd(&(p)->f, (v))
+#define vecSet(x) _mm_set1_pd(x)
+#define vecOnes() _mm_castsi128_pd(_mm_set1_epi32(-1))
+#define vecAdd _mm_add_pd
+#define vecSub _mm_sub_pd
+#define vecMul _mm_mul_pd
+#define vecDiv _mm_div_pd
+#define vecAnd _mm_and_pd
+#define vecAndNot _mm_andnot_pd
+#define vecOr _mm_or_pd
+#define vecXor _mm_xor_pd
+#define vecEq _mm_cmpeq_pd
+#define vecNe _mm_cmpneq_pd
+#define vecLt _mm_cmplt_pd
+#define vecLe _mm_cmple_pd
+#define vecGt _mm_cmpgt_pd
+#define vecGe _mm_cmpge_pd
+#else
+#define COLUMN_KERNEL "scalar"
+#endif
+
+#define MASK_TRUE UINT64_MAX
+#define MASK(x) ((x) ? MASK_TRUE : 0)
+
+typedef enum {
+    COP_LOAD_BOOL,
+    COP_ADD,
+    COP_SUB,
+    COP_MUL,
+    COP_DIV,
+    COP_NEGATE,
+    COP_EQUAL,
+    COP_NOT_EQUAL,
+    COP_LESS,
+    COP_LESS_EQUAL,
+    COP_GREATER,
+    COP_GREATER_EQUAL,
+    COP_MASK_EQUAL,
+    COP_MASK_NOT_EQUAL,
+    COP_NOT,
+    COP_AND,
+    COP_OR,
+    COP_SELECT
+} ColumnOp;
+
+typedef struct {
+    uint32_t reg;
+    ColumnType type;
+} ColumnValue;
+
+typedef struct {
+    ExprVisitor base;
+    ColumnProgram *prog;
+    ColumnValue last;
+
+    /* Parameters and constants are read by several instructions, so only
+     * temporaries are ever handed back to the free list. */
+    bool *pinned;
+    bool *loaded;
+    uint32_t *free;
+    size_t n_free;
+    size_t regs_cap;
+} ColumnCompiler;
+
+/* ---- KERNELS ---- */
+
+#ifdef VEC_WIDTH
+#define VEC_LOOP(i, n, body) for (; i + VEC_WIDTH <= n; i += VEC_WIDTH) { body; }
+#else
+#define VEC_LOOP(i, n, body)
+#endif
+
+/* Every kernel is elementwise, so d may be the same register as a or b. */
+#define NUMBER_KERNEL(name, vop, op)                                                    \
+    static void name(ColumnLane *d, const ColumnLane *a, const ColumnLane *b, size_t n) { \
+        size_t i = 0;                                                                   \
+        VEC_LOOP(i, n, vecStore(&d[i], vop(vecLoad(&a[i]), vecLoad(&b[i]))))            \
+        for (; i < n; i++)                                                              \
+            d[i].f = a[i].f op b[i].f;                                                  \
+    }
+
+#define COMPARE_KERNEL(name, vop, op)                                                   \
+    static void name(ColumnLane *d, const ColumnLane *a, const ColumnLane *b, size_t n) { \
+        size_t i = 0;                                                                   \
+        VEC_LOOP(i, n, vecStore(&d[i], vop(vecLoad(&a[i]), vecLoad(&b[i]))))            \
+        for (; i < n; i++)                                                              \
+            d[i].m = MASK(a[i].f op b[i].f);                                            \
+    }
+
+NUMBER_KERNEL(kernelAdd, vecAdd, +)
+NUMBER_KERNEL(kernelSub, vecSub, -)
+NUMBER_KERNEL(kernelMul, vecMul, *)
+NUMBER_KERNEL(kernelDiv, vecDiv, /)
+
+COMPARE_KERNEL(kernelEqual, vecEq, ==)
+COMPARE_KERNEL(kernelNotEqual, vecNe, !=)
+COMPARE_KERNEL(kernelLess, vecLt, <)
+COMPARE_KERNEL(kernelLessEqual, vecLe, <=)
+COMPARE_KERNEL(kernelGreater, vecGt, >)
+COMPARE_KERNEL(kernelGreaterEqual, vecGe, >=)
+
+static void kernelNegate(ColumnLane *d, const ColumnLane *a, size_t n) {
+    size_t i = 0;
+    VEC_LOOP(i, n, vecStore(&d[i], vecXor(vecLoad(&a[i]), vecSet(-0.0))))
+    for (; i < n; i++)
+        d[i].f = -a[i].f;
+}
+
+static void kernelMaskEqual(ColumnLane *d, const ColumnLane *a, const ColumnLane *b, size_t n) {
+    size_t i = 0;
+    VEC_LOOP(i, n, vecStore(&d[i], vecAndNot(vecXor(vecLoad(&a[i]), vecLoad(&b[i])), vecOnes())))
+    for (; i < n; i++)
+        d[i].m = ~(a[i].m ^ b[i].m);
+}
+
+static void kernelMaskNotEqual(ColumnLane *d, const ColumnLane *a, const ColumnLane *b, size_t n) {
+    size_t i = 0;
+    VEC_LOOP(i, n, vecStore(&d[i], vecXor(vecLoad(&a[i]), vecLoad(&b[i]))))
+    for (; i < n; i++)
+        d[i].m = a[i].m ^ b[i].m;
+}
+
+static void kernelNot(ColumnLane *d, const ColumnLane *a, size_t n) {
+    size_t i = 0;
+    VEC_LOOP(i, n, vecStore(&d[i], vecXor(vecLoad(&a[i]), vecOnes())))
+    for (; i < n; i++)
+        d[i].m = ~a[i].m;
+}
+
+/* Every lane runs each operand of 'and' and 'or', so the short circuit
+ * becomes combining masks. */
+static void kernelAnd(ColumnLane *d, const ColumnLane *a, const ColumnLane *b, size_t n) {
+    size_t i = 0;
+    VEC_LOOP(i, n, vecStore(&d[i], vecAnd(vecLoad(&a[i]), vecLoad(&b[i]))))
+    for (; i < n; i++)
+        d[i].m = a[i].m & b[i].m;
+}
+
+static void kernelOr(ColumnLane *d, const ColumnLane *a, const ColumnLane *b, size_t n) {
+    size_t i = 0;
+    VEC_LOOP(i, n, vecStore(&d[i], vecOr(vecLoad(&a[i]), vecLoad(&b[i]))))
+    for (; i < n; i++)
+        d[i].m = a[i].m | b[i].m;
+}
+
+/* The masked select that replaces branching on '?:'. */
+static void kernelSelect(ColumnLane *d, const ColumnLane *mask, const ColumnLane *a,
+                         const ColumnLane *b, size_t n) {
+    size_t i = 0;
+    VEC_LOOP(i, n, {
+        Vec m = vecLoad(&mask[i]);
+        vecStore(&d[i], vecOr(vecAnd(m, vecLoad(&a[i])), vecAndNot(m, vecLoad(&b[i]))));
+    })
+    for (; i < n; i++)
+        d[i].m = (mask[i].m & a[i].m) | (~mask[i].m & b[i].m);
+}
+
+static void kernelLoadBool(ColumnLane *d, const bool *src, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        d[i].m = MASK(src[i]);
+}
+
+static void kernelStoreBool(bool *dst, const ColumnLane *src, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        dst[i] = src[i].m != 0;
+}
+
+/* ---- HELPER FUNCTIONS ---- */
+
+static uint32_t newReg(ColumnCompiler *c, bool pinned) {
+    if (!pinned && c->n_free > 0)
+        return c->free[--c->n_free];
+
+    ColumnProgram *p = c->prog;
+    if (p->n_regs == c->regs_cap) {
+        c->regs_cap *= 2;
+        c->pinned = realloc(c->pinned, c->regs_cap * sizeof(bool));
+        c->free = realloc(c->free, c->regs_cap * sizeof(uint32_t));
+    }
+
+    c->pinned[p->n_regs] = pinned;
+    return p->n_regs++;
+}
+
+static void releaseReg(ColumnCompiler *c, ColumnValue v) {
+    if (!c->pinned[v.reg])
+        c->free[c->n_free++] = v.reg;
+}
+
+static void emit(ColumnCompiler *c, ColumnOp op, uint32_t dst, uint32_t a, uint32_t b, uint32_t d) {
+    ColumnProgram *p = c->prog;
+
+    if (p->len == p->cap) {
+        p->cap = p->cap ? p->cap * 2 : 16;
+        p->code = realloc(p->code, p->cap * sizeof(ColumnInstr));
+    }
+
+    p->code[p->len++] = (ColumnInstr){ .op = op, .dst = dst, .a = a, .b = b, .c = d };
+}
+
+static void *constant(ColumnCompiler *c, ColumnType type, ColumnLane value) {
+    ColumnProgram *p = c->prog;
+
+    if (p->n_consts == p->consts_cap) {
+        p->consts_cap = p->consts_cap ? p->consts_cap * 2 : 8;
+        p->consts = realloc(p->consts, p->consts_cap * sizeof(ColumnConst));
+    }
+
+    c->last = (ColumnValue){ .reg = newReg(c, true), .type = type };
+    p->consts[p->n_consts++] = (ColumnConst){ .reg = c->last.reg, .value = value };
+    return c;
+}
+
+/* Emits an instruction whose operands die with it. */
+static void *operation(ColumnCompiler *c, ColumnOp op, ColumnType type, int n, ColumnValue *args) {
+    for (int i = 0; i < n; i++)
+        releaseReg(c, args[i]);
+
+    c->last = (ColumnValue){ .reg = newReg(c, false), .type = type };
+    emit(c, op, c->last.reg, args[0].reg, n > 1 ? args[1].reg : 0, n > 2 ? args[2].reg : 0);
+    return c;
+}
+
+static bool compile(ColumnCompiler *c, Expr *expr, ColumnValue *out) {
+    if (expr->accept(&c->base, expr) == NULL)
+        return false;
+
+    *out = c->last;
+    return true;
+}
+
+/* ---- ExprVisitorS ---- */
+
+static void *visitLiteralExpr(ExprVisitor *v, Literal *l) {
+    ColumnCompiler *c = (ColumnCompiler*)v;
+
+    switch (l->object.type) {
+    case OBJECT_NUMBER:
+        return constant(c, COLUMN_NUMBER, (ColumnLane){ .f = l->object.value.f });
+    case OBJECT_BOOL:
+        return constant(c, COLUMN_BOOL, (ColumnLane){ .m = MASK(l->object.value.b) });
+    default:
+        error(l->base.line, "Only numbers and booleans can be evaluated over columns.\n");
+        return NULL;
+    }
+}
+
+static void *visitVariableExpr(ExprVisitor *v, Variable *var) {
+    ColumnCompiler *c = (ColumnCompiler*)v;
+    ColumnType type = c->prog->params[var->slot];
+
+    if (type == COLUMN_BOOL && !c->loaded[var->slot]) {
+        emit(c, COP_LOAD_BOOL, var->slot, var->slot, 0, 0);
+        c->loaded[var->slot] = true;
+    }
+
+    c->last = (ColumnValue){ .reg = var->slot, .type = type };
+    return c;
+}
+
+static void *visitGroupingExpr(ExprVisitor *v, Grouping *g) {
+    return g->expr->accept(v, g->expr);
+}
+
+static void *visitCallExpr(ExprVisitor *v, Call *c) {
+    error(c->base.line, "Function calls cannot be evaluated over columns.\n");
+    return NULL;
+}
+
+/* Instances only exist one at a time, so none of this vectorizes. */
+static void *visitNewExpr(ExprVisitor *v, New *n) {
+    error(n->base.line, "Instances cannot be evaluated over columns.\n");
+    return NULL;
+}
+
+static void *visitGetExpr(ExprVisitor *v, Get *g) {
+    error(g->base.line, "Properties cannot be evaluated over columns.\n");
+    return NULL;
+}
+
+static void *visitSetExpr(ExprVisitor *v, Set *s) {
+    error(s->base.line, "Properties cannot be evaluated over columns.\n");
+    return NULL;
+}
+
+static void *visitInvokeExpr(ExprVisitor *v, Invoke *i) {
+    error(i->base.line, "Properties cannot be evaluated over columns.\n");
+    return NULL;
+}
+
+/* The functions themselves only matter to the calls. */
+static void *visitScriptExpr(ExprVisitor *v, Script *s) {
+    return s->body->accept(v, s->body);
+}
+
+static void *visitUnaryExpr(ExprVisitor *v, Unary *u) {
+    ColumnCompiler *c = (ColumnCompiler*)v;
+    ColumnValue right;
+
+    if (!compile(c, u->right, &right))
+        return NULL;
+
+    if (u->operation == OPER_NEGATE && right.type == COLUMN_NUMBER)
+        return operation(c, COP_NEGATE, COLUMN_NUMBER, 1, &right);
+    if (u->operation == OPER_BOOL_NOT && right.type == COLUMN_BOOL)
+        return operation(c, COP_NOT, COLUMN_BOOL, 1, &right);
+
+    error(u->base.line, u->operation == OPER_NEGATE ? "unary '-' expects a number.\n"
+                                                    : "'!' expects a boolean.\n");
+    return NULL;
+}
+
+static void *visitBinaryExpr(ExprVisitor *v, Binary *b) {
+    ColumnCompiler *c = (ColumnCompiler*)v;
+    ColumnValue args[2];
+
+    if (!compile(c, b->left, &args[0]) || !compile(c, b->right, &args[1]))
+        return NULL;
+
+    bool numbers = args[0].type == COLUMN_NUMBER && args[1].type == COLUMN_NUMBER;
+    bool same = args[0].type == args[1].type;
+
+    switch (b->operation) {
+    case OPER_COMMA:
+        releaseReg(c, args[0]);
+        c->last = args[1];
+        return c;
+
+    /* As in the interpreter, values of different types are never equal. */
+    case OPER_EQUAL:
+    case OPER_NOT_EQUAL: {
+        bool equal = b->operation == OPER_EQUAL;
+
+        if (!same) {
+            releaseReg(c, args[0]);
+            releaseReg(c, args[1]);
+            return constant(c, COLUMN_BOOL, (ColumnLane){ .m = MASK(!equal) });
+        }
+
+        if (numbers)
+            return operation(c, equal ? COP_EQUAL : COP_NOT_EQUAL, COLUMN_BOOL, 2, args);
+        return operation(c, equal ? COP_MASK_EQUAL : COP_MASK_NOT_EQUAL, COLUMN_BOOL, 2, args);
+    }
+
+    default:
+        break;
+    }
+
+    if (!numbers) {
+        error(b->base.line, "Arithmetic and comparison over columns expect numbers.\n");
+        return NULL;
+    }
+
+    switch (b->operation) {
+    case OPER_ADD:
+        return operation(c, COP_ADD, COLUMN_NUMBER, 2, args);
+    case OPER_SUB:
+        return operation(c, COP_SUB, COLUMN_NUMBER, 2, args);
+    case OPER_MUL:
+        return operation(c, COP_MUL, COLUMN_NUMBER, 2, args);
+    case OPER_DIV:
+        return operation(c, COP_DIV, COLUMN_NUMBER, 2, args);
+    case OPER_LESS:
+        return operation(c, COP_LESS, COLUMN_BOOL, 2, args);
+    case OPER_LESS_EQUAL:
+        return operation(c, COP_LESS_EQUAL, COLUMN_BOOL, 2, args);
+    case OPER_GREATER:
+        return operation(c, COP_GREATER, COLUMN_BOOL, 2, args);
+    case OPER_GREATER_EQUAL:
+        return operation(c, COP_GREATER_EQUAL, COLUMN_BOOL, 2, args);
+    default:
+        return NULL;
+    }
+}
+
+static void *visitTertiaryExpr(ExprVisitor *v, Tertiary *t) {
+    ColumnCompiler *c = (ColumnCompiler*)v;
+    ColumnValue args[3];
+
+    if (!compile(c, t->condition, &args[0]) || !compile(c, t->ifTrue, &args[1]) ||
+        !compile(c, t->ifFalse, &args[2]))
+        return NULL;
+
+    if (args[0].type != COLUMN_BOOL) {
+        error(t->base.line, "Tertiary operator expects condition to be a boolean.\n");
+        return NULL;
+    }
+
+    if (args[1].type != args[2].type) {
+        error(t->base.line, "Both arms of '?:' must have the same type over columns.\n");
+        return NULL;
+    }
+
+    return operation(c, COP_SELECT, args[1].type, 3, args);
+}
+
+static void *visitLogicalExpr(ExprVisitor *v, Logical *l) {
+    ColumnCompiler *c = (ColumnCompiler*)v;
+    ColumnOp op = l->operation == OPER_AND ? COP_AND : COP_OR;
+    ColumnValue args[2];
+
+    for (size_t i = 0; i < l->n_operands; i++) {
+        if (!compile(c, l->operands[i], &args[i > 0]))
+            return NULL;
+
+        if (args[i > 0].type != COLUMN_BOOL) {
+            error(l->base.line, l->operation == OPER_AND ? "'and' expects booleans.\n" :
+                                                           "'or' expects booleans.\n");
+            return NULL;
+        }
+
+        if (i > 0) {
+            operation(c, op, COLUMN_BOOL, 2, args);
+            args[0] = c->last;
+        }
+    }
+
+    c->last = args[0];
+    return c;
+}
+
+/* ---- MAIN METHODS ---- */
+
+bool ColumnCompile(Expr *expr, const ColumnType *params, size_t n_params, ColumnProgram *out) {
+    *out = (ColumnProgram){
+        .params = malloc((n_params ? n_params : 1) * sizeof(ColumnType)),
+        .n_params = n_params,
+        .n_regs = n_params
+    };
+    memcpy(out->params, params, n_params * sizeof(ColumnType));
+
+    ColumnCompiler c = {
+        .base = (ExprVisitor){
+            .visitBinaryExpr = visitBinaryExpr,
+            .visitGroupingExpr = visitGroupingExpr,
+            .visitLiteralExpr = visitLiteralExpr,
+            .visitTertiaryExpr = visitTertiaryExpr,
+            .visitLogicalExpr = visitLogicalExpr,
+            .visitUnaryExpr = visitUnaryExpr,
+            .visitVariableExpr = visitVariableExpr,
+            .visitCallExpr = visitCallExpr,
+            .visitNewExpr = visitNewExpr,
+            .visitGetExpr = visitGetExpr,
+            .visitSetExpr = visitSetExpr,
+            .visitInvokeExpr = visitInvokeExpr,
+            .visitScriptExpr = visitScriptExpr
+        },
+        .prog = out,
+        .regs_cap = n_params + 16,
+        .loaded = calloc(n_params ? n_params : 1, sizeof(bool))
+    };
+    c.pinned = malloc(c.regs_cap * sizeof(bool));
+    c.free = malloc(c.regs_cap * sizeof(uint32_t));
+
+    for (size_t i = 0; i < n_params; i++)
+        c.pinned[i] = true;
+
+    ColumnValue result;
+    bool ok = compile(&c, expr, &result);
+
+    free(c.pinned);
+    free(c.loaded);
+    free(c.free);
+
+    if (!ok) {
+        ColumnProgramFini(out);
+        return false;
+    }
+
+    out->result = result.reg;
+    out->result_type = result.type;
+    return true;
+}
+
+void ColumnProgramFini(ColumnProgram *p) {
+    free(p->code);
+    free(p->consts);
+    free(p->params);
+    *p = (ColumnProgram){0};
+}
+
+void ColumnRun(const ColumnProgram *p, const Column *inputs, size_t rows, Column *out) {
+    ColumnLane *storage = aligned_alloc(64, p->n_regs * COLUMN_BLOCK * sizeof(ColumnLane));
+    ColumnLane **regs = malloc(p->n_regs * sizeof(ColumnLane*));
+
+    for (size_t r = 0; r < p->n_regs; r++)
+        regs[r] = storage + r * COLUMN_BLOCK;
+
+    for (size_t i = 0; i < p->n_consts; i++) {
+        ColumnLane *reg = regs[p->consts[i].reg];
+        for (size_t j = 0; j < COLUMN_BLOCK; j++)
+            reg[j] = p->consts[i].value;
+    }
+
+    out->type = p->result_type;
+
+    for (size_t base = 0; base < rows; base += COLUMN_BLOCK) {
+        size_t n = rows - base < COLUMN_BLOCK ? rows - base : COLUMN_BLOCK;
+
+        /* Number columns are read in place. A double and a ColumnLane have
+         * the same size and the kernels only touch .f on them. */
+        for (size_t s = 0; s < p->n_params; s++) {
+            assert(inputs[s].type == p->params[s]);
+            if (p->params[s] == COLUMN_NUMBER)
+                regs[s] = (ColumnLane*)(inputs[s].data.f + base);
+        }
+
+        for (size_t pc = 0; pc < p->len; pc++) {
+            const ColumnInstr *in = &p->code[pc];
+            ColumnLane *d = regs[in->dst], *a = regs[in->a], *b = regs[in->b];
+
+            switch ((ColumnOp)in->op) {
+            case COP_LOAD_BOOL: kernelLoadBool(d, inputs[in->a].data.b + base, n); break;
+            case COP_ADD: kernelAdd(d, a, b, n); break;
+            case COP_SUB: kernelSub(d, a, b, n); break;
+            case COP_MUL: kernelMul(d, a, b, n); break;
+            case COP_DIV: kernelDiv(d, a, b, n); break;
+            case COP_NEGATE: kernelNegate(d, a, n); break;
+            case COP_EQUAL: kernelEqual(d, a, b, n); break;
+            case COP_NOT_EQUAL: kernelNotEqual(d, a, b, n); break;
+            case COP_LESS: kernelLess(d, a, b, n); break;
+            case COP_LESS_EQUAL: kernelLessEqual(d, a, b, n); break;
+            case COP_GREATER: kernelGreater(d, a, b, n); break;
+            case COP_GREATER_EQUAL: kernelGreaterEqual(d, a, b, n); break;
+            case COP_MASK_EQUAL: kernelMaskEqual(d, a, b, n); break;
+            case COP_MASK_NOT_EQUAL: kernelMaskNotEqual(d, a, b, n); break;
+            case COP_NOT: kernelNot(d, a, n); break;
+            case COP_AND: kernelAnd(d, a, b, n); break;
+            case COP_OR: kernelOr(d, a, b, n); break;
+            case COP_SELECT: kernelSelect(d, a, b, regs[in->c], n); break;
+            }
+        }
+
+        if (p->result_type == COLUMN_NUMBER) {
+            const ColumnLane *src = regs[p->result];
+            for (size_t i = 0; i < n; i++)
+                out->data.f[base + i] = src[i].f;
+        } else {
+            kernelStoreBool(out->data.b + base, regs[p->result], n);
+        }
+    }
+
+    free(regs);
+    free(storage);
+}
+
+const char *ColumnKernelName(void) {
+    return COLUMN_KERNEL;
+}
@@ -0,0 +1,88 @@
+#ifndef COLUMNAR_H_
+#define COLUMNAR_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "expr.h"
+
+/* Rows are evaluated this many at a time, so that every intermediate
+ * column stays in L1. */
+#ifndef COLUMN_BLOCK
+#define COLUMN_BLOCK 1024
+#endif
+
+typedef enum {
+    COLUMN_NUMBER,
+    COLUMN_BOOL
+} ColumnType;
+
+typedef struct {
+    ColumnType type;
+    union {
+        double *f;
+        bool *b;
+    } data;
+} Column;
+
+/* One lane of a register. Booleans are kept as all-ones / all-zeroes masks
+ * so that comparisons and selects map straight onto vector instructions. */
+typedef union {
+    double f;
+    uint64_t m;
+} ColumnLane;
+
+typedef struct {
+    uint8_t op;
+    uint32_t dst;
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+} ColumnInstr;
+
+typedef struct {
+    uint32_t reg;
+    ColumnLane value;
+} ColumnConst;
+
+/*
+ * An expression flattened into straight-line code over block-sized
+ * registers. Registers below n_params are the parameters: number columns
+ * are read in place, boolean ones are converted to masks on first use.
+ * Constants are broadcast once per run rather than once per block.
+ *
+ * A program is never modified by ColumnRun, so one can be run from many
+ * threads at once.
+ */
+typedef struct {
+    ColumnInstr *code;
+    size_t len;
+    size_t cap;
+
+    ColumnConst *consts;
+    size_t n_consts;
+    size_t consts_cap;
+
+    ColumnType *params;
+    size_t n_params;
+    size_t n_regs;
+
+    uint32_t result;
+    ColumnType result_type;
+} ColumnProgram;
+
+/* Type checks expr against the parameter types and compiles it. Strings
+ * and nil are not supported, and both arms of a '?:' are checked even
+ * though only one is taken per row. Returns false after reporting an error. */
+bool ColumnCompile(Expr *expr, const ColumnType *params, size_t n_params, ColumnProgram *out);
+void ColumnProgramFini(ColumnProgram *p);
+
+/* inputs must match the types the program was compiled with. out->data
+ * must have room for rows values of the result type, which is written to
+ * out->type. */
+void ColumnRun(const ColumnProgram *p, const Column *inputs, size_t rows, Column *out);
+
+const char *ColumnKernelName(void);
+
+#endif
@@ -0,0 +1,334 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "csv.h"
+#include "aot.h"
+#include "logging.h"
+#include "lexer.h"
+#include "object.h"
+#include "parser.h"
+#include "strkernel.h"
+#include "trace.h"
+#include "optimize.h"
+
+/* ---- HELPER FUNCTIONS ---- */
+
+static double nowSeconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char *readFile(const char *path, size_t *size) {
+    FILE *f;
+    char *buffer;
+
+    if ((f = fopen(path, "rb")) == NULL)
+        return NULL;
+
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    rewind(f);
+
+    buffer = malloc(*size + 1);
+    *size = fread(buffer, sizeof(char), *size, f);
+    buffer[*size] = '\0';
+
+    fclose(f);
+    return buffer;
+}
+
+/* Splits line in place at commas, trimming blanks around each field. */
+static size_t splitFields(char *line, char **fields, size_t max) {
+    size_t n = 0;
+
+    while (true) {
+        while (*line == ' ' || *line == '\t')
+            line++;
+
+        char *end = strchr(line, ',');
+        char *next = end != NULL ? end + 1 : NULL;
+        if (end == NULL)
+            end = line + strlen(line);
+
+        while (end > line && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+            end--;
+        *end = '\0';
+
+        if (n < max)
+            fields[n] = line;
+        n++;
+
+        if (next == NULL)
+            return n;
+        line = next;
+    }
+}
+
+static bool parseField(Column *col, size_t row, const char *field) {
+    if (col->type == COLUMN_BOOL) {
+        if (strcmp(field, "true") == 0)
+            col->data.b[row] = true;
+        else if (strcmp(field, "false") == 0)
+            col->data.b[row] = false;
+        else
+            return false;
+
+        return true;
+    }
+
+    char *end;
+    col->data.f[row] = strtod(field, &end);
+    return *field != '\0' && *end == '\0';
+}
+
+static void grow(ColumnTable *t, size_t cap) {
+    for (size_t i = 0; i < t->n_columns; i++) {
+        Column *col = &t->columns[i];
+
+        if (col->type == COLUMN_NUMBER)
+            col->data.f = realloc(col->data.f, cap * sizeof(double));
+        else
+            col->data.b = realloc(col->data.b, cap * sizeof(bool));
+    }
+}
+
+/* The columns are the module's parameters, so it is only reused for the
+ * same script over columns of the same names in the same order. */
+static uint64_t moduleHash(const char *source, size_t size, const ColumnTable *t) {
+    uint64_t retval = StrHash(source, size);
+
+    for (size_t i = 0; i < t->n_columns; i++)
+        retval = retval * 31 + StrHash(t->names[i], strlen(t->names[i]));
+
+    return retval;
+}
+
+/* Runs the module once per row, with the row bound to its parameters.
+ * False once a row fails, after the error is reported. */
+static bool runRows(AotModule *m, const ColumnTable *t, FILE *out) {
+    Heap heap = HeapInit(HEAP_NURSERY_SIZE);
+    Interpreter interpreter = InterpreterInit();
+    Object *args = malloc((t->n_columns + 1) * sizeof(Object));
+    bool retval = true;
+
+    HeapSetCurrent(&heap);
+
+    for (size_t row = 0; row < t->rows && retval; row++) {
+        for (size_t i = 0; i < t->n_columns; i++) {
+            const Column *col = &t->columns[i];
+            args[i] = col->type == COLUMN_NUMBER ? ObjectConstNum(col->data.f[row])
+                                                 : ObjectConstBool(col->data.b[row]);
+        }
+
+        InterpreterBind(&interpreter, args, t->n_columns);
+        Object *value = AotRun(m, &interpreter);
+
+        if (value != NULL) {
+            char *str = ObjectToString(value);
+            fprintf(out, "%s\n", str);
+            free(str);
+        }
+
+        retval = value != NULL;
+    }
+
+    free(args);
+    InterpreterFini(&interpreter);
+    HeapFini(&heap);
+    return retval;
+}
+
+/* ---- MAIN METHODS ---- */
+
+bool CsvLoad(const char *path, ColumnTable *out) {
+    size_t size;
+    char *source = readFile(path, &size);
+    *out = (ColumnTable){0};
+
+    if (source == NULL)
+        return false;
+
+    char *line = source;
+    char *next = strchr(line, '\n');
+    if (next != NULL)
+        *next++ = '\0';
+
+    size_t n = 1;
+    for (const char *c = line; (c = strchr(c, ',')) != NULL; c++)
+        n++;
+
+    char **fields = malloc(n * sizeof(char*));
+    splitFields(line, fields, n);
+
+    out->n_columns = n;
+    out->names = malloc(n * sizeof(char*));
+    out->columns = calloc(n, sizeof(Column));
+    for (size_t i = 0; i < n; i++)
+        out->names[i] = strdup(fields[i]);
+
+    size_t cap = 0;
+    int lineNo = 1;
+    bool retval = true;
+
+    for (line = next; line != NULL && *line != '\0'; line = next) {
+        lineNo++;
+        next = strchr(line, '\n');
+        if (next != NULL)
+            *next++ = '\0';
+
+        if (splitFields(line, fields, n) != n) {
+            error(lineNo, "Wrong number of fields.\n");
+            retval = false;
+            break;
+        }
+
+        if (out->rows == 0) {
+            for (size_t i = 0; i < n; i++) {
+                bool isBool = strcmp(fields[i], "true") == 0 || strcmp(fields[i], "false") == 0;
+                out->columns[i].type = isBool ? COLUMN_BOOL : COLUMN_NUMBER;
+            }
+        }
+
+        if (out->rows == cap) {
+            cap = cap ? cap * 2 : 1024;
+            grow(out, cap);
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            if (!parseField(&out->columns[i], out->rows, fields[i])) {
+                error(lineNo, out->columns[i].type == COLUMN_BOOL ? "Expected true or false.\n"
+                                                                   : "Expected a number.\n");
+                retval = false;
+                break;
+            }
+        }
+
+        if (!retval)
+            break;
+        out->rows++;
+    }
+
+    free(fields);
+    free(source);
+
+    if (!retval)
+        ColumnTableFini(out);
+
+    return retval;
+}
+
+void ColumnTableFini(ColumnTable *t) {
+    for (size_t i = 0; i < t->n_columns; i++) {
+        free(t->names[i]);
+        free(t->columns[i].type == COLUMN_NUMBER ? (void*)t->columns[i].data.f
+                                                 : (void*)t->columns[i].data.b);
+    }
+
+    free(t->names);
+    free(t->columns);
+    *t = (ColumnTable){0};
+}
+
+int CsvRun(const char *csv, const char *script, int level, const char *aot, FILE *out) {
+    ColumnTable table;
+    size_t size;
+    char *source;
+
+    if ((source = readFile(script, &size)) == NULL)
+        return -1;
+
+    if (!CsvLoad(csv, &table)) {
+        free(source);
+        return hadError ? 1 : -1;
+    }
+
+    /* A module built from this very script skips the front end. */
+    uint64_t hash = aot != NULL ? moduleHash(source, size, &table) : 0;
+    AotModule *module = aot != NULL ? AotLoad(aot, hash) : NULL;
+    Expr *expr = NULL;
+
+    if (module == NULL) {
+        TokenList tokens = TokenListInit();
+
+        if (LexerTokenize(source, size, &tokens)) {
+            TokenListPush(&tokens, TokenEOF);
+
+            Parser parser = ParserInitParams(tokens.tokens, (const char *const *)table.names,
+                                             table.n_columns);
+            expr = ParserParse(&parser);
+        }
+        TokenListFini(&tokens);
+
+        if (expr != NULL) {
+            Optimizer optimizer = OptimizerInit(level);
+            optimizer.keep_tree = aot != NULL;
+            expr = OptimizerRun(&optimizer, expr);
+        }
+
+        if (expr != NULL && aot != NULL && (module = AotCompile(expr, hash, aot)) == NULL)
+            fprintf(stderr, "Could not build %s, running columns instead.\n", aot);
+    }
+    free(source);
+
+    if (module != NULL) {
+        if (expr != NULL)
+            ExprFini(expr);
+
+        double start = nowSeconds();
+        TRACE_BEGIN("rows", csv, table.rows);
+        bool ok = runRows(module, &table, out);
+        TRACE_END("rows");
+        double elapsed = nowSeconds() - start;
+
+        fprintf(stderr, "Rows: %zu rows in %.3f s with %s (%.0f rows/s)\n",
+                table.rows, elapsed, aot, elapsed > 0 ? table.rows / elapsed : 0.0);
+
+        AotUnload(module);
+        ColumnTableFini(&table);
+        return ok ? 0 : 1;
+    }
+
+    ColumnType *types = malloc((table.n_columns + 1) * sizeof(ColumnType));
+    for (size_t i = 0; i < table.n_columns; i++)
+        types[i] = table.columns[i].type;
+
+    ColumnProgram program;
+    bool ok = expr != NULL && ColumnCompile(expr, types, table.n_columns, &program);
+
+    free(types);
+    if (expr != NULL)
+        ExprFini(expr);
+
+    if (!ok) {
+        ColumnTableFini(&table);
+        return 1;
+    }
+
+    /* A double is wide enough for either result type. */
+    Column result = { .data.f = malloc((table.rows + 1) * sizeof(double)) };
+
+    double start = nowSeconds();
+    TRACE_BEGIN("columns", csv, table.rows);
+    ColumnRun(&program, table.columns, table.rows, &result);
+    TRACE_END("columns");
+    double elapsed = nowSeconds() - start;
+
+    for (size_t i = 0; i < table.rows; i++) {
+        if (result.type == COLUMN_NUMBER) {
+            ObjectPrintNumber(out, result.data.f[i]);
+            fputc('\n', out);
+        } else {
+            fputs(result.data.b[i] ? "true\n" : "false\n", out);
+        }
+    }
+
+    fprintf(stderr, "Columns: %zu rows in %.3f s with %s kernels (%.0f rows/s)\n",
+            table.rows, elapsed, ColumnKernelName(), elapsed > 0 ? table.rows / elapsed : 0.0);
+
+    free(result.data.f);
+    ColumnProgramFini(&program);
+    ColumnTableFini(&table);
+    return 0;
+}
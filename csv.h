@@ -0,0 +1,31 @@
+#ifndef CSV_H_
+#define CSV_H_
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "columnar.h"
+
+typedef struct {
+    char **names;
+    Column *columns;
+    size_t n_columns;
+    size_t rows;
+} ColumnTable;
+
+/*
+ * Loads a comma separated file whose first line names the columns. A
+ * column whose first value is true or false is boolean, anything else must
+ * parse as a number throughout. Returns false after reporting an error.
+ */
+bool CsvLoad(const char *path, ColumnTable *out);
+void ColumnTableFini(ColumnTable *t);
+
+/* Evaluates the expression in script once per row of csv, with the column
+ * names as its parameters and after optimizing it at level, and writes one
+ * result per row to out. With aot, the expression is built into a module
+ * at that path, or loaded from it, and run a row at a time instead of as
+ * columns; it is then not limited to what the columnar engine takes. */
+int CsvRun(const char *csv, const char *script, int level, const char *aot, FILE *out);
+
+#endif
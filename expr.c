@@ -1,11 +1,19 @@
 #include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
 
 #include "expr.h"
+#include "pool.h"
+#include "memtrack.h"
 
 static void *tertiaryAccept(ExprVisitor *v, Expr *expr) {
     return v->visitTertiaryExpr(v, (Tertiary*)expr);
 }
 
+static void *logicalAccept(ExprVisitor *v, Expr *expr) {
+    return v->visitLogicalExpr(v, (Logical*)expr);
+}
+
 static void *binaryAccept(ExprVisitor *v, Expr *expr) {
     return v->visitBinaryExpr(v, (Binary*)expr);
 }
@@ -22,7 +30,40 @@ static void *literalAccept(ExprVisitor *v, Expr *expr) {
     return v->visitLiteralExpr(v, (Literal*)expr);
 }
 
+static void *variableAccept(ExprVisitor *v, Expr *expr) {
+    return v->visitVariableExpr(v, (Variable*)expr);
+}
+
+static void *callAccept(ExprVisitor *v, Expr *expr) {
+    return v->visitCallExpr(v, (Call*)expr);
+}
+
+static void *newAccept(ExprVisitor *v, Expr *expr) {
+    return v->visitNewExpr(v, (New*)expr);
+}
+
+static void *getAccept(ExprVisitor *v, Expr *expr) {
+    return v->visitGetExpr(v, (Get*)expr);
+}
+
+static void *setAccept(ExprVisitor *v, Expr *expr) {
+    return v->visitSetExpr(v, (Set*)expr);
+}
+
+static void *invokeAccept(ExprVisitor *v, Expr *expr) {
+    return v->visitInvokeExpr(v, (Invoke*)expr);
+}
+
+static void *scriptAccept(ExprVisitor *v, Expr *expr) {
+    return v->visitScriptExpr(v, (Script*)expr);
+}
+
 void ExprFini(Expr *e) {
+    if (e->shares > 0) {
+        e->shares--;
+        return;
+    }
+
     e->fini(e);
 }
 
@@ -31,32 +72,151 @@ void TertiaryFini(Expr *t) {
     ExprFini(_t->condition);
     ExprFini(_t->ifTrue);
     ExprFini(_t->ifFalse);
-    free(t);
+    MEM_TRACK_FREE(MEM_EXPR, t);
+    PoolFree(t, sizeof(Tertiary));
+}
+
+void LogicalFini(Expr *l) {
+    Logical *_l = (Logical*)l;
+
+    for (size_t i = 0; i < _l->n_operands; i++)
+        ExprFini(_l->operands[i]);
+
+    MEM_TRACK_FREE(MEM_EXPR, _l->operands);
+    free(_l->operands);
+    MEM_TRACK_FREE(MEM_EXPR, l);
+    PoolFree(l, sizeof(Logical));
 }
 
 void BinaryFini(Expr *b) {
     Binary *_b = (Binary*)b;
     ExprFini(_b->left);
     ExprFini(_b->right);
-    free(b);
+    MEM_TRACK_FREE(MEM_EXPR, b);
+    PoolFree(b, sizeof(Binary));
 }
 
 void UnaryFini(Expr *u) {
     ExprFini(((Unary*)u)->right);
-    free(u);
+    MEM_TRACK_FREE(MEM_EXPR, u);
+    PoolFree(u, sizeof(Unary));
 }
 
 void GroupingFini(Expr *g) {
     ExprFini(((Grouping*)g)->expr);
-    free(g);
+    MEM_TRACK_FREE(MEM_EXPR, g);
+    PoolFree(g, sizeof(Grouping));
 }
 
 void LiteralFini(Expr *l) {
-    free(l);
+    ObjectStrRelease(&((Literal*)l)->object);
+    MEM_TRACK_FREE(MEM_EXPR, l);
+    PoolFree(l, sizeof(Literal));
+}
+
+void VariableFini(Expr *v) {
+    MEM_TRACK_FREE(MEM_STRING, ((Variable*)v)->name);
+    free(((Variable*)v)->name);
+    MEM_TRACK_FREE(MEM_EXPR, v);
+    PoolFree(v, sizeof(Variable));
+}
+
+void CallFini(Expr *c) {
+    Call *_c = (Call*)c;
+
+    for (size_t i = 0; i < _c->callee->arity; i++)
+        ExprFini(_c->args[i]);
+
+    MEM_TRACK_FREE(MEM_EXPR, _c->args);
+    free(_c->args);
+    MEM_TRACK_FREE(MEM_EXPR, c);
+    PoolFree(c, sizeof(Call));
+}
+
+void NewFini(Expr *n) {
+    New *_n = (New*)n;
+    size_t n_args = _n->klass->init != NULL ? _n->klass->init->arity - 1 : 0;
+
+    for (size_t i = 0; i < n_args; i++)
+        ExprFini(_n->args[i]);
+
+    MEM_TRACK_FREE(MEM_EXPR, _n->args);
+    free(_n->args);
+    MEM_TRACK_FREE(MEM_EXPR, n);
+    PoolFree(n, sizeof(New));
+}
+
+void GetFini(Expr *g) {
+    Get *_g = (Get*)g;
+    ExprFini(_g->object);
+    MEM_TRACK_FREE(MEM_STRING, _g->name);
+    free(_g->name);
+    MEM_TRACK_FREE(MEM_EXPR, g);
+    PoolFree(g, sizeof(Get));
+}
+
+void SetFini(Expr *s) {
+    Set *_s = (Set*)s;
+    ExprFini(_s->object);
+    ExprFini(_s->value);
+    MEM_TRACK_FREE(MEM_STRING, _s->name);
+    free(_s->name);
+    MEM_TRACK_FREE(MEM_EXPR, s);
+    PoolFree(s, sizeof(Set));
+}
+
+void InvokeFini(Expr *i) {
+    Invoke *_i = (Invoke*)i;
+    ExprFini(_i->object);
+
+    for (size_t k = 0; k < _i->n_args; k++)
+        ExprFini(_i->args[k]);
+
+    MEM_TRACK_FREE(MEM_EXPR, _i->args);
+    free(_i->args);
+    MEM_TRACK_FREE(MEM_STRING, _i->name);
+    free(_i->name);
+    MEM_TRACK_FREE(MEM_EXPR, i);
+    PoolFree(i, sizeof(Invoke));
+}
+
+static void functionFini(Function *f) {
+    if (f->body != NULL)
+        ExprFini(f->body);
+    for (size_t j = 0; j < f->arity; j++)
+        free(f->params[j]);
+    free(f->params);
+    free(f->name);
+}
+
+/* The calls in the bodies point at the functions and classes, so those go
+ * last. */
+void ScriptFini(Expr *s) {
+    Script *_s = (Script*)s;
+    if (_s->body != NULL)
+        ExprFini(_s->body);
+
+    for (size_t i = 0; i < _s->n_functions; i++)
+        functionFini(&_s->functions[i]);
+
+    for (size_t i = 0; i < _s->n_classes; i++) {
+        for (size_t j = 0; j < _s->classes[i].n_methods; j++)
+            functionFini(&_s->classes[i].methods[j]);
+    }
+
+    for (size_t i = 0; i < _s->n_classes; i++) {
+        free(_s->classes[i].methods);
+        free(_s->classes[i].name);
+    }
+
+    free(_s->functions);
+    free(_s->classes);
+    MEM_TRACK_FREE(MEM_EXPR, s);
+    PoolFree(s, sizeof(Script));
 }
 
 Tertiary *TertiaryInit(Expr *condition, Expr *ifTrue, Expr *ifFalse) {
-    Tertiary *retval = malloc(sizeof(Tertiary));
+    Tertiary *retval = PoolAlloc(sizeof(Tertiary));
     *retval = (Tertiary){
         .base.accept = tertiaryAccept,
         .base.fini =  TertiaryFini,
@@ -64,12 +224,28 @@ Tertiary *TertiaryInit(Expr *condition, Expr *ifTrue, Expr *ifFalse) {
         .ifTrue = ifTrue,
         .ifFalse = ifFalse
     };
+    MEM_TRACK_ALLOC(MEM_EXPR, "Tertiary", retval, sizeof(Tertiary));
+
+    return retval;
+}
+
+Logical *LogicalInit(Operation oper, Expr **operands, size_t n_operands) {
+    Logical *retval = PoolAlloc(sizeof(Logical));
+    *retval = (Logical){
+        .base.accept = logicalAccept,
+        .base.fini = LogicalFini,
+        .operation = oper,
+        .operands = operands,
+        .n_operands = n_operands
+    };
+    MEM_TRACK_ALLOC(MEM_EXPR, "Logical", retval, sizeof(Logical));
+    MEM_TRACK_ALLOC(MEM_EXPR, "Logical operands", operands, n_operands * sizeof(Expr*));
 
     return retval;
 }
 
 Binary *BinaryInit(Expr *left, Operation operator, Expr *right) {
-    Binary *retval = malloc(sizeof(Binary));
+    Binary *retval = PoolAlloc(sizeof(Binary));
     *retval = (Binary){
         .base.accept = binaryAccept,
         .base.fini = BinaryFini,
@@ -77,41 +253,173 @@ Binary *BinaryInit(Expr *left, Operation operator, Expr *right) {
         .operation = operator,
         .right = right
     };
+    MEM_TRACK_ALLOC(MEM_EXPR, "Binary", retval, sizeof(Binary));
 
     return retval;
 }
 
 Grouping *GroupingInit(Expr *expr) {
-    Grouping *retval = malloc(sizeof(Grouping));
+    Grouping *retval = PoolAlloc(sizeof(Grouping));
     *retval = (Grouping){
         .base.accept = groupingAccept,
         .base.fini = GroupingFini,
         .expr = expr
     };
+    MEM_TRACK_ALLOC(MEM_EXPR, "Grouping", retval, sizeof(Grouping));
 
     return retval;
 }
 
-Literal *LiteralInit(Object *object) {
-    Literal *retval = malloc(sizeof(Literal));
+Literal *LiteralInit(Object object) {
+    Literal *retval = PoolAlloc(sizeof(Literal));
     *retval = (Literal){
         .base.accept = literalAccept,
         .base.fini = LiteralFini,
         .object = object
     };
+    MEM_TRACK_ALLOC(MEM_EXPR, "Literal", retval, sizeof(Literal));
 
     return retval;
 }
 
 Unary *UnaryInit(Operation operator, Expr *right) {
-    Unary *retval = malloc(sizeof(Unary));
+    Unary *retval = PoolAlloc(sizeof(Unary));
     *retval = (Unary){
         .base.accept = unaryAccept,
         .base.fini = UnaryFini,
         .operation = operator,
         .right = right
     };
+    MEM_TRACK_ALLOC(MEM_EXPR, "Unary", retval, sizeof(Unary));
+
+    return retval;
+}
+
+
+Variable *VariableInit(const char *name, size_t len, size_t slot) {
+    Variable *retval = PoolAlloc(sizeof(Variable));
+    *retval = (Variable){
+        .base.accept = variableAccept,
+        .base.fini = VariableFini,
+        .name = strndup(name, len),
+        .slot = slot
+    };
+    MEM_TRACK_ALLOC(MEM_EXPR, "Variable", retval, sizeof(Variable));
+    MEM_TRACK_ALLOC(MEM_STRING, "Variable name", retval->name, len + 1);
+
+    return retval;
+}
+
+Call *CallInit(Function *callee, Expr **args) {
+    Call *retval = PoolAlloc(sizeof(Call));
+    *retval = (Call){
+        .base.accept = callAccept,
+        .base.fini = CallFini,
+        .callee = callee,
+        .args = args
+    };
+    MEM_TRACK_ALLOC(MEM_EXPR, "Call", retval, sizeof(Call));
+    MEM_TRACK_ALLOC(MEM_EXPR, "Call arguments", args, callee->arity * sizeof(Expr*));
+
+    return retval;
+}
+
+New *NewInit(Class *klass, Expr **args) {
+    New *retval = PoolAlloc(sizeof(New));
+    *retval = (New){
+        .base.accept = newAccept,
+        .base.fini = NewFini,
+        .klass = klass,
+        .args = args
+    };
+    MEM_TRACK_ALLOC(MEM_EXPR, "New", retval, sizeof(New));
+    MEM_TRACK_ALLOC(MEM_EXPR, "New arguments", args,
+                    klass->init != NULL ? (klass->init->arity - 1) * sizeof(Expr*) : 0);
+
+    return retval;
+}
+
+Get *GetInit(Expr *object, const char *name, size_t len, size_t site) {
+    Get *retval = PoolAlloc(sizeof(Get));
+    *retval = (Get){
+        .base.accept = getAccept,
+        .base.fini = GetFini,
+        .object = object,
+        .name = strndup(name, len),
+        .site = site
+    };
+    MEM_TRACK_ALLOC(MEM_EXPR, "Get", retval, sizeof(Get));
+    MEM_TRACK_ALLOC(MEM_STRING, "Get name", retval->name, len + 1);
+
+    return retval;
+}
+
+Set *SetInit(Get *target, Expr *value) {
+    Set *retval = PoolAlloc(sizeof(Set));
+    *retval = (Set){
+        .base.accept = setAccept,
+        .base.fini = SetFini,
+        .object = target->object,
+        .name = target->name,
+        .value = value,
+        .site = target->site
+    };
+    MEM_TRACK_ALLOC(MEM_EXPR, "Set", retval, sizeof(Set));
 
+    MEM_TRACK_FREE(MEM_EXPR, target);
+    PoolFree(target, sizeof(Get));
     return retval;
 }
 
+Invoke *InvokeInit(Expr *object, const char *name, size_t len, Expr **args, size_t n_args,
+                   size_t site) {
+    Invoke *retval = PoolAlloc(sizeof(Invoke));
+    *retval = (Invoke){
+        .base.accept = invokeAccept,
+        .base.fini = InvokeFini,
+        .object = object,
+        .name = strndup(name, len),
+        .args = args,
+        .n_args = n_args,
+        .site = site
+    };
+    MEM_TRACK_ALLOC(MEM_EXPR, "Invoke", retval, sizeof(Invoke));
+    MEM_TRACK_ALLOC(MEM_EXPR, "Invoke arguments", args, n_args * sizeof(Expr*));
+    MEM_TRACK_ALLOC(MEM_STRING, "Invoke name", retval->name, len + 1);
+
+    return retval;
+}
+
+static size_t maxArity(const Function *functions, size_t n, size_t max) {
+    for (size_t i = 0; i < n; i++) {
+        if (functions[i].arity > max)
+            max = functions[i].arity;
+    }
+
+    return max;
+}
+
+Script *ScriptInit(Function *functions, size_t n_functions, Class *classes, size_t n_classes,
+                   size_t n_sites, Expr *body) {
+    static atomic_uint_fast64_t ids;
+
+    Script *retval = PoolAlloc(sizeof(Script));
+    *retval = (Script){
+        .base.accept = scriptAccept,
+        .base.fini = ScriptFini,
+        .functions = functions,
+        .n_functions = n_functions,
+        .classes = classes,
+        .n_classes = n_classes,
+        .n_sites = n_sites,
+        .id = atomic_fetch_add(&ids, 1) + 1,
+        .body = body
+    };
+    MEM_TRACK_ALLOC(MEM_EXPR, "Script", retval, sizeof(Script));
+
+    retval->max_arity = maxArity(functions, n_functions, 0);
+    for (size_t i = 0; i < n_classes; i++)
+        retval->max_arity = maxArity(classes[i].methods, classes[i].n_methods, retval->max_arity);
+
+    return retval;
+}
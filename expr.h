@@ -2,6 +2,7 @@
 #define EXPR_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "lexer.h"
 #include "object.h"
@@ -19,16 +20,45 @@ typedef enum {
     OPER_GREATER,
     OPER_GREATER_EQUAL,
     OPER_NEGATE,
-    OPER_BOOL_NOT
+    OPER_BOOL_NOT,
+    OPER_AND,
+    OPER_OR
 } Operation;
 
+/* What the type checker proved about the value of a node, if it is
+ * evaluated without error. */
+typedef enum {
+    TYPE_DYNAMIC,
+    TYPE_NUMBER,
+    TYPE_BOOL,
+    TYPE_STRING,
+    TYPE_NIL
+} StaticType;
+
 typedef struct ExprVisitor ExprVisitor;
 
-typedef struct  {
+typedef struct Expr Expr;
+
+/* span is the source text the node was parsed from. It points into the
+ * parsed source and is only valid for as long as that is.
+ *
+ * Once identical subtrees are merged a node can have several parents.
+ * shares counts all but the first, each of which ExprFini gives back
+ * before the node is freed. slot, when not 0, numbers a shared node whose
+ * value the interpreter keeps for the rest of an evaluation.
+ *
+ * The header is packed into 40 bytes, so that a Binary or a Tertiary
+ * takes one cache line of the pool. type is a StaticType. */
+struct Expr {
     void *(*accept)(ExprVisitor *v, Expr *expr);
     void (*fini)(Expr *expr);
+    const char *span;
+    uint32_t span_len;
     int line;
-} Expr;
+    uint32_t shares;
+    unsigned type : 4;
+    unsigned slot : 28;
+};
 
 typedef struct {
     Expr base;
@@ -50,6 +80,17 @@ typedef struct {
     Expr *right;
 } Unary;
 
+/* A chain of 'and', or of 'or', with every operand of the chain in one
+ * node, so that it is evaluated as a run of tests that stops at the first
+ * one to decide it. Each operand must be a boolean, and so is the
+ * result. */
+typedef struct {
+    Expr base;
+    Operation operation;
+    Expr **operands;
+    size_t n_operands;
+} Logical;
+
 typedef struct {
     Expr base;
     Expr *expr;
@@ -57,28 +98,146 @@ typedef struct {
 
 typedef struct {
     Expr base;
-    Object *object;
+    Object object;
 } Literal;
 
+/* A named input supplied by the host. slot indexes the parameter list the
+ * expression was parsed with. */
+typedef struct {
+    Expr base;
+    char *name;
+    size_t slot;
+} Variable;
+
+/* A declared function. Its body refers to its own parameters, numbered
+ * from 0, and to nothing else. height is how many nodes deep the body
+ * nests, which a call to it adds to the C stack. */
+typedef struct {
+    char *name;
+    char **params;
+    size_t arity;
+    Expr *body;
+    size_t height;
+    int line;
+} Function;
+
+/* Takes one argument per parameter of callee, which belongs to the Script
+ * the call is in. */
+typedef struct {
+    Expr base;
+    Function *callee;
+    Expr **args;
+} Call;
+
+/* A declared class. Its methods are functions whose first parameter is
+ * the instance they are called on, this. init, if declared, is one of
+ * them, and runs on every new instance. */
+typedef struct Class {
+    char *name;
+    Function *methods;
+    size_t n_methods;
+    Function *init;
+    int line;
+} Class;
+
+/* Makes an instance of klass, which belongs to the Script the node is in,
+ * and runs its init with args. */
+typedef struct {
+    Expr base;
+    Class *klass;
+    Expr **args;
+} New;
+
+/* Field name of object. site numbers the node's inline cache among those
+ * of its Script. */
+typedef struct {
+    Expr base;
+    Expr *object;
+    char *name;
+    size_t site;
+} Get;
+
+typedef struct {
+    Expr base;
+    Expr *object;
+    char *name;
+    Expr *value;
+    size_t site;
+} Set;
+
+/* Calls method name of object. Which method that is, and so how many
+ * arguments it takes, is only known once object is evaluated. */
+typedef struct {
+    Expr base;
+    Expr *object;
+    char *name;
+    Expr **args;
+    size_t n_args;
+    size_t site;
+} Invoke;
+
+/* The root of a source that declares functions or classes: the
+ * declarations, then the expression the source evaluates to. max_arity
+ * counts the receiver of methods. id tells Scripts apart for as long as
+ * the process runs, for whoever keeps state per Script. */
+typedef struct {
+    Expr base;
+    Function *functions;
+    size_t n_functions;
+    Class *classes;
+    size_t n_classes;
+    size_t n_sites;
+    size_t max_arity;
+    uint64_t id;
+    Expr *body;
+} Script;
+
 Binary *BinaryInit(Expr *left, Operation oper, Expr *right);
 Tertiary *TertiaryInit(Expr *condition, Expr *ifTrue, Expr *ifFalse);
 Unary *UnaryInit(Operation oper, Expr *right);
+Logical *LogicalInit(Operation oper, Expr **operands, size_t n_operands);
 Grouping *GroupingInit(Expr *expr);
-Literal *LiteralInit(Object *object);
+Literal *LiteralInit(Object object);
+Variable *VariableInit(const char *name, size_t len, size_t slot);
+Call *CallInit(Function *callee, Expr **args);
+New *NewInit(Class *klass, Expr **args);
+Get *GetInit(Expr *object, const char *name, size_t len, size_t site);
+/* Takes the object, name and site of target, which is freed. */
+Set *SetInit(Get *target, Expr *value);
+Invoke *InvokeInit(Expr *object, const char *name, size_t len, Expr **args, size_t n_args,
+                   size_t site);
+Script *ScriptInit(Function *functions, size_t n_functions, Class *classes, size_t n_classes,
+                   size_t n_sites, Expr *body);
 
 void ExprFini(Expr *e);
 void TertiaryFini(Expr *t);
 void BinaryFini(Expr *b);
 void UnaryFini(Expr *u);
+void LogicalFini(Expr *l);
 void GroupingFini(Expr *g);
 void LiteralFini(Expr *l);
+void VariableFini(Expr *v);
+void CallFini(Expr *c);
+void NewFini(Expr *n);
+void GetFini(Expr *g);
+void SetFini(Expr *s);
+void InvokeFini(Expr *i);
+void ScriptFini(Expr *s);
 
 struct ExprVisitor {
     void *(*visitBinaryExpr)(ExprVisitor *v, Binary *b);
     void *(*visitTertiaryExpr)(ExprVisitor *v, Tertiary *t);
+    void *(*visitLogicalExpr)(ExprVisitor *v, Logical *l);
     void *(*visitGroupingExpr)(ExprVisitor *v, Grouping *g);
     void *(*visitLiteralExpr)(ExprVisitor *v, Literal *l);
     void *(*visitUnaryExpr)(ExprVisitor *v, Unary *u);
+    void *(*visitVariableExpr)(ExprVisitor *v, Variable *var);
+    void *(*visitCallExpr)(ExprVisitor *v, Call *c);
+    void *(*visitNewExpr)(ExprVisitor *v, New *n);
+    void *(*visitGetExpr)(ExprVisitor *v, Get *g);
+    void *(*visitSetExpr)(ExprVisitor *v, Set *s);
+    void *(*visitInvokeExpr)(ExprVisitor *v, Invoke *i);
+    void *(*visitScriptExpr)(ExprVisitor *v, Script *s);
 };
 
 #endif
@@ -0,0 +1,356 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include "heap.h"
+#include "object.h"
+#include "pool.h"
+#include "memtrack.h"
+
+static _Thread_local Heap *current = NULL;
+
+/* ---- HELPER FUNCTIONS ---- */
+
+static uint64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* What an object has been charged for so far; a rope is charged for its
+ * characters once it is flattened, and an instance for its fields as they
+ * grow. */
+static size_t objectSize(const Object *obj) {
+    size_t size = sizeof(Object);
+
+    if (obj->type == OBJECT_STRING && obj->repr == STR_FLAT)
+        size += obj->len + 1;
+    if (obj->type == OBJECT_INSTANCE)
+        size += ObjectFieldsCapacity(obj->len) * sizeof(Object*);
+
+    return size;
+}
+
+static void releaseObject(Object *obj) {
+    ObjectStrRelease(obj);
+    ObjectInstanceRelease(obj);
+}
+
+static inline bool hasChildren(const Object *obj) {
+    return ObjectIsRope(obj) || obj->type == OBJECT_INSTANCE;
+}
+
+static void grayPush(Heap *h, Object *obj) {
+    if (h->gray_len == h->gray_cap) {
+        h->gray_cap *= 2;
+        h->gray = realloc(h->gray, h->gray_cap * sizeof(Object*));
+    }
+
+    h->gray[h->gray_len++] = obj;
+}
+
+static Object *promote(Heap *h, Object *obj) {
+    if (obj->gen == GEN_FORWARDED)
+        return obj->next;
+
+    if (obj->gen != GEN_NURSERY)
+        return obj;
+
+    Object *copy = PoolAlloc(sizeof(Object));
+    MEM_TRACK_ALLOC(MEM_OBJECT, "promotion", copy, sizeof(Object));
+    *copy = *obj;
+    copy->gen = GEN_OLD;
+    copy->marked = false;
+    copy->next = h->old;
+    h->old = copy;
+
+    size_t size = objectSize(copy);
+    h->old_bytes += size;
+    h->stats.bytes_promoted += size;
+
+    obj->gen = GEN_FORWARDED;
+    obj->next = copy;
+
+    if (hasChildren(copy))
+        grayPush(h, copy);
+
+    return copy;
+}
+
+static void collectMinor(Heap *h) {
+    for (size_t i = 0; i < h->stack_len; i++)
+        h->stack[i] = promote(h, h->stack[i]);
+
+    for (size_t i = 0; i < h->remembered_len; i++) {
+        h->remembered[i]->marked = false;
+        grayPush(h, h->remembered[i]);
+    }
+    h->remembered_len = 0;
+
+    while (h->gray_len > 0) {
+        Object *obj = h->gray[--h->gray_len];
+
+        if (obj->type == OBJECT_INSTANCE) {
+            Object **fields = obj->value.instance.fields;
+            for (size_t i = 0; i < obj->len; i++)
+                fields[i] = promote(h, fields[i]);
+            continue;
+        }
+
+        obj->value.rope.left = promote(h, obj->value.rope.left);
+        obj->value.rope.right = promote(h, obj->value.rope.right);
+    }
+
+    /* Whatever was not forwarded is garbage. The string buffers are the
+     * only thing the nursery does not own outright. */
+    for (size_t i = 0; i < h->nursery_top; i++) {
+        Object *obj = &h->nursery[i];
+        MEM_TRACK_FREE(MEM_OBJECT, obj);
+        if (obj->gen != GEN_NURSERY)
+            continue;
+
+        h->stats.bytes_freed += objectSize(obj);
+        releaseObject(obj);
+    }
+
+    h->nursery_top = 0;
+    h->nursery_bytes = 0;
+    h->stats.minor_collections++;
+}
+
+static void mark(Heap *h, Object *obj) {
+    if (obj->gen != GEN_OLD || obj->marked)
+        return;
+
+    obj->marked = true;
+    if (hasChildren(obj))
+        grayPush(h, obj);
+}
+
+static void collectMajor(Heap *h) {
+    for (size_t i = 0; i < h->stack_len; i++)
+        mark(h, h->stack[i]);
+
+    while (h->gray_len > 0) {
+        Object *obj = h->gray[--h->gray_len];
+
+        if (obj->type == OBJECT_INSTANCE) {
+            for (size_t i = 0; i < obj->len; i++)
+                mark(h, obj->value.instance.fields[i]);
+            continue;
+        }
+
+        mark(h, obj->value.rope.left);
+        mark(h, obj->value.rope.right);
+    }
+
+    for (Object **link = &h->old; *link != NULL;) {
+        Object *obj = *link;
+
+        if (obj->marked) {
+            obj->marked = false;
+            link = &obj->next;
+            continue;
+        }
+
+        size_t size = objectSize(obj);
+        h->old_bytes -= size;
+        h->stats.bytes_freed += size;
+
+        *link = obj->next;
+        releaseObject(obj);
+        MEM_TRACK_FREE(MEM_OBJECT, obj);
+        PoolFree(obj, sizeof(Object));
+    }
+
+    h->next_major = h->old_bytes * 2;
+    if (h->next_major < HEAP_MIN_MAJOR_THRESHOLD)
+        h->next_major = HEAP_MIN_MAJOR_THRESHOLD;
+
+    h->stats.major_collections++;
+}
+
+/* ---- MAIN METHODS ---- */
+
+Heap HeapInit(size_t nursery_size) {
+    return (Heap){
+        .nursery = malloc(nursery_size * sizeof(Object)),
+        .nursery_top = 0,
+        .nursery_cap = nursery_size,
+        .old = NULL,
+        .old_bytes = 0,
+        .next_major = HEAP_MIN_MAJOR_THRESHOLD,
+        .nursery_bytes = 0,
+        .limit = 0,
+        .stack = malloc(HEAP_STACK_SIZE * sizeof(Object*)),
+        .stack_len = 0,
+        .stack_cap = HEAP_STACK_SIZE,
+        .gray = malloc(HEAP_STACK_SIZE * sizeof(Object*)),
+        .gray_len = 0,
+        .gray_cap = HEAP_STACK_SIZE,
+        .remembered = malloc(HEAP_STACK_SIZE * sizeof(Object*)),
+        .remembered_len = 0,
+        .remembered_cap = HEAP_STACK_SIZE
+    };
+}
+
+void HeapFini(Heap *h) {
+    for (size_t i = 0; i < h->nursery_top; i++) {
+        MEM_TRACK_FREE(MEM_OBJECT, &h->nursery[i]);
+        if (h->nursery[i].gen == GEN_NURSERY)
+            releaseObject(&h->nursery[i]);
+    }
+
+    for (Object *iter = h->old, *next = NULL; iter != NULL; iter = next) {
+        next = iter->next;
+        releaseObject(iter);
+        MEM_TRACK_FREE(MEM_OBJECT, iter);
+        PoolFree(iter, sizeof(Object));
+    }
+
+    free(h->nursery);
+    free(h->stack);
+    free(h->gray);
+    free(h->remembered);
+
+    if (current == h)
+        current = NULL;
+}
+
+void HeapSetCurrent(Heap *h) {
+    current = h;
+}
+
+Heap *HeapCurrent(void) {
+    return current;
+}
+
+Object *HeapAlloc(void) {
+    Heap *h = current;
+    assert(h != NULL);
+
+    if (h->nursery_top == h->nursery_cap)
+        HeapCollect(h, false);
+
+    h->nursery_bytes += sizeof(Object);
+    Object *retval = &h->nursery[h->nursery_top++];
+    retval->gen = GEN_NURSERY;
+    retval->marked = false;
+    retval->repr = STR_SMALL;
+    retval->next = NULL;
+    MEM_TRACK_ALLOC(MEM_OBJECT, "HeapAlloc", retval, sizeof(Object));
+    return retval;
+}
+
+void HeapPush(Object *obj) {
+    Heap *h = current;
+
+    if (h->stack_len == h->stack_cap) {
+        h->stack_cap *= 2;
+        h->stack = realloc(h->stack, h->stack_cap * sizeof(Object*));
+    }
+
+    h->stack[h->stack_len++] = obj;
+}
+
+Object *HeapPop(void) {
+    assert(current->stack_len > 0);
+    return current->stack[--current->stack_len];
+}
+
+size_t HeapStackLen(void) {
+    return current->stack_len;
+}
+
+Object *HeapStackGet(size_t index) {
+    assert(index < current->stack_len);
+    return current->stack[index];
+}
+
+void HeapStackTruncate(size_t len) {
+    assert(len <= current->stack_len);
+    current->stack_len = len;
+}
+
+void HeapCharge(const Object *owner, size_t bytes) {
+    if (owner->gen == GEN_OLD)
+        current->old_bytes += bytes;
+    else if (owner->gen == GEN_NURSERY)
+        current->nursery_bytes += bytes;
+}
+
+/* Garbage in the nursery counts until it is collected, so a heap close to
+ * its limit may be refused a little early. */
+bool HeapFits(size_t bytes) {
+    Heap *h = current;
+    size_t used = h->old_bytes + h->nursery_bytes;
+
+    return h->limit == 0 || (used <= h->limit && bytes <= h->limit - used);
+}
+
+/* marked, which is otherwise only set while a major collection runs, says
+ * that owner is remembered already. */
+void HeapWrite(Object *owner, Object *value) {
+    Heap *h = current;
+
+    if (owner->gen != GEN_OLD || value->gen != GEN_NURSERY || owner->marked)
+        return;
+
+    if (h->remembered_len == h->remembered_cap) {
+        h->remembered_cap *= 2;
+        h->remembered = realloc(h->remembered, h->remembered_cap * sizeof(Object*));
+    }
+
+    owner->marked = true;
+    h->remembered[h->remembered_len++] = owner;
+}
+
+/* A heap with a limit also collects its old generation once that is half
+ * way there, rather than fail with it full of garbage. */
+void HeapCollect(Heap *h, bool major) {
+    uint64_t start = nowNs();
+
+    collectMinor(h);
+    if (major || h->old_bytes >= h->next_major || (h->limit != 0 && h->old_bytes >= h->limit / 2))
+        collectMajor(h);
+
+    uint64_t pause = nowNs() - start;
+    h->stats.total_pause_ns += pause;
+    if (pause > h->stats.max_pause_ns)
+        h->stats.max_pause_ns = pause;
+}
+
+bool HeapOwns(const Heap *h, const Object *obj) {
+    if (obj >= h->nursery && obj < h->nursery + h->nursery_top)
+        return obj->gen == GEN_NURSERY;
+
+    for (const Object *iter = h->old; iter != NULL; iter = iter->next) {
+        if (iter == obj)
+            return true;
+    }
+
+    return false;
+}
+
+bool HeapStackHolds(const Heap *h, const Object *obj) {
+    for (size_t i = 0; i < h->stack_len; i++) {
+        if (h->stack[i] == obj)
+            return true;
+    }
+
+    return false;
+}
+
+void HeapPrintStats(const Heap *h, FILE *f) {
+    const HeapStats *s = &h->stats;
+    size_t pauses = s->minor_collections;
+
+    fprintf(f, "GC: %zu minor, %zu major collections\n",
+            s->minor_collections, s->major_collections);
+    fprintf(f, "GC: pause total %.3f ms, max %.3f ms, mean %.3f ms\n",
+            s->total_pause_ns / 1e6, s->max_pause_ns / 1e6,
+            pauses ? s->total_pause_ns / 1e6 / pauses : 0.0);
+    fprintf(f, "GC: %zu bytes promoted, %zu bytes freed, %zu bytes in old generation\n",
+            s->bytes_promoted, s->bytes_freed, h->old_bytes);
+}
@@ -0,0 +1,113 @@
+#ifndef HEAP_H_
+#define HEAP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct Object Object;
+
+#ifndef HEAP_NURSERY_SIZE
+#define HEAP_NURSERY_SIZE 4096
+#endif
+#ifndef HEAP_MIN_MAJOR_THRESHOLD
+#define HEAP_MIN_MAJOR_THRESHOLD (1 << 20)
+#endif
+#define HEAP_STACK_SIZE 256
+
+typedef struct {
+    size_t minor_collections;
+    size_t major_collections;
+    uint64_t total_pause_ns;
+    uint64_t max_pause_ns;
+    size_t bytes_promoted;
+    size_t bytes_freed;
+} HeapStats;
+
+/*
+ * A two-generation managed heap for the objects the interpreter creates.
+ *
+ * New objects are bump-allocated out of a fixed-size nursery. When it fills
+ * up, every nursery object reachable from the value stack is promoted to the
+ * old generation and the nursery is reset in one go, so the cost of a minor
+ * collection is bounded by the nursery size. The old generation is a plain
+ * mark-sweep list that is collected once it doubles in size.
+ *
+ * Ropes and instances are the only objects that point at others. A rope
+ * only points at objects older than itself, and flattening drops those
+ * pointers rather than adding new ones. An instance's fields are written
+ * after it is made, so every store goes through HeapWrite: an old instance
+ * that is handed a nursery object is remembered, and its fields are roots
+ * of the next minor collection.
+ */
+typedef struct {
+    Object *nursery;
+    size_t nursery_top;
+    size_t nursery_cap;
+
+    Object *old;
+    size_t old_bytes;
+    size_t next_major;
+
+    /* What has been allocated in the nursery since it was last emptied,
+     * garbage included, and what that and old_bytes may add up to, or 0
+     * for no limit. */
+    size_t nursery_bytes;
+    size_t limit;
+
+    Object **stack;
+    size_t stack_len;
+    size_t stack_cap;
+
+    /* Ropes and instances whose children still have to be traced. */
+    Object **gray;
+    size_t gray_len;
+    size_t gray_cap;
+
+    /* Old instances written to since the last minor collection. */
+    Object **remembered;
+    size_t remembered_len;
+    size_t remembered_cap;
+
+    HeapStats stats;
+} Heap;
+
+Heap HeapInit(size_t nursery_size);
+void HeapFini(Heap *h);
+
+/* The heap that the Object constructors allocate from on this thread. */
+void HeapSetCurrent(Heap *h);
+Heap *HeapCurrent(void);
+
+Object *HeapAlloc(void);
+
+/* Values held across a call that may allocate must live on the stack. */
+void HeapPush(Object *obj);
+Object *HeapPop(void);
+
+/* Values held across several calls, like the arguments of a call frame,
+ * are found again by their index, as a collection may have moved them. */
+size_t HeapStackLen(void);
+Object *HeapStackGet(size_t index);
+void HeapStackTruncate(size_t len);
+
+/* To be called once owner has taken bytes more outside the heap, for the
+ * characters of a string or the fields of an instance. */
+void HeapCharge(const Object *owner, size_t bytes);
+
+/* Whether bytes more stay within the current heap's limit. */
+bool HeapFits(size_t bytes);
+
+/* To be called once value has been stored into owner. */
+void HeapWrite(Object *owner, Object *value);
+
+void HeapCollect(Heap *h, bool major);
+
+/* For ownership checks. HeapOwns walks the old generation, so both are
+ * meant for debug builds only. */
+bool HeapOwns(const Heap *h, const Object *obj);
+bool HeapStackHolds(const Heap *h, const Object *obj);
+void HeapPrintStats(const Heap *h, FILE *f);
+
+#endif
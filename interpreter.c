@@ -1,193 +1,850 @@
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 #include "interpreter.h"
 #include "logging.h"
+#include "strkernel.h"
 
 /* ---- AUXILIARY FUNCTIONS ---- */
 
-static Object *evaluate(ExprVisitor *v, Expr *expr) {
-    return expr->accept(v, expr);
+#ifdef LOX_CHECK_OWNERSHIP
+static void ownershipViolation(const char *what) {
+    fprintf(stderr, "Ownership violation: %s\n", what);
+    abort();
 }
 
-/* ---- ExprVisitorS (grammar rules) ---- */
+/* A result must be borrowed and untouched, or owned by the current heap
+ * and, if it is a number, which is the only kind written in place, not
+ * still held further up the evaluation. */
+static void checkResult(const Object *obj) {
+    if (obj == NULL)
+        return;
+
+    if (!objectTrue.value.b || objectFalse.value.b || objectNil.type != OBJECT_NIL)
+        ownershipViolation("a shared constant was written to.");
+
+    if (!ObjectIsOwned(obj))
+        return;
+
+    if (obj->gen == GEN_FORWARDED)
+        ownershipViolation("result was moved by a collection.");
+    if (!HeapOwns(HeapCurrent(), obj))
+        ownershipViolation("result is not live on the current heap.");
+    if (obj->type == OBJECT_NUMBER && HeapStackHolds(HeapCurrent(), obj))
+        ownershipViolation("result is still held by an enclosing expression.");
+}
+#endif
+
+static Object *evaluateShared(Interpreter *i, Expr *expr);
+
+/*
+ * Every evaluation may allocate, so anything held further up is on the
+ * heap's stack by now, and the nursery, which may be mostly garbage, can
+ * be collected before a heap over its limit is given up on.
+ */
+static bool refuel(Interpreter *i, int line) {
+    if (!HeapFits(0)) {
+        HeapCollect(HeapCurrent(), true);
+
+        if (!HeapFits(0)) {
+            error(line, "Evaluation ran out of memory.\n");
+            return false;
+        }
+    }
 
-static void *visitLiteralExpr(ExprVisitor *v, Literal *l) {
-    return l->object;
+    i->fuel = i->pause != NULL ? i->pause(i->pause_ctx, line) : SIZE_MAX;
+    return i->fuel > 0;
 }
 
-static void *visitGroupingExpr(ExprVisitor *v, Grouping *g) {
-    return evaluate(v, g->expr);
+static Object *evaluate(ExprVisitor *v, Expr *expr) {
+    Interpreter *i = (Interpreter*)v;
+
+    if (i->fuel == 0 && !refuel(i, expr->line))
+        return NULL;
+    i->fuel--;
+
+    if (expr->slot != 0)
+        return evaluateShared(i, expr);
+
+    Object *retval = expr->accept(v, expr);
+#ifdef LOX_CHECK_OWNERSHIP
+    checkResult(retval);
+#endif
+    return retval;
 }
 
-static void *visitUnaryExpr(ExprVisitor *v, Unary *u) {
-    Object *obj = evaluate(v, u->right);
-    if (hadError)
+/* A shared node has one value for the whole evaluation, so it is only
+ * computed where it is first reached. Owned strings are not kept, as
+ * nothing could hand out a second copy any cheaper. */
+static Object *evaluateShared(Interpreter *i, Expr *expr) {
+    if (expr->slot > i->n_shared) {
+        size_t n = expr->slot * 2;
+        i->shared = realloc(i->shared, n * sizeof(SharedValue));
+        memset(i->shared + i->n_shared, 0, (n - i->n_shared) * sizeof(SharedValue));
+        i->n_shared = n;
+    }
+
+    SharedValue *s = &i->shared[expr->slot - 1];
+    if (s->epoch == i->epoch)
+        return s->value != NULL ? (Object*)s->value : ObjectNum(s->number);
+
+    Object *retval = expr->accept(&i->base, expr);
+#ifdef LOX_CHECK_OWNERSHIP
+    checkResult(retval);
+#endif
+    if (retval == NULL)
         return NULL;
 
-    Object *retval = NULL;
+    if (!ObjectIsOwned(retval))
+        *s = (SharedValue){ .epoch = i->epoch, .value = retval };
+    else if (retval->type == OBJECT_NUMBER)
+        *s = (SharedValue){ .epoch = i->epoch, .number = retval->value.f };
+
+    return retval;
+}
+
+/* Consumes both operands. An owned one already is a number nobody else can
+ * see, so it takes the result instead of a fresh allocation. */
+static Object *numberResult(Object *left, Object *right, double value) {
+    Object *reuse = ObjectIsOwned(left) ? left : ObjectIsOwned(right) ? right : NULL;
+
+    if (reuse == NULL)
+        return ObjectNum(value);
+
+    reuse->value.f = value;
+    return reuse;
+}
+
+/* Both operands are proven numbers, so no tag is looked at. */
+static Object *numberBinary(Operation operation, Object *left, Object *right) {
+    double a = left->value.f, b = right->value.f;
+
+    switch (operation) {
+    case OPER_ADD: return numberResult(left, right, a + b);
+    case OPER_SUB: return numberResult(left, right, a - b);
+    case OPER_MUL: return numberResult(left, right, a * b);
+    case OPER_DIV: return numberResult(left, right, a / b);
+    case OPER_COMMA: return right;
+    case OPER_EQUAL: return ObjectBool(a == b);
+    case OPER_NOT_EQUAL: return ObjectBool(a != b);
+    case OPER_LESS: return ObjectBool(a < b);
+    case OPER_LESS_EQUAL: return ObjectBool(a <= b);
+    case OPER_GREATER: return ObjectBool(a > b);
+    case OPER_GREATER_EQUAL: return ObjectBool(a >= b);
+    default: return NULL;
+    }
+}
+
+static bool stringsEqual(Object *a, Object *b) {
+    if (ObjectStrLen(a) != ObjectStrLen(b))
+        return false;
 
-    switch (u->operation) {
+    return StrEqual(ObjectStrChars(a), ObjectStrLen(a), ObjectStrChars(b), ObjectStrLen(b));
+}
+
+/* Orders two numbers or two strings; anything else is an error. Unordered
+ * numbers come out as NaN so that every comparison on them is false. */
+static bool compare(Object *left, Object *right, double *result) {
+    if (left->type == OBJECT_NUMBER && right->type == OBJECT_NUMBER) {
+        double a = left->value.f, b = right->value.f;
+        *result = a < b ? -1 : a > b ? 1 : a == b ? 0 : NAN;
+        return true;
+    }
+
+    if (left->type == OBJECT_STRING && right->type == OBJECT_STRING) {
+        *result = StrCompare(ObjectStrChars(left), ObjectStrLen(left),
+                             ObjectStrChars(right), ObjectStrLen(right));
+        return true;
+    }
+
+    error(1, "Comparison expects either two strings or two numbers.\n");
+    return false;
+}
+
+/* The operators on values that are already evaluated. type is what the
+ * type checker proved about the operands; the tags are only looked at when
+ * it proved nothing. */
+static Object *unaryOp(Operation operation, Object *obj, StaticType type) {
+    switch (operation) {
     case OPER_NEGATE:
-        if (obj->type != OBJECT_BOOL) {
+        if (type != TYPE_NUMBER && obj->type != OBJECT_NUMBER) {
             error(1, "unary '-' expects a number.\n");
-            free(obj);
-            free(retval);
             return NULL;
         }
 
-        retval = ObjectNum(-obj->value.f);
-        break;
+        return numberResult(obj, obj, -obj->value.f);
     case OPER_BOOL_NOT:
-        if (obj->type != OBJECT_BOOL) {
+        if (type != TYPE_BOOL && obj->type != OBJECT_BOOL) {
             error(1, "'!' expects a boolean.\n");
-            free(obj);
-            free(retval);
             return NULL;
         }
 
-        retval = ObjectBool(!obj->value.b);
-        break;
+        return ObjectBool(!obj->value.b);
     default:
         break;
     }
 
-    free(obj);
-    return retval;
+    return NULL;
 }
 
-static void *visitBinaryExpr(ExprVisitor *v, Binary *b) {
-    Object *left = evaluate(v, b->left);
-    if (left == NULL)
-        return NULL;
+/* Both operands are consumed, except that ',' passes the right one
+ * through. */
+static Object *binaryOp(Operation operation, Object *left, StaticType leftType,
+                        Object *right, StaticType rightType) {
+    if (leftType == TYPE_NUMBER && rightType == TYPE_NUMBER)
+        return numberBinary(operation, left, right);
 
-    Object *right = evaluate(v, b->right);
-    if (right == NULL) {
-        ObjectFini(left);
-        return NULL;
-    }
-
-    Object *retval = malloc(sizeof(Object));
+    Object *retval = NULL;
+    double order;
 
-    switch (b->operation) {
+    switch (operation) {
     case OPER_ADD:
         if (left->type == OBJECT_NUMBER && right->type == OBJECT_NUMBER) {
-            retval = ObjectNum(left->value.f + right->value.f);
+            retval = numberResult(left, right, left->value.f + right->value.f);
         } else if (left->type == OBJECT_STRING && right->type == OBJECT_STRING) {
-            int n = strlen(left->value.str);
-            int m = strlen(right->value.str);
-            char *str = malloc(n + m + 1);
-
-            str[0] = str[n + m] = '\0';
-
-            strncat(str, left->value.str, n);
-            strncat(str, right->value.str, m);
-            retval = ObjectStr(str, n + m);
+            if (ObjectStrLen(left) + ObjectStrLen(right) > OBJECT_STR_MAX) {
+                error(1, "String is too long.\n");
+                return NULL;
+            }
+
+            /* A rope costs little until it is flattened, which may be
+             * the moment it is compared or returned. */
+            if (!HeapFits(ObjectStrLen(left) + ObjectStrLen(right) + 1)) {
+                error(1, "Evaluation ran out of memory.\n");
+                return NULL;
+            }
+
+            retval = ObjectStrConcat(left, right);
         } else {
             error(1, "'+' expects either two strings or two numbers.\n");
-            free(left);
-            free(right);
-            free(retval);
             return NULL;
         }
 
         break;
     case OPER_SUB:
-        if (left->type == OBJECT_NUMBER && left->type == OBJECT_NUMBER) {
-            retval = ObjectNum(left->value.f - right->value.f);
+        if (left->type == OBJECT_NUMBER && right->type == OBJECT_NUMBER) {
+            retval = numberResult(left, right, left->value.f - right->value.f);
         } else {
-            error(1, "'+' expects either two strings or two numbers.\n");
-            ObjectFini(left);
-            ObjectFini(right);
-            ObjectFini(retval);
+            error(1, "'-' expects numeric arguments.\n");
             return NULL;
         }
         break;
 
     case OPER_MUL:
-        if (left->type == OBJECT_NUMBER && left->type == OBJECT_NUMBER) {
-            retval = ObjectNum(left->value.f * right->value.f);
+        if (left->type == OBJECT_NUMBER && right->type == OBJECT_NUMBER) {
+            retval = numberResult(left, right, left->value.f * right->value.f);
+        } else if ((left->type == OBJECT_STRING && right->type == OBJECT_NUMBER) ||
+                   (left->type == OBJECT_NUMBER && right->type == OBJECT_STRING)) {
+            Object *str = left->type == OBJECT_STRING ? left : right;
+            double count = left->type == OBJECT_NUMBER ? left->value.f : right->value.f;
+
+            if (count < 0 || count > OBJECT_STR_MAX || count != (uint32_t)count) {
+                error(1, "String repetition count must be a non-negative integer.\n");
+                return NULL;
+            }
+
+            if (count * ObjectStrLen(str) > OBJECT_STR_MAX) {
+                error(1, "String is too long.\n");
+                return NULL;
+            }
+
+            if (!HeapFits((size_t)count * ObjectStrLen(str) + 1)) {
+                error(1, "Evaluation ran out of memory.\n");
+                return NULL;
+            }
+
+            retval = ObjectStrRepeat(str, (size_t)count);
         } else {
-           error(1, "'*' expects numeric arguments");
-           
+            error(1, "'*' expects two numbers or a string and a count.\n");
+            return NULL;
         }
 
-        /* TODO: Implement string duplication. */
-
         break;
+    case OPER_DIV:
+        if (left->type == OBJECT_NUMBER && right->type == OBJECT_NUMBER) {
+            retval = numberResult(left, right, left->value.f / right->value.f);
+        } else {
+            error(1, "'/' expects numeric arguments.\n");
+            return NULL;
+        }
+        break;
+
     case OPER_COMMA:
         retval = right;
         break;
     case OPER_EQUAL:
         if (left->type != right->type)
             retval = ObjectBool(false);
-        else if (left->type == OBJECT_NUMBER && right->type == OBJECT_NUMBER)
+        else if (left->type == OBJECT_NUMBER)
             retval = ObjectBool(left->value.f == right->value.f);
-        else if (left->type == OBJECT_STRING && right->type == OBJECT_STRING)
-            retval = ObjectBool(strcmp(left->value.str, right->value.str) == 0);
+        else if (left->type == OBJECT_BOOL)
+            retval = ObjectBool(left->value.b == right->value.b);
+        else if (left->type == OBJECT_STRING)
+            retval = ObjectBool(stringsEqual(left, right));
+        else if (left->type == OBJECT_INSTANCE)
+            retval = ObjectBool(left == right);
+        else
+            retval = ObjectBool(true);
         break;
 
     case OPER_NOT_EQUAL:
         if (left->type != right->type)
             retval = ObjectBool(true);
-        else if (left->type == OBJECT_NUMBER && right->type == OBJECT_NUMBER)
+        else if (left->type == OBJECT_NUMBER)
             retval = ObjectBool(left->value.f != right->value.f);
-        else if (left->type == OBJECT_STRING && right->type == OBJECT_STRING)
-            retval = ObjectBool(strcmp(left->value.str, right->value.str) != 0);
+        else if (left->type == OBJECT_BOOL)
+            retval = ObjectBool(left->value.b != right->value.b);
+        else if (left->type == OBJECT_STRING)
+            retval = ObjectBool(!stringsEqual(left, right));
+        else if (left->type == OBJECT_INSTANCE)
+            retval = ObjectBool(left != right);
+        else
+            retval = ObjectBool(false);
         break;
 
-    case OPER_LESS:        
-        retval = ObjectBool(left->value.f < right->value.f);
+    case OPER_LESS:
+        if (!compare(left, right, &order))
+            return NULL;
+        retval = ObjectBool(order < 0);
         break;
 
     case OPER_LESS_EQUAL:
-        retval = ObjectBool(left->value.f <= right->value.f);
+        if (!compare(left, right, &order))
+            return NULL;
+        retval = ObjectBool(order <= 0);
         break;
 
     case OPER_GREATER:
-        retval = ObjectBool(left->value.f > right->value.f);
+        if (!compare(left, right, &order))
+            return NULL;
+        retval = ObjectBool(order > 0);
         break;
 
     case OPER_GREATER_EQUAL:
-        retval = ObjectBool(left->value.f >= right->value.f);
+        if (!compare(left, right, &order))
+            return NULL;
+        retval = ObjectBool(order >= 0);
+        break;
+
+    default:
         break;
     }
 
-    free(left);
-    free(right);
     return retval;
 }
 
+/* operation is what tests the condition: 'and', 'or', or else '?:'. */
+static bool conditionOp(Operation operation, Object *condition, StaticType type, bool *value) {
+    if (type != TYPE_BOOL && condition->type != OBJECT_BOOL) {
+        error(1, operation == OPER_AND ? "'and' expects booleans.\n" :
+                 operation == OPER_OR ? "'or' expects booleans.\n" :
+                 "Tertiary operator expects condition to be a boolean.\n");
+        return false;
+    }
+
+    *value = condition->value.b;
+    return true;
+}
+
+static inline Object *origin(const FrameSlot *s) {
+    return s->root != 0 ? HeapStackGet(s->root - 1) : s->origin;
+}
+
+static Object *argument(Interpreter *i, size_t slot, int line) {
+    if (i->frame != NULL) {
+        FrameSlot *s = &i->frame[slot];
+        bool lent = s->value.type == OBJECT_STRING || s->value.type == OBJECT_INSTANCE;
+        return lent ? origin(s) : &s->value;
+    }
+
+    if (slot >= i->n_args) {
+        error(line, "Parameter has no value bound to it.\n");
+        return NULL;
+    }
+
+    return (Object*)&i->args[slot];
+}
+
+/* Takes the argument's place in the frame. The origin goes on the heap's
+ * stack if owned, so that it lives as long as the frame does. */
+static void bind(FrameSlot *s, Object *arg) {
+    s->value = *arg;
+    s->value.gen = GEN_CONST;
+    s->origin = arg;
+    s->root = 0;
+
+    if (ObjectIsOwned(arg)) {
+        HeapPush(arg);
+        s->root = HeapStackLen();
+    }
+}
+
+/* Drops the frame at frame, and everything bound above it, of a call to
+ * f. */
+static void leave(Interpreter *i, const Function *f, FrameSlot *frame, size_t roots) {
+    HeapStackTruncate(roots);
+    i->top = frame - i->frames;
+    i->depth--;
+    i->height -= f->height + 1;
+}
+
+/*
+ * Arguments are evaluated straight into the slots above the caller's, each
+ * taking its slot before the next is evaluated, so that calls among them
+ * stack above it. A pending call counts towards the depth, so that no more
+ * than max_depth frames are ever laid out, and its body's height towards
+ * height, which bounds how deep evaluate recurses across calls. A method
+ * takes its receiver, when given, in the first slot, and args in the rest.
+ *
+ * A result lent out of the frame is handed back as its origin, which
+ * outlives the frame, so returning a parameter allocates nothing.
+ */
+static Object *callFunction(Interpreter *i, Function *f, Object *receiver, Expr **args,
+                            int line) {
+    if (i->depth == i->max_depth || f->height + 1 > i->max_height - i->height) {
+        error(line, "Stack overflow.\n");
+        return NULL;
+    }
+
+    FrameSlot *frame = i->frames + i->top;
+    size_t roots = HeapStackLen();
+    size_t first = 0;
+
+    i->depth++;
+    i->height += f->height + 1;
+
+    if (receiver != NULL) {
+        bind(&frame[0], receiver);
+        i->top++;
+        first = 1;
+    }
+
+    for (size_t k = first; k < f->arity; k++) {
+        Object *arg = evaluate(&i->base, args[k - first]);
+        if (arg == NULL) {
+            leave(i, f, frame, roots);
+            return NULL;
+        }
+
+        bind(&frame[k], arg);
+        i->top++;
+    }
+
+    FrameSlot *caller = i->frame;
+    uint64_t epoch = i->epoch;
+
+    i->frame = frame;
+    i->epoch = ++i->epochs;
+    Object *retval = evaluate(&i->base, f->body);
+    i->frame = caller;
+    i->epoch = epoch;
+
+    uintptr_t at = (uintptr_t)retval;
+    if (at >= (uintptr_t)frame && at < (uintptr_t)(frame + f->arity))
+        retval = origin((FrameSlot*)retval);
+
+    leave(i, f, frame, roots);
+    return retval;
+}
+
+/* Numbers are boxed afresh on the way into a field and out of it, as
+ * whoever owns one may overwrite it; anything else is stored as it is. */
+static Object *fieldValue(Object *value) {
+    switch (value->type) {
+    case OBJECT_NUMBER: return ObjectNum(value->value.f);
+    case OBJECT_BOOL: return ObjectBool(value->value.b);
+    case OBJECT_NIL: return ObjectNil();
+    default: return value;
+    }
+}
+
+static CacheEntry *cached(Interpreter *i, size_t site, const void *key) {
+    InlineCache *c = &i->caches[site];
+
+    for (size_t k = 0; k < c->n_entries; k++) {
+        if (c->entries[k].key == key) {
+            i->cache_stats.hits++;
+            return &c->entries[k];
+        }
+    }
+
+    return NULL;
+}
+
+/* Keeps what a slow lookup found, unless the site already holds as many
+ * receivers as it can. */
+static void remember(Interpreter *i, size_t site, CacheEntry entry) {
+    InlineCache *c = &i->caches[site];
+
+    if (c->n_entries == INTERPRETER_CACHE_WAYS) {
+        i->cache_stats.megamorphic++;
+        return;
+    }
+
+    i->cache_stats.misses++;
+    c->entries[c->n_entries++] = entry;
+}
+
+static void undefined(int line, const char *what, const char *name) {
+    char msg[128];
+    snprintf(msg, sizeof(msg), "Undefined %s '%.64s'.\n", what, name);
+    error(line, msg);
+}
+
+static void freeShapes(Interpreter *i) {
+    for (size_t k = 0; k < i->n_shapes; k++)
+        ShapeFree(i->shapes[k]);
+
+    free(i->shapes);
+    free(i->caches);
+    i->shapes = NULL;
+    i->n_shapes = 0;
+    i->caches = NULL;
+    i->n_caches = 0;
+    i->script = 0;
+}
+
+/* Shapes name the fields and classes of the Script they were made for, so
+ * they are made again for any other. */
+static void enterScript(Interpreter *i, Script *s) {
+    if (i->script == s->id)
+        return;
+
+    freeShapes(i);
+    i->script = s->id;
+    i->classes = s->classes;
+
+    i->shapes = malloc(s->n_classes * sizeof(Shape*));
+    for (size_t k = 0; k < s->n_classes; k++)
+        i->shapes[k] = ShapeRoot(&s->classes[k]);
+    i->n_shapes = s->n_classes;
+
+    i->caches = calloc(s->n_sites, sizeof(InlineCache));
+    i->n_caches = s->n_sites;
+}
+
+/*
+ * Evaluates a condition straight to a truth value. An 'and' or 'or' chain
+ * is a run of tests, each of which leaves as soon as it decides the whole:
+ * the first false one for 'and', the first true one for 'or'. A chain
+ * nested in another is walked here too rather than through the visitor,
+ * and no value is made for either.
+ */
+static bool test(Interpreter *i, Operation operation, Expr *condition, bool *value) {
+    if (condition->fini != LogicalFini) {
+        Object *obj = evaluate(&i->base, condition);
+        return obj != NULL && conditionOp(operation, obj, condition->type, value);
+    }
+
+    Logical *l = (Logical*)condition;
+    bool decided = l->operation == OPER_OR;
+
+    for (size_t k = 0; k < l->n_operands; k++) {
+        if (!test(i, l->operation, l->operands[k], value))
+            return false;
+        if (*value == decided)
+            return true;
+    }
+
+    return true;
+}
+
+/* ---- ExprVisitorS (grammar rules) ---- */
+
+static void *visitLiteralExpr(ExprVisitor *v, Literal *l) {
+    return &l->object;
+}
+
+static void *visitGroupingExpr(ExprVisitor *v, Grouping *g) {
+    return evaluate(v, g->expr);
+}
+
+static void *visitUnaryExpr(ExprVisitor *v, Unary *u) {
+    Object *obj = evaluate(v, u->right);
+    if (obj == NULL)
+        return NULL;
+
+    return unaryOp(u->operation, obj, u->right->type);
+}
+
+/*
+ * Objects are owned by the heap, so nothing here is ever freed. The left
+ * operand is kept on the heap's stack while the right one is evaluated, as
+ * that may trigger a collection which moves it out of the nursery.
+ */
+static void *visitBinaryExpr(ExprVisitor *v, Binary *b) {
+    Object *left = evaluate(v, b->left);
+    if (left == NULL)
+        return NULL;
+
+    HeapPush(left);
+    Object *right = evaluate(v, b->right);
+    left = HeapPop();
+
+    if (right == NULL)
+        return NULL;
+
+    return binaryOp(b->operation, left, b->left->type, right, b->right->type);
+}
+
 static void *visitTertiaryExpr(ExprVisitor *v, Tertiary *t) {
-    Object *condition = evaluate(v, t->condition);
-    Object *retval = NULL;
+    bool value;
 
-    if (condition->type != OBJECT_BOOL) {
-        error(1, "Tertiary operator expects condition to be a boolean.\n");
+    if (!test((Interpreter*)v, OPER_COMMA, t->condition, &value))
         return NULL;
+
+    return evaluate(v, value ? t->ifTrue : t->ifFalse);
+}
+
+static void *visitLogicalExpr(ExprVisitor *v, Logical *l) {
+    bool value;
+
+    if (!test((Interpreter*)v, l->operation, &l->base, &value))
+        return NULL;
+
+    return ObjectBool(value);
+}
+
+static void *visitVariableExpr(ExprVisitor *v, Variable *var) {
+    return argument((Interpreter*)v, var->slot, var->base.line);
+}
+
+static void *visitCallExpr(ExprVisitor *v, Call *c) {
+    return callFunction((Interpreter*)v, c->callee, NULL, c->args, c->base.line);
+}
+
+/* The instance is kept on the heap's stack while init runs, whose value
+ * is dropped for it. */
+static void *visitNewExpr(ExprVisitor *v, New *n) {
+    Interpreter *i = (Interpreter*)v;
+    Object *obj = ObjectInstance(i->shapes[n->klass - i->classes]);
+
+    if (n->klass->init == NULL)
+        return obj;
+
+    HeapPush(obj);
+    Object *retval = callFunction(i, n->klass->init, obj, n->args, n->base.line);
+    obj = HeapPop();
+
+    return retval != NULL ? obj : NULL;
+}
+
+static void *visitGetExpr(ExprVisitor *v, Get *g) {
+    Interpreter *i = (Interpreter*)v;
+    Object *obj = evaluate(v, g->object);
+    if (obj == NULL)
+        return NULL;
+
+    if (obj->type != OBJECT_INSTANCE) {
+        error(g->base.line, "Only instances have properties.\n");
+        return NULL;
+    }
+
+    Shape *shape = obj->value.instance.shape;
+    CacheEntry *entry = cached(i, g->site, shape);
+    size_t index;
+
+    if (entry != NULL) {
+        index = entry->index;
+    } else {
+        long found = ShapeLookup(shape, g->name);
+        if (found < 0) {
+            undefined(g->base.line, "property", g->name);
+            return NULL;
+        }
+
+        index = found;
+        remember(i, g->site, (CacheEntry){ .key = shape, .shape = shape, .index = index });
     }
 
-    if (condition->value.b)
-        retval = evaluate(v, t->ifTrue);
-    else
-        retval = evaluate(v, t->ifFalse);
-    
-    return retval; 
+    return fieldValue(obj->value.instance.fields[index]);
+}
+
+/* The instance and then the value are kept on the heap's stack while
+ * anything can still allocate. A new field moves the instance along a
+ * transition, which the cache remembers as well. */
+static void *visitSetExpr(ExprVisitor *v, Set *s) {
+    Interpreter *i = (Interpreter*)v;
+    Object *obj = evaluate(v, s->object);
+    if (obj == NULL)
+        return NULL;
+
+    if (obj->type != OBJECT_INSTANCE) {
+        error(s->base.line, "Only instances have fields.\n");
+        return NULL;
+    }
+
+    HeapPush(obj);
+    Object *value = evaluate(v, s->value);
+    if (value == NULL) {
+        HeapPop();
+        return NULL;
+    }
+
+    HeapPush(value);
+    Object *field = fieldValue(value);
+    value = HeapPop();
+    obj = HeapPop();
+
+    Shape *shape = obj->value.instance.shape;
+    CacheEntry *entry = cached(i, s->site, shape);
+    CacheEntry found;
+
+    if (entry == NULL) {
+        long index = ShapeLookup(shape, s->name);
+        Shape *next = index < 0 ? ShapeTransition(shape, s->name) : shape;
+
+        found = (CacheEntry){
+            .key = shape,
+            .shape = next,
+            .index = index < 0 ? next->n_fields - 1 : (size_t)index
+        };
+        remember(i, s->site, found);
+        entry = &found;
+    }
+
+    ObjectInstanceStore(obj, entry->shape, entry->index, field);
+    return value;
+}
+
+/* Methods are looked up by class rather than shape, as every instance of
+ * a class has the same ones whatever fields it was given. */
+static void *visitInvokeExpr(ExprVisitor *v, Invoke *inv) {
+    Interpreter *i = (Interpreter*)v;
+    Object *obj = evaluate(v, inv->object);
+    if (obj == NULL)
+        return NULL;
+
+    if (obj->type != OBJECT_INSTANCE) {
+        error(inv->base.line, "Only instances have methods.\n");
+        return NULL;
+    }
+
+    Class *klass = obj->value.instance.shape->klass;
+    CacheEntry *entry = cached(i, inv->site, klass);
+    size_t index = 0;
+
+    if (entry != NULL) {
+        index = entry->index;
+    } else {
+        while (index < klass->n_methods && strcmp(klass->methods[index].name, inv->name) != 0)
+            index++;
+
+        if (index == klass->n_methods) {
+            undefined(inv->base.line, "method", inv->name);
+            return NULL;
+        }
+
+        remember(i, inv->site, (CacheEntry){ .key = klass, .index = index });
+    }
+
+    Function *f = &klass->methods[index];
+    if (f->arity - 1 != inv->n_args) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "Expected %zu arguments but got %zu.\n",
+                 f->arity - 1, inv->n_args);
+        error(inv->base.line, msg);
+        return NULL;
+    }
+
+    return callFunction(i, f, obj, inv->args, inv->base.line);
+}
+
+/* The frames are laid out here, where no call is running yet. */
+static void *visitScriptExpr(ExprVisitor *v, Script *s) {
+    Interpreter *i = (Interpreter*)v;
+    size_t n = i->max_depth * s->max_arity;
+
+    enterScript(i, s);
+
+    if (n > i->n_frames || i->frames == NULL) {
+        free(i->frames);
+        i->frames = malloc((n > 0 ? n : 1) * sizeof(FrameSlot));
+        i->n_frames = n;
+
+        if (i->frames == NULL) {
+            error(s->base.line, "Not enough memory for the call stack.\n");
+            return NULL;
+        }
+    }
+
+    return evaluate(v, s->body);
 }
 
 /* ---- MAIN METHODS ---- */
 
 Interpreter InterpreterInit() {
     return (Interpreter){
-        .visitBinaryExpr = visitBinaryExpr,
-        .visitGroupingExpr = visitGroupingExpr,
-        .visitLiteralExpr = visitLiteralExpr,
-        .visitTertiaryExpr = visitTertiaryExpr,
-        .visitUnaryExpr = visitUnaryExpr
+        .base = (ExprVisitor){
+            .visitBinaryExpr = visitBinaryExpr,
+            .visitGroupingExpr = visitGroupingExpr,
+            .visitLiteralExpr = visitLiteralExpr,
+            .visitTertiaryExpr = visitTertiaryExpr,
+            .visitLogicalExpr = visitLogicalExpr,
+            .visitUnaryExpr = visitUnaryExpr,
+            .visitVariableExpr = visitVariableExpr,
+            .visitCallExpr = visitCallExpr,
+            .visitNewExpr = visitNewExpr,
+            .visitGetExpr = visitGetExpr,
+            .visitSetExpr = visitSetExpr,
+            .visitInvokeExpr = visitInvokeExpr,
+            .visitScriptExpr = visitScriptExpr
+        },
+        .max_depth = INTERPRETER_MAX_DEPTH,
+        .max_height = INTERPRETER_MAX_HEIGHT,
+        .fuel = SIZE_MAX
     };
 }
 
-Object *InterpretInterpret(Interpreter *i, const Expr *expr) {
-    return (Object*)expr->accept((ExprVisitor*)i, expr);
+void InterpreterFini(Interpreter *i) {
+    free(i->frames);
+    i->frames = NULL;
+    i->n_frames = 0;
+
+    free(i->shared);
+    i->shared = NULL;
+    i->n_shared = 0;
+
+    freeShapes(i);
+}
+
+void InterpreterBind(Interpreter *i, const Object *args, size_t n_args) {
+    i->args = args;
+    i->n_args = n_args;
+}
+
+/* Each evaluation starts at the top level, however the last one ended. */
+Object *InterpreterInterpret(Interpreter *i, Expr *expr) {
+    i->frame = NULL;
+    i->top = 0;
+    i->depth = 0;
+    i->height = 0;
+    i->epoch = ++i->epochs;
+    return evaluate((ExprVisitor*)i, expr);
+}
+
+Object *InterpreterUnary(Operation operation, Object *right) {
+    return unaryOp(operation, right, TYPE_DYNAMIC);
 }
 
+Object *InterpreterBinary(Operation operation, Object *left, Object *right) {
+    return binaryOp(operation, left, TYPE_DYNAMIC, right, TYPE_DYNAMIC);
+}
+
+bool InterpreterCondition(Operation operation, Object *condition, bool *value) {
+    return conditionOp(operation, condition, TYPE_DYNAMIC, value);
+}
+
+Object *InterpreterArgument(Interpreter *i, size_t slot, int line) {
+    return argument(i, slot, line);
+}
+
+void InterpreterPrintCacheStats(const CacheStats *s, FILE *f) {
+    size_t lookups = s->hits + s->misses + s->megamorphic;
+
+    fprintf(f, "IC: %zu lookups, %zu hits, %zu misses, %zu megamorphic\n",
+            lookups, s->hits, s->misses, s->megamorphic);
+    fprintf(f, "IC: hit rate %.1f%%\n", lookups ? 100.0 * s->hits / lookups : 0.0);
+}
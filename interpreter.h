@@ -1,11 +1,138 @@
 #ifndef INTERPRETER_H_
 #define INTERPRETER_H_
 
+#include <stdint.h>
+#include <stdio.h>
+
 #include "expr.h"
+#include "shape.h"
+
+/* Calls nested deeper than this fail with an error, well before the C
+ * stack could run out. */
+#define INTERPRETER_MAX_DEPTH 1024
+
+/* So do calls whose bodies nest deeper than this between them. Together
+ * with the tree they start from, that is a few MiB of C stack at most. */
+#define INTERPRETER_MAX_HEIGHT 16384
+
+/* How many receivers a property access remembers before it gives up on
+ * caching them. */
+#define INTERPRETER_CACHE_WAYS 4
+
+/* The value of a shared node, if it was computed during the evaluation
+ * numbered epoch. A borrowed value is kept as is; an owned number is
+ * rebuilt from number, so that every use gets a copy it may overwrite. */
+typedef struct {
+    uint64_t epoch;
+    const Object *value;
+    double number;
+} SharedValue;
+
+/* What a property access found for one receiver: the index of a field of
+ * the shape key, which moves to shape when the field is added, or of a
+ * method of the class key. */
+typedef struct {
+    const void *key;
+    Shape *shape;
+    size_t index;
+} CacheEntry;
+
+typedef struct {
+    CacheEntry entries[INTERPRETER_CACHE_WAYS];
+    size_t n_entries;
+} InlineCache;
+
+/* A miss fills an entry; a megamorphic lookup is one at a site that is
+ * full, and goes the slow way every time. */
+typedef struct {
+    size_t hits;
+    size_t misses;
+    size_t megamorphic;
+} CacheStats;
 
-typedef ExprVisitor Interpreter;
+/*
+ * An argument of an active call. Numbers, booleans and nil are copied into
+ * value and lent out from there; strings, which nothing writes to, and
+ * instances, which are written to where they live, are lent out as they
+ * are. origin is what the caller passed, and what a function
+ * that returns its own parameter hands back. An owned origin is kept on
+ * the heap's stack, at index root - 1, as a collection may move it.
+ */
+typedef struct {
+    Object value;
+    Object *origin;
+    size_t root;
+} FrameSlot;
+
+/*
+ * Every call takes the next arity slots of one block, allocated when a
+ * Script is entered with room for max_depth frames of its largest arity,
+ * and never moved while it runs. frame is the running call's first slot,
+ * or NULL at the top level, where parameters are the bound args.
+ *
+ * Each call is an evaluation of its own as far as shared nodes go, so
+ * epoch is the running call's, and epochs counts them all.
+ */
+typedef struct {
+    ExprVisitor base;
+    const Object *args;
+    size_t n_args;
+
+    FrameSlot *frames;
+    size_t n_frames;
+    size_t top;
+    FrameSlot *frame;
+    size_t depth;
+    size_t max_depth;
+    size_t height;
+    size_t max_height;
+
+    uint64_t epoch;
+    uint64_t epochs;
+    SharedValue *shared;
+    size_t n_shared;
+
+    /* The root shape of each class and the cache of each site of the
+     * Script numbered script, made when it is entered. */
+    uint64_t script;
+    Class *classes;
+    Shape **shapes;
+    size_t n_shapes;
+    InlineCache *caches;
+    size_t n_caches;
+    CacheStats cache_stats;
+
+    /*
+     * Every node evaluated is a step, and fuel counts those left before
+     * pause is called. It gives the steps to take next, from wherever the
+     * evaluation is, or 0 to end it with the error it reported. Without
+     * pause, fuel never runs out in practice. The heap's limit is checked
+     * whenever it does.
+     */
+    size_t fuel;
+    size_t (*pause)(void *ctx, int line);
+    void *pause_ctx;
+} Interpreter;
 
 Interpreter InterpreterInit();
+void InterpreterFini(Interpreter *i);
+
+/* Values for the parameters the expression was parsed with, in order. They
+ * are borrowed for the duration of each InterpreterInterpret call and must
+ * not live on the heap. */
+void InterpreterBind(Interpreter *i, const Object *args, size_t n_args);
 Object *InterpreterInterpret(Interpreter *i, Expr *e);
 
+/* The operators on values that are already evaluated, with the same checks
+ * and errors as InterpreterInterpret, for code that evaluates operands
+ * itself. Operands are consumed as by the evaluator. */
+Object *InterpreterUnary(Operation operation, Object *right);
+Object *InterpreterBinary(Operation operation, Object *left, Object *right);
+/* operation is OPER_AND or OPER_OR for an operand of those; anything else
+ * stands for the condition of '?:'. */
+bool InterpreterCondition(Operation operation, Object *condition, bool *value);
+Object *InterpreterArgument(Interpreter *i, size_t slot, int line);
+
+void InterpreterPrintCacheStats(const CacheStats *s, FILE *f);
+
 #endif
@@ -1,10 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 
 #include "lexer.h"
 #include "logging.h"
+#include "strkernel.h"
 
 /* ---- HELPER FUNCTIONS ---- */
 
@@ -17,9 +19,10 @@ static char __peekNext(const Lexer *t);
 static char __advance(Lexer *t);
 static Token __createToken(const Lexer *t, TokenType type);
 static bool __match(Lexer *t, char expected);
-static void __skipMultiline(Lexer *t);
+static bool __skipMultiline(Lexer *t);
 static void __skipWhitespace(Lexer *t);
 static void __skipSingleline(Lexer *t);
+static void __error(const Lexer *t, const char *msg);
 
 static __Map __MapInit(void);
 static void __MapFini(__Map *m);
@@ -27,6 +30,16 @@ static void __MapFini(__Map *m);
 static void __MapSet(__Map *m, const char *str, TokenType value);
 static TokenType __MapGet(__Map *m, const char *key, size_t keylen, TokenType default_ret);
 
+/* Literals longer than this are copied to the heap before strtod reads
+ * them. */
+#define NUMBER_BUFFER_SIZE 64
+
+/* Every power of ten a double holds exactly. */
+static const double powersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
 /* ---- MAIN DEFINITIONS ---- */
 
 Token TokenInit(TokenType type, const char *lexeme, size_t lexeme_len) {
@@ -37,6 +50,64 @@ Token TokenInit(TokenType type, const char *lexeme, size_t lexeme_len) {
     };
 }
 
+/*
+ * Reads the lexeme in place. Digits that fit in 53 bits, over a power of
+ * ten that is exact, give the correctly rounded value with a single
+ * division, as strtod would; only longer literals go to strtod itself,
+ * from a copy that is NUL terminated.
+ */
+double TokenNumber(const Token *token) {
+    const char *s = token->lexeme;
+    size_t len = token->lexeme_len;
+    uint64_t mantissa = 0;
+    size_t fraction = 0;
+    bool point = false, exact = true;
+
+    for (size_t i = 0; i < len && exact; i++) {
+        if (s[i] == '.') {
+            point = true;
+            continue;
+        }
+
+        mantissa = mantissa * 10 + (uint64_t)(s[i] - '0');
+        fraction += point;
+        exact = mantissa <= (UINT64_C(1) << 53) &&
+                fraction < sizeof(powersOfTen) / sizeof(powersOfTen[0]);
+    }
+
+    if (exact)
+        return (double)mantissa / powersOfTen[fraction];
+
+    char buffer[NUMBER_BUFFER_SIZE];
+    char *copy = len < sizeof(buffer) ? buffer : malloc(len + 1);
+
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    double retval = strtod(copy, NULL);
+
+    if (copy != buffer)
+        free(copy);
+    return retval;
+}
+
+TokenList TokenListInit(void) {
+    return (TokenList){ .tokens = NULL, .len = 0, .cap = 0 };
+}
+
+void TokenListFini(TokenList *list) {
+    free(list->tokens);
+    *list = TokenListInit();
+}
+
+void TokenListPush(TokenList *list, Token token) {
+    if (list->len == list->cap) {
+        list->cap = list->cap ? list->cap * 2 : 256;
+        list->tokens = realloc(list->tokens, list->cap * sizeof(Token));
+    }
+
+    list->tokens[list->len++] = token;
+}
+
 Lexer LexerInit(const char *str, size_t len) {
     Lexer retval = {
         .source = str,
@@ -44,6 +115,8 @@ Lexer LexerInit(const char *str, size_t len) {
         .start = 0,
         .current = 0,
         .line = 1,
+        .start_line = 1,
+        .quiet = false,
         .reserved = __MapInit()
     };
 
@@ -75,12 +148,44 @@ bool LexerIsDone(const Lexer *l) {
     return l->current >= l->source_len;
 }
 
+void LexerReset(Lexer *l, const char *source, size_t len) {
+    l->source = source;
+    l->source_len = len;
+    l->start = 0;
+    l->current = 0;
+    l->line = 1;
+    l->start_line = 1;
+}
+
+bool LexerTokenizeAll(Lexer *l, TokenList *out) {
+    while (!LexerIsDone(l)) {
+        Token token = LexerGetToken(l);
+        if (token.type == TOKEN_EOF)
+            break;
+
+        if (token.type == TOKEN_ILLEGAL)
+            return false;
+
+        TokenListPush(out, token);
+    }
+
+    return true;
+}
+
+bool LexerTokenize(const char *source, size_t len, TokenList *out) {
+    Lexer lexer = LexerInit(source, len);
+    bool retval = LexerTokenizeAll(&lexer, out);
+    LexerFini(&lexer);
+    return retval;
+}
+
 Token LexerGetToken(Lexer *t) {
     __skipWhitespace(t);
     if (LexerIsDone(t))
         return TokenEOF;
     
     t->start = t->current;
+    t->start_line = t->line;
     char c = __advance(t);
     
     switch (c) {
@@ -109,20 +214,17 @@ Token LexerGetToken(Lexer *t) {
 
     case '*':
         if (__peek(t) == '/') {
-            error(t->line, "Dangling multiline comment end.\n");
+            __error(t, "Dangling multiline comment end.\n");
             return TokenIllegal;
         }
         return __createToken(t, TOKEN_STAR);
     
     case '"':
-        while (__peek(t) != '"' && !LexerIsDone(t)) {
-            if (__peek(t) == '\n')
-                t->line++;
+        while (__peek(t) != '"' && !LexerIsDone(t))
             __advance(t);
-        }
 
         if (LexerIsDone(t)) {
-            error(t->line, "Unterminated string.\n");
+            __error(t, "Unterminated string.\n");
             return TokenIllegal;
         }
 
@@ -133,15 +235,16 @@ Token LexerGetToken(Lexer *t) {
     case '/':
         if (__match(t, '/'))
             __skipSingleline(t);
-        else if (__match(t, '*'))
-            __skipMultiline(t);
-        else
+        else if (__match(t, '*')) {
+            if (!__skipMultiline(t))
+                return TokenIllegal;
+        } else
             return __createToken(t, TOKEN_SLASH);
 
         t->start = t->current;
         if (LexerIsDone(t))
-            break;
-        
+            return TokenEOF;
+
         return LexerGetToken(t);
 
     default:
@@ -159,7 +262,7 @@ Token LexerGetToken(Lexer *t) {
         }
 
         if (__isAlpha(__peek(t))) {
-            error(t->line, "Numeric literal cannot be followed by an underscore or alphabetical character.\n");
+            __error(t, "Numeric literal cannot be followed by an underscore or alphabetical character.\n");
             return TokenIllegal;
         }
 
@@ -175,7 +278,7 @@ Token LexerGetToken(Lexer *t) {
         return __createToken(t, type);
     }
 
-    error(t->line, "Unexpected character.\n");
+    __error(t, "Unexpected character.\n");
     return TokenIllegal;
 }
 
@@ -211,18 +314,28 @@ static char __peekNext(const Lexer *t) {
     return t->source[t->current + 1];
 }
 
+/* The only place that consumes a newline, so line is always one more than
+ * the number of newlines before current. */
 static char __advance(Lexer *t) {
-    char c = __peek(t);
-    if (c != '\0')
-        t->current++;
-    else if (c == '\n')
+    if (LexerIsDone(t))
+        return '\0';
+
+    char c = t->source[t->current++];
+    if (c == '\n')
         t->line++;
 
     return c;
 }
 
 static Token __createToken(const Lexer *t, TokenType type) {
-    return TokenInit(type, &t->source[t->start], t->current - t->start);
+    Token retval = TokenInit(type, &t->source[t->start], t->current - t->start);
+    retval.line = t->start_line;
+    return retval;
+}
+
+static void __error(const Lexer *t, const char *msg) {
+    if (!t->quiet)
+        error(t->line, msg);
 }
 
 static bool __match(Lexer *t, char expected) {
@@ -233,7 +346,7 @@ static bool __match(Lexer *t, char expected) {
     return true;
 }
 
-static void __skipMultiline(Lexer *t) {
+static bool __skipMultiline(Lexer *t) {
     while (!LexerIsDone(t)) {
         char c = __advance(t);
         if (c != '*')
@@ -241,19 +354,17 @@ static void __skipMultiline(Lexer *t) {
 
         if (__peek(t) == '/') {
             __advance(t);
-            return;
+            return true;
         }
     }    
 
-    error(t->line, "Unmatched multiline comment.\n");
+    __error(t, "Unmatched multiline comment.\n");
+    return false;
 }
 
 static void __skipSingleline(Lexer *t) {
-    while (__peek(t) != '\n' && LexerIsDone(t))
+    while (__peek(t) != '\n' && !LexerIsDone(t))
         __advance(t);
-    
-    if (__peek(t) == '\n')
-        t->line++;
 }
 
 static void __skipWhitespace(Lexer *t) {
@@ -261,8 +372,8 @@ static void __skipWhitespace(Lexer *t) {
         __advance(t);
 }
 
-static inline int __hash(const char *str, size_t len) {
-    return str[0] + str[len - 1] + len;
+static inline size_t __hash(const char *str, size_t len) {
+    return StrHash(str, len);
 }
 
 static __Entry *__pair(const char *key, TokenType value) {
@@ -298,7 +409,7 @@ static void __MapFini(__Map *m) {
 }
 
 static void __MapSet(__Map *m, const char *key, TokenType value) {
-    int i = __hash(key, strlen(key)) % TABLE_SIZE;
+    size_t i = __hash(key, strlen(key)) % TABLE_SIZE;
 
     if (m->buckets[i] == NULL) {
         m->buckets[i] = __pair(key, value);
@@ -317,7 +428,7 @@ static void __MapSet(__Map *m, const char *key, TokenType value) {
 }
 
 static TokenType __MapGet(__Map *m, const char *key, size_t keysize, TokenType default_ret) {
-    int i = __hash(key, keysize) % TABLE_SIZE;
+    size_t i = __hash(key, keysize) % TABLE_SIZE;
 
     for (__Entry *iter = m->buckets[i]; iter != NULL; iter = iter->next) {
         if (strlen(iter->key) != keysize)
@@ -1,6 +1,7 @@
 #ifndef TOKENIZER_H_
 #define TOKENIZER_H_
 
+#include <stdbool.h>
 #include <stddef.h>
 
 #include "object.h"
@@ -37,9 +38,22 @@ typedef struct {
 
 Token TokenInit(TokenType type, const char *lexeme, size_t lexeme_len);
 
+/* The value of a TOKEN_NUMBER, rounded exactly as strtod rounds it. */
+double TokenNumber(const Token *token);
+
 #define TokenIllegal (Token){ .type = TOKEN_ILLEGAL }
 #define TokenEOF (Token){ .type = TOKEN_EOF }
 
+typedef struct {
+    Token *tokens;
+    size_t len;
+    size_t cap;
+} TokenList;
+
+TokenList TokenListInit(void);
+void TokenListFini(TokenList *list);
+void TokenListPush(TokenList *list, Token token);
+
 typedef struct {
     char *key;
     TokenType value;
@@ -56,13 +70,24 @@ typedef struct {
     size_t start;
     size_t current;
     size_t line;
+    /* The line start is on, which a token spanning several is given. */
+    size_t start_line;
+    bool quiet;
     __Map reserved;
 } Lexer;
 
 Lexer LexerInit(const char *source, size_t len);
 void LexerFini(Lexer *l);
+
+/* Points the lexer at a new source, keeping its keyword table. */
+void LexerReset(Lexer *l, const char *source, size_t len);
 Token LexerGetToken(Lexer *l);
 bool LexerIsDone(const Lexer* l);
 
+/* Lexes the whole source into out, without the trailing EOF. Returns false
+ * on the first illegal token. */
+bool LexerTokenize(const char *source, size_t len, TokenList *out);
+bool LexerTokenizeAll(Lexer *l, TokenList *out);
+
 #endif
 
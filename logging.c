@@ -1,9 +1,19 @@
 #include <stdio.h>
-#include <string.h>
 
 #include "logging.h"
 
-bool hadError = false;
+_Thread_local bool hadError = false;
+
+static _Thread_local char *captureBuf = NULL;
+static _Thread_local size_t captureSize = 0;
+
+void reportCapture(char *buf, size_t size) {
+    captureBuf = buf;
+    captureSize = size;
+
+    if (buf != NULL && size > 0)
+        buf[0] = '\0';
+}
 
 void report(ReportLevel level, const char *where, int line, const char *msg) {
     const char *str_level = NULL;
@@ -14,6 +24,17 @@ void report(ReportLevel level, const char *where, int line, const char *msg) {
     case LEVEL_ERROR: str_level = "ERROR"; break;
     }
 
+    if (captureBuf != NULL) {
+        if (captureBuf[0] != '\0')
+            return;
+
+        if (where != NULL)
+            snprintf(captureBuf, captureSize, "[%s @ line %d] %s: %s", str_level, line, where, msg);
+        else
+            snprintf(captureBuf, captureSize, "[%s @ line %d] %s", str_level, line, msg);
+        return;
+    }
+
     if (where != NULL)
         fprintf(stderr, "[%s @ line %d] %s: %s", str_level, line, where, msg);
     else
@@ -29,9 +50,12 @@ void error1(Token token, const char *msg) {
     if (token.type == TOKEN_EOF) {
         report(LEVEL_ERROR, "At the end", token.line, msg);
     } else {
-        char where[50] = "At '";
-        strncat(where, token.lexeme, token.lexeme_len);
-        strcat(where, "'");
+        /* Long lexemes are cut short, so that they still fit with their
+         * closing quote. */
+        char where[50];
+        size_t max = sizeof(where) - sizeof("At ''");
+        int len = (int)(token.lexeme_len < max ? token.lexeme_len : max);
+        snprintf(where, sizeof(where), "At '%.*s'", len, token.lexeme);
         report(LEVEL_ERROR, where, token.line, msg);
     }
 
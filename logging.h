@@ -2,10 +2,12 @@
 #define LOGGING_H_
 
 #include <stdbool.h>
+#include <stddef.h>
 
 #include "lexer.h"
 
-extern bool hadError;
+/* Per thread, so that batch workers do not see each other's errors. */
+extern _Thread_local bool hadError;
 
 typedef enum {
     LEVEL_INFO,
@@ -14,6 +16,10 @@ typedef enum {
 } ReportLevel;
 
 void report(ReportLevel level, const char *where, int line, const char *msg);
+
+/* Keeps the first report made on this thread in buf instead of printing
+ * it. NULL goes back to stderr. */
+void reportCapture(char *buf, size_t size);
 void error(int line, const char *msg);
 void error1(Token token, const char *msg);
 
@@ -0,0 +1,757 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "lox.h"
+#include "logging.h"
+#include "lexer.h"
+#include "parser.h"
+#include "interpreter.h"
+#include "heap.h"
+#include "pool.h"
+#include "columnar.h"
+#include "optimize.h"
+
+#define LOX_ERROR_SIZE 256
+#define LOX_BASELINE_LEVEL 0
+#define LOX_OPTIMIZE_LEVEL 2
+
+/* A task's stack is only backed by memory as deep as it is used, and has
+ * room for the deepest evaluation the parser and INTERPRETER_MAX_HEIGHT
+ * let through. Its nursery is small, as there may be thousands of tasks. */
+#define LOX_TASK_STACK_SIZE (8u << 20)
+#define LOX_TASK_NURSERY_SIZE 256
+
+/* Interpreters each thread keeps, so that a host taking turns among a few
+ * handles does not make one's shapes and caches again for every call. */
+#define LOX_THREAD_INTERPRETERS 8
+
+/* One of the trees a handle can run, and the arena its nodes live in. */
+typedef struct {
+    Expr *expr;
+    PoolArena *arena;
+} Tier;
+
+/* A columnar program for one tree and one signature of parameter types,
+ * which it keeps in program.params. Entries are only ever added, as other
+ * threads may be running one, and go with the handle. */
+typedef struct ColumnEntry {
+    Expr *expr;
+    ColumnProgram program;
+    struct ColumnEntry *next;
+} ColumnEntry;
+
+/*
+ * The trees are shared by every evaluating thread and never written, so the
+ * hotness counter lives here. current starts out at the baseline tree and
+ * is swapped for the optimized one once that is built; the baseline is kept
+ * until lox_free, since other threads may still be walking it.
+ */
+struct lox_handle {
+    _Atomic(Expr*) current;
+    size_t n_params;
+
+    Tier baseline;
+    Tier optimized;
+    _Atomic(ColumnEntry*) programs;
+
+    atomic_size_t evals;
+    atomic_flag promoting;
+    bool compiler_started;
+    pthread_t compiler;
+
+    char *source;
+    char **params;
+};
+
+/*
+ * What a thread keeps from one lox_eval to the next: the heap temporaries
+ * are bump-allocated from, and interpreters whose frames, shapes and
+ * inline caches stay warm for the Script they last entered. A tree always
+ * gets the same one of them, picked by its address. lox_eval_args binds
+ * into args, and lox_eval_columns describes its inputs in types and
+ * columns; all three only ever grow. result is the long string last
+ * returned, which the host may pass straight back as an argument.
+ */
+typedef struct {
+    Heap heap;
+    Interpreter interpreters[LOX_THREAD_INTERPRETERS];
+
+    Object *args;
+    size_t args_cap;
+    Object *result;
+
+    ColumnType *types;
+    Column *columns;
+    size_t columns_cap;
+} ThreadState;
+
+/*
+ * The evaluation runs on stack, and returns to caller, where lox_resume
+ * was called, whenever its slice of steps runs out; context is where it
+ * picks up again. steps_left is what its quota has left to hand out, and
+ * granted what has been handed out so far.
+ */
+struct lox_task {
+    Interpreter interpreter;
+    Heap heap;
+    Expr *expr;
+    Object *bound;
+    size_t n_args;
+
+    ucontext_t caller;
+    ucontext_t context;
+    void *stack;
+
+    uint64_t slice;
+    uint64_t steps_left;
+    uint64_t granted;
+
+    bool started;
+    bool done;
+    bool abandoned;
+    Object *value;
+    lox_value result;
+};
+
+static _Thread_local char lastError[LOX_ERROR_SIZE];
+static _Thread_local lox_task *running;
+
+static atomic_size_t tierThreshold = LOX_TIER_THRESHOLD;
+static atomic_size_t compiles;
+static atomic_size_t promotions;
+static atomic_size_t failedPromotions;
+static atomic_uint_least64_t compileNs;
+static atomic_uint_least64_t promoteNs;
+
+static pthread_key_t stateKey;
+static pthread_once_t stateOnce = PTHREAD_ONCE_INIT;
+
+/* ---- HELPER FUNCTIONS ---- */
+
+static uint64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* Runs at thread exit. The old generation lives in this thread's pool
+ * slabs, so those go too. */
+static void stateDestroy(void *state) {
+    ThreadState *t = state;
+
+    for (size_t i = 0; i < LOX_THREAD_INTERPRETERS; i++)
+        InterpreterFini(&t->interpreters[i]);
+
+    HeapFini(&t->heap);
+    free(t->args);
+    free(t->types);
+    free(t->columns);
+    free(t);
+    PoolReleaseAll();
+}
+
+static void stateKeyInit(void) {
+    pthread_key_create(&stateKey, stateDestroy);
+}
+
+static ThreadState *threadState(void) {
+    pthread_once(&stateOnce, stateKeyInit);
+
+    ThreadState *retval = pthread_getspecific(stateKey);
+    if (retval == NULL) {
+        retval = malloc(sizeof(ThreadState));
+        *retval = (ThreadState){ .heap = HeapInit(HEAP_NURSERY_SIZE) };
+        for (size_t i = 0; i < LOX_THREAD_INTERPRETERS; i++)
+            retval->interpreters[i] = InterpreterInit();
+        pthread_setspecific(stateKey, retval);
+    }
+
+    return retval;
+}
+
+static Interpreter *treeInterpreter(ThreadState *t, const Expr *expr) {
+    return &t->interpreters[((uintptr_t)expr / POOL_GRANULE) % LOX_THREAD_INTERPRETERS];
+}
+
+static void beginCapture(void) {
+    reportCapture(lastError, sizeof(lastError));
+    hadError = false;
+}
+
+static void endCapture(void) {
+    size_t len = strlen(lastError);
+    if (len > 0 && lastError[len - 1] == '\n')
+        lastError[len - 1] = '\0';
+
+    reportCapture(NULL, 0);
+}
+
+static Object toObject(const lox_value *value) {
+    switch (value->type) {
+    case LOX_BOOL:
+        return ObjectConstBool(value->as.boolean);
+    case LOX_NUMBER:
+        return ObjectConstNum(value->as.number);
+    case LOX_STRING:
+        return ObjectConstStr(value->as.string.chars, value->as.string.len);
+    default:
+        return ObjectConstNil;
+    }
+}
+
+static lox_value fromObject(Object *value) {
+    lox_value retval = { .type = LOX_ERROR };
+
+    if (value == NULL)
+        return retval;
+
+    switch (value->type) {
+    case OBJECT_NIL:
+        retval.type = LOX_NIL;
+        break;
+    case OBJECT_BOOL:
+        retval.type = LOX_BOOL;
+        retval.as.boolean = value->value.b;
+        break;
+    case OBJECT_NUMBER:
+        retval.type = LOX_NUMBER;
+        retval.as.number = value->value.f;
+        break;
+    case OBJECT_STRING:
+        retval.type = LOX_STRING;
+        retval.as.string.chars = ObjectStrChars(value);
+        retval.as.string.len = ObjectStrLen(value);
+        break;
+    case OBJECT_INSTANCE:
+        error(1, "An instance cannot be returned to the host.\n");
+        break;
+    }
+
+    return retval;
+}
+
+/* Parses source into a fresh arena and optimizes it at level. Errors go
+ * to lastError. */
+static Tier compileTier(const char *source, const char *const *params, size_t n_params,
+                        int level) {
+    bool savedError = hadError;
+    TokenList tokens = TokenListInit();
+    Tier retval = { .arena = PoolArenaCreate() };
+    PoolArena *previous = PoolArenaSwitch(retval.arena);
+
+    beginCapture();
+
+    if (LexerTokenize(source, strlen(source), &tokens)) {
+        TokenListPush(&tokens, TokenEOF);
+
+        Parser parser = ParserInitParams(tokens.tokens, params, n_params);
+        retval.expr = ParserParse(&parser);
+    }
+
+    if (retval.expr != NULL) {
+        Optimizer optimizer = OptimizerInit(level);
+        retval.expr = OptimizerRun(&optimizer, retval.expr);
+    }
+
+    endCapture();
+    hadError = savedError;
+    PoolArenaSwitch(previous);
+    TokenListFini(&tokens);
+
+    if (retval.expr == NULL) {
+        PoolArenaDestroy(retval.arena);
+        retval.arena = NULL;
+    }
+
+    return retval;
+}
+
+/* Literal strings live outside the arena, so the tree is still walked
+ * once; the nodes themselves go back with the arena in one piece. */
+static void tierFini(Tier *tier) {
+    if (tier->expr == NULL)
+        return;
+
+    PoolArena *previous = PoolArenaSwitch(tier->arena);
+    ExprFini(tier->expr);
+    PoolArenaSwitch(previous);
+    PoolArenaDestroy(tier->arena);
+}
+
+static void *promote(void *arg) {
+    lox_handle *h = arg;
+    uint64_t start = nowNs();
+    Tier tier = compileTier(h->source, (const char *const*)h->params, h->n_params,
+                            LOX_OPTIMIZE_LEVEL);
+
+    /* The source compiled once already, so this only fails if memory runs
+     * out; the handle then stays on its baseline. */
+    if (tier.expr == NULL) {
+        atomic_fetch_add(&failedPromotions, 1);
+        return NULL;
+    }
+
+    h->optimized = tier;
+    atomic_store_explicit(&h->current, tier.expr, memory_order_release);
+
+    atomic_fetch_add(&promotions, 1);
+    atomic_fetch_add(&promoteNs, nowNs() - start);
+    return NULL;
+}
+
+/*
+ * Counts n evaluations against a handle still on its baseline, and starts
+ * its recompile once they pass the threshold. Only the evaluation that
+ * wins the flag starts it; if no thread can be made, it compiles in place.
+ */
+static Expr *enter(const lox_handle *handle, size_t n) {
+    lox_handle *h = (lox_handle*)handle;
+    Expr *retval = atomic_load_explicit(&h->current, memory_order_acquire);
+
+    if (retval != h->baseline.expr)
+        return retval;
+
+    size_t evals = atomic_fetch_add_explicit(&h->evals, n, memory_order_relaxed) + n;
+    if (evals < atomic_load_explicit(&tierThreshold, memory_order_relaxed) ||
+        atomic_flag_test_and_set(&h->promoting))
+        return retval;
+
+    if (pthread_create(&h->compiler, NULL, promote, h) == 0) {
+        h->compiler_started = true;
+        return retval;
+    }
+
+    promote(h);
+    return atomic_load_explicit(&h->current, memory_order_acquire);
+}
+
+static ColumnType columnType(const lox_column *column) {
+    return column->type == LOX_BOOL ? COLUMN_BOOL : COLUMN_NUMBER;
+}
+
+/* The handle's program for expr and the types of inputs, compiled on first
+ * use. Two threads missing at once both add one, which does no harm. NULL
+ * after reporting an error. */
+static const ColumnProgram *columnProgram(const lox_handle *handle, ThreadState *t, Expr *expr,
+                                          const lox_column *inputs) {
+    lox_handle *h = (lox_handle*)handle;
+    ColumnEntry *head = atomic_load_explicit(&h->programs, memory_order_acquire);
+
+    for (ColumnEntry *e = head; e != NULL; e = e->next) {
+        if (e->expr != expr)
+            continue;
+
+        size_t i = 0;
+        while (i < h->n_params && e->program.params[i] == columnType(&inputs[i]))
+            i++;
+        if (i == h->n_params)
+            return &e->program;
+    }
+
+    for (size_t i = 0; i < h->n_params; i++)
+        t->types[i] = columnType(&inputs[i]);
+
+    ColumnEntry *retval = malloc(sizeof(ColumnEntry));
+    retval->expr = expr;
+    if (!ColumnCompile(expr, t->types, h->n_params, &retval->program)) {
+        free(retval);
+        return NULL;
+    }
+
+    retval->next = head;
+    while (!atomic_compare_exchange_weak_explicit(&h->programs, &retval->next, retval,
+                                                  memory_order_release, memory_order_acquire))
+        ;
+
+    return &retval->program;
+}
+
+static Object *copyArgs(const lox_value *args, size_t n_args) {
+    Object *retval = n_args > 0 ? malloc(n_args * sizeof(Object)) : NULL;
+
+    for (size_t i = 0; i < n_args; i++)
+        retval[i] = toObject(&args[i]);
+
+    return retval;
+}
+
+/* Whether value is the string result, which is still in the heap. */
+static bool isResult(const Object *result, const lox_value *value) {
+    return result != NULL && value->type == LOX_STRING &&
+           value->as.string.chars == result->value.chars && value->as.string.len == result->len;
+}
+
+/* Binds args into the thread's buffer. The last result is bound without a
+ * copy, and true returned, in which case it must be kept alive. */
+static bool bindArgs(ThreadState *t, const lox_value *args, size_t n_args) {
+    bool retval = false;
+
+    if (n_args > t->args_cap) {
+        t->args = realloc(t->args, n_args * sizeof(Object));
+        t->args_cap = n_args;
+    }
+
+    for (size_t i = 0; i < n_args; i++) {
+        if (isResult(t->result, &args[i])) {
+            t->args[i] = (Object){
+                .type = OBJECT_STRING,
+                .gen = GEN_CONST,
+                .repr = STR_FLAT,
+                .len = t->result->len,
+                .value.chars = t->result->value.chars
+            };
+            retval = true;
+        } else {
+            t->args[i] = toObject(&args[i]);
+        }
+    }
+
+    return retval;
+}
+
+/* Strings whose characters are kept are only borrowed, and not freed. */
+static void releaseArgs(Object *bound, size_t n_args, const char *kept) {
+    for (size_t i = 0; i < n_args; i++) {
+        if (bound[i].type != OBJECT_STRING || bound[i].value.chars != kept)
+            ObjectStrRelease(&bound[i]);
+    }
+}
+
+/*
+ * Called on the task's stack when the steps handed out last run out. The
+ * quota is checked before suspending, so that a task over it fails at
+ * once rather than on its next turn. With a memory limit, steps are handed
+ * out in small enough pieces for the interpreter to check it often.
+ */
+static size_t taskPause(void *ctx, int line) {
+    lox_task *t = ctx;
+
+    if (!t->abandoned && t->steps_left > 0 && t->slice == 0)
+        swapcontext(&t->context, &t->caller);
+
+    if (t->abandoned) {
+        error(line, "Evaluation was abandoned.\n");
+        return 0;
+    }
+
+    if (t->steps_left == 0) {
+        error(line, "Evaluation ran out of steps.\n");
+        return 0;
+    }
+
+    uint64_t grant = t->slice < t->steps_left ? t->slice : t->steps_left;
+    if (t->heap.limit != 0 && grant > LOX_QUOTA_CHECK_STEPS)
+        grant = LOX_QUOTA_CHECK_STEPS;
+    if (grant > SIZE_MAX)
+        grant = SIZE_MAX;
+
+    t->slice -= grant;
+    t->steps_left -= grant;
+    t->granted += grant;
+    return grant;
+}
+
+/* Returns to caller through uc_link once the evaluation is over. */
+static void taskMain(void) {
+    lox_task *t = running;
+
+    t->value = InterpreterInterpret(&t->interpreter, t->expr);
+    t->done = true;
+}
+
+/* Switches to the task until it suspends or finishes, on its own heap and
+ * with its errors going to lastError. */
+static void switchTo(lox_task *t) {
+    Heap *previous = HeapCurrent();
+    lox_task *outer = running;
+
+    HeapSetCurrent(&t->heap);
+    running = t;
+    t->started = true;
+    swapcontext(&t->caller, &t->context);
+    running = outer;
+    HeapSetCurrent(previous);
+}
+
+/* ---- MAIN METHODS ---- */
+
+lox_handle *lox_compile(const char *source) {
+    return lox_compile_params(source, NULL, 0);
+}
+
+/* Most handles are evaluated a handful of times, so they start out on the
+ * unoptimized tree; lox_eval promotes the ones that turn out to be hot. */
+lox_handle *lox_compile_params(const char *source, const char *const *params, size_t n_params) {
+    uint64_t start = nowNs();
+    Tier tier = compileTier(source, params, n_params, LOX_BASELINE_LEVEL);
+
+    if (tier.expr == NULL)
+        return NULL;
+
+    lox_handle *retval = malloc(sizeof(lox_handle));
+    *retval = (lox_handle){
+        .n_params = n_params,
+        .baseline = tier,
+        .source = strdup(source),
+        .params = n_params > 0 ? malloc(n_params * sizeof(char*)) : NULL
+    };
+    atomic_init(&retval->current, tier.expr);
+    atomic_init(&retval->evals, 0);
+    atomic_init(&retval->programs, NULL);
+    atomic_flag_clear(&retval->promoting);
+
+    for (size_t i = 0; i < n_params; i++)
+        retval->params[i] = strdup(params[i]);
+
+    atomic_fetch_add(&compiles, 1);
+    atomic_fetch_add(&compileNs, nowNs() - start);
+
+    if (atomic_load_explicit(&tierThreshold, memory_order_relaxed) == 0)
+        enter(retval, 0);
+
+    return retval;
+}
+
+lox_value lox_eval(const lox_handle *handle) {
+    return lox_eval_args(handle, NULL);
+}
+
+lox_value lox_eval_args(const lox_handle *handle, const lox_value *args) {
+    bool savedError = hadError;
+    Heap *previous = HeapCurrent();
+    ThreadState *state = threadState();
+    Expr *expr = enter(handle, 1);
+    Interpreter *interpreter = treeInterpreter(state, expr);
+    size_t n_args = args != NULL ? handle->n_params : 0;
+
+    HeapSetCurrent(&state->heap);
+    beginCapture();
+
+    /* The last result is held on the heap's stack for as long as it is
+     * bound, as it may move. */
+    size_t roots = HeapStackLen();
+    const char *kept = NULL;
+    if (bindArgs(state, args, n_args)) {
+        kept = state->result->value.chars;
+        HeapPush(state->result);
+    }
+    Object *bound = state->args;
+
+    InterpreterBind(interpreter, bound, n_args);
+    Object *value = InterpreterInterpret(interpreter, expr);
+
+    /* The bound copies are released below, so an argument that comes back
+     * as the result is returned as the caller passed it. */
+    lox_value retval = fromObject(value);
+    if (value != NULL && value >= bound && value < bound + n_args)
+        retval = args[value - bound];
+
+    state->result = NULL;
+    if (kept != NULL && retval.type == LOX_STRING && retval.as.string.chars == kept)
+        state->result = HeapStackGet(roots);
+    else if (value != NULL && ObjectIsOwned(value) && value->type == OBJECT_STRING &&
+             value->repr == STR_FLAT)
+        state->result = value;
+
+    HeapStackTruncate(roots);
+    endCapture();
+    hadError = savedError;
+    HeapSetCurrent(previous);
+    InterpreterBind(interpreter, NULL, 0);
+    releaseArgs(bound, n_args, kept);
+
+    return retval;
+}
+
+lox_task *lox_start(const lox_handle *handle, const lox_value *args, const lox_quota *quota) {
+    void *stack = mmap(NULL, LOX_TASK_STACK_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+
+    if (stack == MAP_FAILED) {
+        snprintf(lastError, sizeof(lastError), "Not enough memory for the task's stack.");
+        return NULL;
+    }
+
+    /* Overflowing the stack faults on its lowest page instead of running
+     * into whatever is mapped below. */
+    mprotect(stack, (size_t)sysconf(_SC_PAGESIZE), PROT_NONE);
+
+    lox_task *retval = malloc(sizeof(lox_task));
+    size_t n_args = args != NULL ? handle->n_params : 0;
+
+    *retval = (lox_task){
+        .interpreter = InterpreterInit(),
+        .heap = HeapInit(LOX_TASK_NURSERY_SIZE),
+        .expr = enter(handle, 1),
+        .bound = copyArgs(args, n_args),
+        .n_args = n_args,
+        .stack = stack,
+        .steps_left = quota != NULL && quota->max_steps > 0 ? quota->max_steps : UINT64_MAX
+    };
+    retval->heap.limit = quota != NULL ? quota->max_bytes : 0;
+
+    InterpreterBind(&retval->interpreter, retval->bound, n_args);
+    retval->interpreter.fuel = 0;
+    retval->interpreter.pause = taskPause;
+    retval->interpreter.pause_ctx = retval;
+
+    getcontext(&retval->context);
+    retval->context.uc_stack.ss_sp = stack;
+    retval->context.uc_stack.ss_size = LOX_TASK_STACK_SIZE;
+    retval->context.uc_link = &retval->caller;
+    makecontext(&retval->context, taskMain, 0);
+
+    return retval;
+}
+
+bool lox_resume(lox_task *task, uint64_t steps, lox_value *result) {
+    if (!task->done) {
+        bool savedError = hadError;
+
+        beginCapture();
+        task->slice = steps > 0 ? steps : UINT64_MAX;
+        switchTo(task);
+
+        /* Converting may flatten a string, which the task's heap pays for. */
+        if (task->done) {
+            Heap *previous = HeapCurrent();
+            Object *value = task->value;
+
+            HeapSetCurrent(&task->heap);
+            task->result = fromObject(value);
+            HeapSetCurrent(previous);
+        }
+
+        endCapture();
+        hadError = savedError;
+    }
+
+    if (task->done)
+        *result = task->result;
+
+    return task->done;
+}
+
+uint64_t lox_task_steps(const lox_task *task) {
+    return task->granted - task->interpreter.fuel;
+}
+
+void lox_task_free(lox_task *task) {
+    if (task == NULL)
+        return;
+
+    if (task->started && !task->done) {
+        char scratch[LOX_ERROR_SIZE];
+        bool savedError = hadError;
+
+        reportCapture(scratch, sizeof(scratch));
+        task->abandoned = true;
+        switchTo(task);
+        reportCapture(NULL, 0);
+        hadError = savedError;
+    }
+
+    InterpreterFini(&task->interpreter);
+    HeapFini(&task->heap);
+    releaseArgs(task->bound, task->n_args, NULL);
+    free(task->bound);
+    munmap(task->stack, LOX_TASK_STACK_SIZE);
+    free(task);
+}
+
+bool lox_eval_columns(const lox_handle *handle, const lox_column *inputs, size_t rows,
+                      lox_column *out) {
+    for (size_t i = 0; i < handle->n_params; i++) {
+        if (inputs[i].type != LOX_NUMBER && inputs[i].type != LOX_BOOL) {
+            snprintf(lastError, sizeof(lastError),
+                     "Column '%s' holds neither numbers nor booleans.", handle->params[i]);
+            return false;
+        }
+    }
+
+    bool savedError = hadError;
+    ThreadState *state = threadState();
+
+    /* One more than needed, so that neither is NULL without parameters. */
+    if (handle->n_params + 1 > state->columns_cap) {
+        state->columns_cap = handle->n_params + 1;
+        state->types = realloc(state->types, state->columns_cap * sizeof(ColumnType));
+        state->columns = realloc(state->columns, state->columns_cap * sizeof(Column));
+    }
+
+    for (size_t i = 0; i < handle->n_params; i++) {
+        state->columns[i].type = columnType(&inputs[i]);
+        if (inputs[i].type == LOX_BOOL)
+            state->columns[i].data.b = inputs[i].as.boolean;
+        else
+            state->columns[i].data.f = inputs[i].as.number;
+    }
+
+    beginCapture();
+
+    const ColumnProgram *program = columnProgram(handle, state, enter(handle, rows), inputs);
+    if (program != NULL) {
+        Column result = { .data.f = out->as.number };
+
+        ColumnRun(program, state->columns, rows, &result);
+        out->type = result.type == COLUMN_BOOL ? LOX_BOOL : LOX_NUMBER;
+    }
+
+    endCapture();
+    hadError = savedError;
+    return program != NULL;
+}
+
+void lox_free(lox_handle *handle) {
+    if (handle == NULL)
+        return;
+
+    if (handle->compiler_started)
+        pthread_join(handle->compiler, NULL);
+
+    tierFini(&handle->baseline);
+    tierFini(&handle->optimized);
+
+    ColumnEntry *next;
+    for (ColumnEntry *e = handle->programs; e != NULL; e = next) {
+        next = e->next;
+        ColumnProgramFini(&e->program);
+        free(e);
+    }
+
+    for (size_t i = 0; i < handle->n_params; i++)
+        free(handle->params[i]);
+    free(handle->params);
+    free(handle->source);
+    free(handle);
+}
+
+int lox_tier(const lox_handle *handle) {
+    lox_handle *h = (lox_handle*)handle;
+    return atomic_load_explicit(&h->current, memory_order_acquire) != h->baseline.expr;
+}
+
+void lox_set_tier_threshold(size_t evals) {
+    atomic_store(&tierThreshold, evals);
+}
+
+lox_tier_stats lox_get_tier_stats(void) {
+    return (lox_tier_stats){
+        .compiles = atomic_load(&compiles),
+        .promotions = atomic_load(&promotions),
+        .failed_promotions = atomic_load(&failedPromotions),
+        .compile_ns = atomic_load(&compileNs),
+        .promote_ns = atomic_load(&promoteNs)
+    };
+}
+
+const char *lox_last_error(void) {
+    return lastError;
+}
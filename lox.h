@@ -0,0 +1,169 @@
+#ifndef LOX_H_
+#define LOX_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define LOX_API __attribute__((visibility("default")))
+#else
+#define LOX_API
+#endif
+
+/* Evaluations after which a handle is recompiled at full optimization. */
+#define LOX_TIER_THRESHOLD 1000
+
+/*
+ * Embedding API.
+ *
+ * lox_compile lexes and parses an expression once, without optimizing it,
+ * so that expressions evaluated only a few times cost next to nothing to
+ * set up. Once a handle has been evaluated LOX_TIER_THRESHOLD times (rows,
+ * for lox_eval_columns), it is recompiled at full optimization on a thread
+ * of its own, and later evaluations switch to the result; evaluations
+ * already running finish on the tree they started with. Both give the same
+ * values and errors. Any number of threads may lox_eval one handle at the
+ * same time. Evaluation does no parsing;
+ * temporaries are bump-allocated from a heap owned by the calling thread,
+ * and calls, shapes and inline caches kept by that thread outlive each
+ * evaluation. Both are set up on the thread's first lox_eval and released
+ * when the thread exits.
+ *
+ * An expression may refer to named parameters, whose values are supplied
+ * either one row at a time through lox_eval_args or a whole column at a
+ * time through lox_eval_columns. The columnar path runs arithmetic,
+ * comparisons and '?:' as vector loops over blocks of rows, and is the
+ * one to use for large numeric inputs.
+ *
+ * Nothing is written to stderr. When lox_compile returns NULL or lox_eval
+ * returns LOX_ERROR, lox_last_error describes what went wrong.
+ */
+
+typedef struct lox_handle lox_handle;
+
+typedef enum {
+    LOX_NIL,
+    LOX_BOOL,
+    LOX_NUMBER,
+    LOX_STRING,
+    LOX_ERROR
+} lox_type;
+
+/* A string result points into the evaluating thread's heap and stays
+ * valid until that thread's next lox_eval. */
+typedef struct {
+    lox_type type;
+    union {
+        bool boolean;
+        double number;
+        struct {
+            const char *chars;
+            size_t len;
+        } string;
+    } as;
+} lox_value;
+
+/* Numbers and booleans only. The data is borrowed for the duration of the
+ * call. */
+typedef struct {
+    lox_type type;
+    union {
+        double *number;
+        bool *boolean;
+    } as;
+} lox_column;
+
+LOX_API lox_handle *lox_compile(const char *source);
+
+/* Identifiers in source refer to params, by position. The names are only
+ * read during the call. */
+LOX_API lox_handle *lox_compile_params(const char *source, const char *const *params,
+                                       size_t n_params);
+
+LOX_API lox_value lox_eval(const lox_handle *handle);
+
+/* args holds one value per parameter; LOX_ERROR is not a valid argument.
+ * A string this thread's last evaluation returned may be passed straight
+ * back, and is then not copied. */
+LOX_API lox_value lox_eval_args(const lox_handle *handle, const lox_value *args);
+
+/* Evaluates the expression for rows rows at once. inputs holds one column
+ * per parameter; out->as must point at room for rows doubles, and the
+ * result type is written to out->type. Columns of strings or nil, and
+ * expressions that need them, fail with false. The expression is compiled
+ * once for each set of column types it is given, and kept with the handle. */
+LOX_API bool lox_eval_columns(const lox_handle *handle, const lox_column *inputs,
+                              size_t rows, lox_column *out);
+/* Waits for a recompile still in progress. */
+LOX_API void lox_free(lox_handle *handle);
+
+/* 0 while a handle runs its baseline tree, 1 once it is promoted. */
+LOX_API int lox_tier(const lox_handle *handle);
+
+/* Applies to the next evaluation of every handle. 0 promotes handles as
+ * they are compiled, SIZE_MAX never. */
+LOX_API void lox_set_tier_threshold(size_t evals);
+
+/* Totals over the process. */
+typedef struct {
+    size_t compiles;
+    size_t promotions;
+    size_t failed_promotions;
+    uint64_t compile_ns;
+    uint64_t promote_ns;
+} lox_tier_stats;
+
+LOX_API lox_tier_stats lox_get_tier_stats(void);
+
+/*
+ * Resumable evaluation.
+ *
+ * A task is one evaluation of a handle that runs a budget of steps at a
+ * time, a step being one node of the expression evaluated, and is
+ * suspended in between, so that one thread can take turns among many of
+ * them. Each task has a stack and a heap of its own, which its quota
+ * applies to. A task is only ever resumed and freed on the thread that
+ * started it, and is freed before its handle.
+ */
+typedef struct lox_task lox_task;
+
+/* 0 is no limit for either. max_bytes counts objects and the characters
+ * and fields they hold, and is checked at least every
+ * LOX_QUOTA_CHECK_STEPS steps, and before any string is built. */
+typedef struct {
+    uint64_t max_steps;
+    size_t max_bytes;
+} lox_quota;
+
+#define LOX_QUOTA_CHECK_STEPS 64
+
+/* args is copied, and quota may be NULL. NULL if no stack could be made
+ * for the task. */
+LOX_API lox_task *lox_start(const lox_handle *handle, const lox_value *args,
+                            const lox_quota *quota);
+
+/* Runs task for at most steps more steps, or to the end for 0. Returns
+ * true once it has finished, with its value in result; a string in it
+ * stays valid until lox_task_free. An evaluation that fails, or goes over
+ * its quota, finishes with LOX_ERROR. */
+LOX_API bool lox_resume(lox_task *task, uint64_t steps, lox_value *result);
+
+LOX_API uint64_t lox_task_steps(const lox_task *task);
+
+/* A task still suspended is unwound first. */
+LOX_API void lox_task_free(lox_task *task);
+
+/* The first error of the last lox_compile, lox_eval or lox_resume on this
+ * thread, or an empty string. */
+LOX_API const char *lox_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
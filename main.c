@@ -3,15 +3,56 @@
 #include <stdbool.h>
 #include <string.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include "logging.h"
 #include "lexer.h"
 #include "ast_printer.h"
 #include "parser.h"
 #include "interpreter.h"
+#include "heap.h"
+#include "pool.h"
+#include "parallel_lexer.h"
+#include "batch.h"
+#include "csv.h"
+#include "stream.h"
+#include "profiler.h"
+#include "perf.h"
+#include "trace.h"
+#include "memtrack.h"
+#include "optimize.h"
+#include "strkernel.h"
+#include "aot.h"
 
-#define MAX_TOKENS 4096
 #define MAX_LINE_SIZE 100
+#define PROFILE_TOP 20
+
+typedef enum {
+    PHASE_LEX,
+    PHASE_PARSE,
+    PHASE_OPTIMIZE,
+    PHASE_BUILD,
+    PHASE_EVALUATE,
+    PHASE_COUNT
+} Phase;
+
+static const char *const phaseNames[PHASE_COUNT] = { "lex", "parse", "optimize", "build", "evaluate" };
+
+static int lexThreads = 1;
+static Profiler *profiler = NULL;
+static Optimizer optimizer;
+static bool memReport = false;
+static const char *aotPath = NULL;
+static size_t maxDepth = INTERPRETER_MAX_DEPTH;
+
+/* Inline cache counts of every run but a profiled one, which the profiler
+ * keeps itself. */
+static CacheStats cacheStats;
+
+/* Only read when --perf-counters is given. */
+static PerfCounters *perf = NULL;
+static PerfSample phases[PHASE_COUNT];
+static PerfSample phaseStart;
 
 static inline void print_str(const char *str, size_t len) {
     for (size_t i = 0; i < len; i++)
@@ -29,59 +70,129 @@ static void print_token(const Token *t) {
     printf("'\n");
 }
 
-static int run(char *source, size_t len) {
-    Lexer lexer; 
+static inline void phaseBegin(Phase phase) {
+    TRACE_BEGIN(phaseNames[phase], NULL, 0);
+    if (perf != NULL)
+        PerfRead(perf, &phaseStart);
+}
+
+static inline void phaseEnd(Phase phase) {
+    TRACE_END(phaseNames[phase]);
+    if (perf != NULL) {
+        PerfSample end;
+        PerfRead(perf, &end);
+        PerfAccumulate(&phases[phase], &phaseStart, &end);
+    }
+}
+
+static void printAfter(const char *pass, Expr *expr) {
+    AstPrinter ast = AstPrinterInit();
+    printf("After %s: ", pass);
+    AstPrint(&ast, expr);
+}
+
+/* Called on every way out of main, once the heaps have been torn down. */
+static void writeReports(const char *trace) {
+    if (trace != NULL && !TraceWrite(trace))
+        perror("Error writing trace");
+
+    if (memReport)
+        MemTrackReport(stderr);
+}
+
+/* Lexes, parses and optimizes source, printing the tokens and the tree on
+ * the way. */
+static Expr *compile(char *source, size_t len) {
     Parser parser;
-    Interpreter interpreter;
-    Token tokens[MAX_TOKENS]; 
+    TokenList tokens = TokenListInit();
     Expr *result; 
-    Object *value;
 
-    lexer = LexerInit(source, len);
-    for (int i = 0; !LexerIsDone(&lexer) && i < MAX_TOKENS; i++) {
-        tokens[i] = LexerGetToken(&lexer);
-        if (tokens[i].type == TOKEN_ILLEGAL) {
-            LexerFini(&lexer);
-            return -1;
-        }
-        
-        print_token(&tokens[i]);
+    phaseBegin(PHASE_LEX);
+    bool lexed = LexerTokenizeParallel(source, len, lexThreads, &tokens);
+    phaseEnd(PHASE_LEX);
+
+    if (!lexed) {
+        TokenListFini(&tokens);
+        return NULL;
     }
-    LexerFini(&lexer);
+    TokenListPush(&tokens, TokenEOF);
+
+    for (size_t i = 0; i < tokens.len; i++)
+        print_token(&tokens.tokens[i]);
 
-    parser = ParserInit(tokens);
+    phaseBegin(PHASE_PARSE);
+    parser = ParserInit(tokens.tokens);
     result = ParserParse(&parser);
+    phaseEnd(PHASE_PARSE);
+    TokenListFini(&tokens);
     if (result == NULL)
-        return -1;
+        return NULL;
+
+    phaseBegin(PHASE_OPTIMIZE);
+    result = OptimizerRun(&optimizer, result);
+    phaseEnd(PHASE_OPTIMIZE);
 
     AstPrinter ast = AstPrinterInit();
     AstPrint(&ast, result);
 
-    interpreter = InterpreterInit();
-    value = InterpretInterpret(&interpreter, result);
-    if (value == NULL)
-        return -1;
+    return result;
+}
 
-    ExprFini(result);
+static int run(char *source, size_t len) {
+    Interpreter interpreter = InterpreterInit();
+    AotModule *module = NULL;
+    interpreter.max_depth = maxDepth;
+    Expr *result = NULL;
+    Object *value;
 
-    switch (value->type) {
-    case OBJECT_NUMBER:
-        printf("%.3f\n", value->value.f);
-        break;
-    case OBJECT_BOOL:
-        printf("%s\n", value->value.b ? "true" : "false");
-        break;
-    case OBJECT_NIL:
-        printf("nil\n");
-        break;
-    case OBJECT_STRING:
-        printf("'%s'\n", value->value.str);
-        break;
+    /* A module built from this very source skips the front end. */
+    uint64_t hash = aotPath != NULL ? StrHash(source, len) : 0;
+    if (aotPath != NULL)
+        module = AotLoad(aotPath, hash);
+
+    if (module == NULL) {
+        if ((result = compile(source, len)) == NULL)
+            return -1;
+
+        if (aotPath != NULL) {
+            phaseBegin(PHASE_BUILD);
+            module = AotCompile(result, hash, aotPath);
+            phaseEnd(PHASE_BUILD);
+
+            if (module == NULL)
+                fprintf(stderr, "Could not build %s, interpreting instead.\n", aotPath);
+        }
     }
 
-    ObjectFini(value);
+    phaseBegin(PHASE_EVALUATE);
+    if (module != NULL)
+        value = AotRun(module, &interpreter);
+    else if (profiler != NULL)
+        value = ProfilerInterpret(profiler, result);
+    else
+        value = InterpreterInterpret(&interpreter, result);
+    phaseEnd(PHASE_EVALUATE);
 
-    return 0;
+    cacheStats.hits += interpreter.cache_stats.hits;
+    cacheStats.misses += interpreter.cache_stats.misses;
+    cacheStats.megamorphic += interpreter.cache_stats.megamorphic;
+
+    /* The interpreter goes last, as an instance is printed by the class
+     * name its shape keeps. */
+    if (value != NULL) {
+        char *str = ObjectToString(value);
+        printf("%s\n", str);
+        free(str);
+    }
+    InterpreterFini(&interpreter);
+
+    /* The value may be one of the module's constants, so it goes last. */
+    if (module != NULL)
+        AotUnload(module);
+    if (result != NULL)
+        ExprFini(result);
+
+    return value != NULL ? 0 : -1;
 }
 
 static int runFile(const char *path) {
@@ -100,7 +211,9 @@ static int runFile(const char *path) {
     buffer = malloc(size + 1);
     fread(buffer, sizeof(char), size, f);
 
-    run(buffer, size);    
+    TRACE_BEGIN("file", path, size);
+    run(buffer, size);
+    TRACE_END("file");
     if (hadError)
         retval = -1;
 
@@ -128,23 +241,187 @@ static void runPrompt(void) {
     }
 }
 
+static void usage(void) {
+    printf("Usage: lox [-O0|-O1|-O2] [--print-after=<pass>] [--opt-stats] [--gc-stats]\n");
+    printf("           [--pool-stats] [--lex-threads N] [--profile <file>] [--perf-counters]\n");
+    printf("           [--trace <file>] [--mem-report] [--max-depth N] [--ic-stats] [script]\n");
+    printf("       lox --batch <file> [-O0|-O1|-O2] [-j N] [--trace <file>] [--mem-report]\n");
+    printf("       lox --csv <file> <script> [-O0|-O1|-O2] [--aot <module>] [--mem-report]\n");
+    printf("       lox --aot <module> <script> [-O0|-O1|-O2]\n");
+}
+
 int main(int argc, char **argv) {
-    if (argc > 2) {
-        printf("Usage: lox [script]\n");
+    const char *script = NULL;
+    const char *batch = NULL;
+    const char *csv = NULL;
+    const char *profile = NULL;
+    const char *trace = NULL;
+    int jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    bool gcStats = false;
+    lexThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    bool poolStats = false;
+    bool perfCounters = false;
+    bool optStats = false;
+    bool icStats = false;
+    int level = 0;
+    const char *printAfterPass = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--gc-stats") == 0) {
+            gcStats = true;
+        } else if (strcmp(argv[i], "--pool-stats") == 0) {
+            poolStats = true;
+        } else if (strcmp(argv[i], "--lex-threads") == 0 && i + 1 < argc) {
+            lexThreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace = argv[++i];
+        } else if (argv[i][0] == '-' && argv[i][1] == 'O' && argv[i][2] >= '0' &&
+                   argv[i][2] <= '2' && argv[i][3] == '\0') {
+            level = argv[i][2] - '0';
+        } else if (strncmp(argv[i], "--print-after=", 14) == 0 &&
+                   OptimizerHasPass(argv[i] + 14)) {
+            printAfterPass = argv[i] + 14;
+        } else if (strcmp(argv[i], "--opt-stats") == 0) {
+            optStats = true;
+        } else if (strcmp(argv[i], "--ic-stats") == 0) {
+            icStats = true;
+        } else if (strcmp(argv[i], "--mem-report") == 0) {
+            memReport = true;
+        } else if (strcmp(argv[i], "--perf-counters") == 0) {
+            perfCounters = true;
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profile = argv[++i];
+        } else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+            csv = argv[++i];
+        } else if (strcmp(argv[i], "--aot") == 0 && i + 1 < argc) {
+            aotPath = argv[++i];
+        } else if (strcmp(argv[i], "--max-depth") == 0 && i + 1 < argc) {
+            maxDepth = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+        } else if (argv[i][0] != '-' && script == NULL) {
+            script = argv[i];
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    if (memReport)
+        MemTrackEnable();
+
+    if (trace != NULL) {
+        TraceEnable();
+        TraceThreadName("main");
+    }
+
+    if (batch != NULL) {
+        if (BatchRun(batch, jobs, level, stdout) != 0) {
+            perror("Error opening file");
+            return 1;
+        }
+
+        writeReports(trace);
+        return 0;
+    }
+
+    if (csv != NULL) {
+        if (script == NULL) {
+            usage();
+            return 1;
+        }
+
+        int status = CsvRun(csv, script, level, aotPath, stdout);
+        if (status < 0)
+            perror("Error opening file");
+
+        writeReports(trace);
+        return status != 0;
+    }
+
+    if (aotPath != NULL && script == NULL) {
+        usage();
         return 1;
     }
 
+    optimizer = OptimizerInit(level);
+    optimizer.keep_tree = aotPath != NULL;
+    optimizer.print_after = printAfterPass;
+    optimizer.after = printAfter;
+
     int status = 0;
+    Heap heap = HeapInit(HEAP_NURSERY_SIZE);
+    HeapSetCurrent(&heap);
 
-    if (argc == 2) {
-        if (runFile(argv[1]) == 1) {
+    PerfCounters counters;
+    if (perfCounters) {
+        counters = PerfCountersInit();
+        perf = &counters;
+    }
+
+    Profiler prof;
+    if (profile != NULL) {
+        prof = ProfilerInit();
+        prof.base.max_depth = maxDepth;
+        profiler = &prof;
+    }
+
+    if (script != NULL) {
+        if (runFile(script) == 1) {
             perror("Error opening file");
             status = 1;
         }
+    } else if (!isatty(STDIN_FILENO)) {
+        if (StreamRun(STDIN_FILENO, &optimizer, stdout) != 0) {
+            perror("Error reading input");
+            status = 1;
+        }
     } else {
         runPrompt();
     }
 
+    if (gcStats)
+        HeapPrintStats(&heap, stderr);
+
+    if (poolStats)
+        PoolPrintStats(stderr);
+
+    if (optStats)
+        OptimizerPrintStats(&optimizer, stderr);
+
+    if (icStats) {
+        if (profiler != NULL) {
+            cacheStats.hits += profiler->base.cache_stats.hits;
+            cacheStats.misses += profiler->base.cache_stats.misses;
+            cacheStats.megamorphic += profiler->base.cache_stats.megamorphic;
+        }
+
+        InterpreterPrintCacheStats(&cacheStats, stderr);
+    }
+
+    if (perf != NULL) {
+        PerfPrintTable(perf, phaseNames, phases, PHASE_COUNT, stderr);
+        PerfCountersFini(perf);
+    }
+
+    if (profiler != NULL) {
+        FILE *f = fopen(profile, "w");
+        if (f != NULL) {
+            ProfilerWriteCollapsed(profiler, f);
+            fclose(f);
+        } else {
+            perror("Error writing profile");
+        }
+
+        ProfilerWriteTop(profiler, stderr, PROFILE_TOP);
+        ProfilerFini(profiler);
+    }
+
+    HeapFini(&heap);
+    writeReports(trace);
+    PoolReleaseAll();
     return status;
 }
 
@@ -0,0 +1,221 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "memtrack.h"
+
+#define MEMTRACK_MIN_CAP 1024
+
+typedef struct {
+    const void *ptr;
+    const char *site;
+    size_t size;
+    MemTag tag;
+} MemBlock;
+
+typedef struct {
+    const char *site;
+    MemTag tag;
+    size_t blocks;
+    size_t bytes;
+} MemLeak;
+
+static const char *const tagNames[MEM_TAG_COUNT] = { "expr", "object", "string" };
+
+bool memTracking = false;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Open addressing with linear probing; ptr == NULL marks an empty slot. */
+static MemBlock *blocks = NULL;
+static size_t cap = 0;
+static size_t len = 0;
+
+static MemStats stats[MEM_TAG_COUNT];
+static size_t liveBytes = 0;
+static size_t peakBytes = 0;
+static size_t badFrees = 0;
+
+/* ---- HELPER FUNCTIONS ---- */
+
+static inline size_t slotOf(const void *ptr) {
+    uint64_t h = (uintptr_t)ptr;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h & (cap - 1);
+}
+
+static void insert(MemBlock block) {
+    size_t i = slotOf(block.ptr);
+    while (blocks[i].ptr != NULL)
+        i = (i + 1) & (cap - 1);
+
+    blocks[i] = block;
+}
+
+static void grow(void) {
+    MemBlock *old = blocks;
+    size_t old_cap = cap;
+
+    cap = cap ? cap * 2 : MEMTRACK_MIN_CAP;
+    blocks = calloc(cap, sizeof(MemBlock));
+
+    for (size_t i = 0; i < old_cap; i++) {
+        if (old[i].ptr != NULL)
+            insert(old[i]);
+    }
+
+    free(old);
+}
+
+static MemBlock *find(const void *ptr) {
+    if (cap == 0)
+        return NULL;
+
+    for (size_t i = slotOf(ptr); blocks[i].ptr != NULL; i = (i + 1) & (cap - 1)) {
+        if (blocks[i].ptr == ptr)
+            return &blocks[i];
+    }
+
+    return NULL;
+}
+
+/* Backward-shift deletion, so lookups never need tombstones. */
+static void erase(MemBlock *block) {
+    size_t hole = block - blocks;
+
+    for (size_t i = (hole + 1) & (cap - 1); blocks[i].ptr != NULL; i = (i + 1) & (cap - 1)) {
+        size_t home = slotOf(blocks[i].ptr);
+
+        /* Move the entry back unless its home lies cyclically in (hole, i]. */
+        if (((i - home) & (cap - 1)) >= ((i - hole) & (cap - 1))) {
+            blocks[hole] = blocks[i];
+            hole = i;
+        }
+    }
+
+    blocks[hole] = (MemBlock){0};
+    len--;
+}
+
+static int compareLeaks(const void *a, const void *b) {
+    const MemLeak *x = a, *y = b;
+    return (x->bytes < y->bytes) - (x->bytes > y->bytes);
+}
+
+/* ---- MAIN METHODS ---- */
+
+void MemTrackEnable(void) {
+    memTracking = true;
+}
+
+void MemTrackAlloc(MemTag tag, const char *site, const void *ptr, size_t size) {
+    if (ptr == NULL)
+        return;
+
+    pthread_mutex_lock(&lock);
+
+    if ((len + 1) * 4 > cap * 3)
+        grow();
+
+    insert((MemBlock){ .ptr = ptr, .site = site, .size = size, .tag = tag });
+    len++;
+
+    MemStats *s = &stats[tag];
+    s->allocs++;
+    s->live_blocks++;
+    s->live_bytes += size;
+    if (s->live_bytes > s->peak_bytes)
+        s->peak_bytes = s->live_bytes;
+
+    liveBytes += size;
+    if (liveBytes > peakBytes)
+        peakBytes = liveBytes;
+
+    pthread_mutex_unlock(&lock);
+}
+
+void MemTrackFree(MemTag tag, const void *ptr) {
+    if (ptr == NULL)
+        return;
+
+    pthread_mutex_lock(&lock);
+
+    MemBlock *block = find(ptr);
+    if (block == NULL || block->tag != tag) {
+        badFrees++;
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+
+    MemStats *s = &stats[tag];
+    s->frees++;
+    s->live_blocks--;
+    s->live_bytes -= block->size;
+    liveBytes -= block->size;
+
+    erase(block);
+    pthread_mutex_unlock(&lock);
+}
+
+MemStats MemTrackGetStats(MemTag tag) {
+    pthread_mutex_lock(&lock);
+    MemStats retval = stats[tag];
+    pthread_mutex_unlock(&lock);
+    return retval;
+}
+
+size_t MemTrackLiveBytes(void) {
+    pthread_mutex_lock(&lock);
+    size_t retval = liveBytes;
+    pthread_mutex_unlock(&lock);
+    return retval;
+}
+
+size_t MemTrackReport(FILE *f) {
+    pthread_mutex_lock(&lock);
+
+    fprintf(f, "%-8s %12s %12s %12s %12s %12s\n", "memory", "live bytes", "live blocks",
+            "peak bytes", "allocs", "frees");
+    for (int i = 0; i < MEM_TAG_COUNT; i++) {
+        const MemStats *s = &stats[i];
+        fprintf(f, "%-8s %12zu %12zu %12zu %12zu %12zu\n", tagNames[i], s->live_bytes,
+                s->live_blocks, s->peak_bytes, s->allocs, s->frees);
+    }
+    fprintf(f, "%-8s %12zu %12zu %12zu\n", "total", liveBytes, len, peakBytes);
+
+    if (badFrees > 0)
+        fprintf(f, "Memory: %zu frees of blocks that were not live.\n", badFrees);
+
+    MemLeak *leaks = malloc((len + 1) * sizeof(MemLeak));
+    size_t n_leaks = 0;
+
+    for (size_t i = 0; i < cap; i++) {
+        const MemBlock *b = &blocks[i];
+        if (b->ptr == NULL)
+            continue;
+
+        size_t k = 0;
+        while (k < n_leaks && (leaks[k].site != b->site || leaks[k].tag != b->tag))
+            k++;
+
+        if (k == n_leaks)
+            leaks[n_leaks++] = (MemLeak){ .site = b->site, .tag = b->tag };
+
+        leaks[k].blocks++;
+        leaks[k].bytes += b->size;
+    }
+
+    qsort(leaks, n_leaks, sizeof(MemLeak), compareLeaks);
+
+    for (size_t i = 0; i < n_leaks; i++)
+        fprintf(f, "Leak: %zu bytes in %zu blocks of %s from %s\n", leaks[i].bytes,
+                leaks[i].blocks, tagNames[leaks[i].tag], leaks[i].site);
+
+    size_t retval = liveBytes;
+    free(leaks);
+    pthread_mutex_unlock(&lock);
+    return retval;
+}
@@ -0,0 +1,67 @@
+#ifndef MEMTRACK_H_
+#define MEMTRACK_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+typedef enum {
+    MEM_EXPR,
+    MEM_OBJECT,
+    MEM_STRING,
+    MEM_TAG_COUNT
+} MemTag;
+
+typedef struct {
+    size_t live_bytes;
+    size_t live_blocks;
+    size_t peak_bytes;
+    size_t allocs;
+    size_t frees;
+} MemStats;
+
+/*
+ * Bookkeeping on top of the Expr, Object and string buffer allocators.
+ * Every live block is kept in a table with its tag, size and the site that
+ * allocated it, which is a short literal naming the constructor. Freeing a
+ * block that is not in the table is counted as a bad free rather than
+ * trusted, which is how double frees show up.
+ *
+ * Nursery objects count as allocated from HeapAlloc until the collection
+ * that reclaims or promotes them, so live bytes follow what the program
+ * holds rather than what the heap has reserved.
+ *
+ * Tracking takes a global lock and is off unless MemTrackEnable is called;
+ * the MEM_TRACK_* macros then cost a single predictable branch. Enable it
+ * before any other thread starts.
+ */
+extern bool memTracking;
+
+void MemTrackEnable(void);
+
+void MemTrackAlloc(MemTag tag, const char *site, const void *ptr, size_t size);
+void MemTrackFree(MemTag tag, const void *ptr);
+
+MemStats MemTrackGetStats(MemTag tag);
+
+/* Across all tags. A caller can check that an evaluation leaked nothing by
+ * comparing this before and after it, once a major collection has run. */
+size_t MemTrackLiveBytes(void);
+
+/* Live and peak bytes per tag, then whatever is still live grouped by
+ * site. Returns the number of leaked bytes. */
+size_t MemTrackReport(FILE *f);
+
+#define MEM_TRACK_ALLOC(tag, site, ptr, size)           \
+    do {                                                \
+        if (memTracking)                                \
+            MemTrackAlloc(tag, site, ptr, size);        \
+    } while (0)
+
+#define MEM_TRACK_FREE(tag, ptr)                        \
+    do {                                                \
+        if (memTracking)                                \
+            MemTrackFree(tag, ptr);                     \
+    } while (0)
+
+#endif
@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "object.h"
+#include "shape.h"
+
+Object objectTrue = { .type = OBJECT_BOOL, .gen = GEN_CONST, .value.b = true };
+Object objectFalse = { .type = OBJECT_BOOL, .gen = GEN_CONST, .value.b = false };
+Object objectNil = { .type = OBJECT_NIL, .gen = GEN_CONST };
+
+/* ---- HELPER FUNCTIONS ---- */
+
+/* Recurses on right children only; the left spine, which is what a chain
+ * of '+' builds, is walked iteratively. */
+static void copyRope(Object *node, char *dst) {
+    while (node->repr == STR_ROPE) {
+        Object *left = node->value.rope.left;
+        copyRope(node->value.rope.right, dst + left->len);
+        node = left;
+    }
+
+    memcpy(dst, node->repr == STR_SMALL ? node->value.small : node->value.chars, node->len);
+}
+
+/* ---- MAIN METHODS ---- */
+
+void ObjectStrFlatten(Object *obj) {
+    if (obj->repr != STR_ROPE)
+        return;
+
+    char *chars = malloc((size_t)obj->len + 1);
+    copyRope(obj, chars);
+    chars[obj->len] = '\0';
+    MEM_TRACK_ALLOC(MEM_STRING, "ObjectStrFlatten", chars, (size_t)obj->len + 1);
+
+    obj->repr = STR_FLAT;
+    obj->value.chars = chars;
+    HeapCharge(obj, (size_t)obj->len + 1);
+}
+
+/* The caller checks that the result fits in OBJECT_STR_MAX. */
+Object *ObjectStrConcat(Object *left, Object *right) {
+    size_t len = (size_t)left->len + right->len;
+
+    if (len < OBJECT_ROPE_MIN) {
+        char buffer[OBJECT_ROPE_MIN];
+
+        memcpy(buffer, ObjectStrChars(left), left->len);
+        memcpy(buffer + left->len, ObjectStrChars(right), right->len);
+
+        return ObjectStr(buffer, len);
+    }
+
+    if (left->len == 0)
+        return right;
+    if (right->len == 0)
+        return left;
+
+    HeapPush(left);
+    HeapPush(right);
+    Object *retval = HeapAlloc();
+    right = HeapPop();
+    left = HeapPop();
+
+    retval->type = OBJECT_STRING;
+    retval->repr = STR_ROPE;
+    retval->len = len;
+    retval->value.rope.left = left;
+    retval->value.rope.right = right;
+    return retval;
+}
+
+/* Fills the result by doubling what has been written so far, so there are
+ * O(log count) memcpy calls. The caller checks that the result fits. */
+Object *ObjectStrRepeat(Object *str, size_t count) {
+    size_t len = ObjectStrLen(str);
+    size_t total = len * count;
+
+    if (total == 0)
+        return ObjectStr("", 0);
+
+    char small[OBJECT_SMALL_STR];
+    char *chars = total < OBJECT_SMALL_STR ? small : malloc(total + 1);
+
+    memcpy(chars, ObjectStrChars(str), len);
+    for (size_t filled = len; filled < total; filled *= 2) {
+        size_t n = filled < total - filled ? filled : total - filled;
+        memcpy(chars + filled, chars, n);
+    }
+    chars[total] = '\0';
+
+    if (total < OBJECT_SMALL_STR)
+        return ObjectStr(chars, total);
+
+    return ObjectStrTake(chars, total);
+}
+
+void ObjectInstanceStore(Object *obj, Shape *shape, size_t index, Object *value) {
+    if (shape != obj->value.instance.shape) {
+        size_t cap = ObjectFieldsCapacity(shape->n_fields);
+        size_t old_cap = ObjectFieldsCapacity(obj->len);
+
+        if (cap > old_cap) {
+            Object **fields = obj->value.instance.fields;
+
+            if (fields != NULL)
+                MEM_TRACK_FREE(MEM_OBJECT, fields);
+            fields = realloc(fields, cap * sizeof(Object*));
+            MEM_TRACK_ALLOC(MEM_OBJECT, "instance fields", fields, cap * sizeof(Object*));
+            obj->value.instance.fields = fields;
+            HeapCharge(obj, (cap - old_cap) * sizeof(Object*));
+        }
+
+        obj->value.instance.shape = shape;
+        obj->len = shape->n_fields;
+    }
+
+    obj->value.instance.fields[index] = value;
+    HeapWrite(obj, value);
+}
+
+/* The sign of a NaN depends on which operand the hardware passed on, and
+ * the compiler may swap the operands of '+' and '*'. */
+static inline double canonical(double value) {
+    return isnan(value) ? NAN : value;
+}
+
+char *ObjectToString(Object *obj) {
+    char *retval = NULL;
+
+    switch (obj->type) {
+    case OBJECT_NUMBER: {
+        double value = canonical(obj->value.f);
+        int n = snprintf(NULL, 0, "%.3f", value);
+        retval = malloc(n + 1);
+        snprintf(retval, n + 1, "%.3f", value);
+        break;
+    }
+    case OBJECT_BOOL:
+        retval = strdup(obj->value.b ? "true" : "false");
+        break;
+    case OBJECT_NIL:
+        retval = strdup("nil");
+        break;
+    case OBJECT_STRING: {
+        size_t len = ObjectStrLen(obj);
+        retval = malloc(len + 3);
+        retval[0] = '\'';
+        memcpy(retval + 1, ObjectStrChars(obj), len);
+        retval[len + 1] = '\'';
+        retval[len + 2] = '\0';
+        break;
+    }
+    case OBJECT_INSTANCE: {
+        const char *name = ShapeClassName(obj->value.instance.shape);
+        int n = snprintf(NULL, 0, "%s instance", name);
+        retval = malloc(n + 1);
+        snprintf(retval, n + 1, "%s instance", name);
+        break;
+    }
+    }
+
+    return retval;
+}
+
+void ObjectPrintNumber(FILE *f, double value) {
+    fprintf(f, "%.3f", canonical(value));
+}
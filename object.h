@@ -1,59 +1,249 @@
 #ifndef OBJECT_H_
 #define OBJECT_H_
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
+
+#include "heap.h"
+#include "memtrack.h"
 
 typedef enum {
     OBJECT_NUMBER,
     OBJECT_BOOL,
     OBJECT_STRING,
-    OBJECT_NIL
+    OBJECT_NIL,
+    OBJECT_INSTANCE
 } ObjectType;
 
-typedef struct {
-    ObjectType type;
+/* Where an object lives. Constants are owned by the AST and are never
+ * collected; everything the interpreter creates starts in the nursery. */
+typedef enum {
+    GEN_CONST,
+    GEN_NURSERY,
+    GEN_OLD,
+    GEN_FORWARDED
+} ObjectGen;
+
+/* Strings shorter than this are stored inline, NUL included. */
+#define OBJECT_SMALL_STR 16
+
+/* Concatenations shorter than this are copied instead of building a rope. */
+#define OBJECT_ROPE_MIN 64
+
+#define OBJECT_STR_MAX UINT32_MAX
+
+/* Instances with fields have room for at least this many. */
+#define OBJECT_FIELDS_MIN 4
+
+typedef struct Shape Shape;
+
+typedef enum {
+    STR_SMALL,
+    STR_FLAT,
+    STR_ROPE
+} StrRepr;
+
+/* For an instance, len counts its fields, which shape names. */
+struct Object {
+    uint8_t type;
+    uint8_t gen;
+    bool marked;
+    uint8_t repr;
+    uint32_t len;
+    struct Object *next;
     union {
         bool b;
         double f;
-        char *str;
+        char *chars;
+        char small[OBJECT_SMALL_STR];
+        struct {
+            struct Object *left;
+            struct Object *right;
+        } rope;
+        struct {
+            Shape *shape;
+            struct Object **fields;
+        } instance;
     } value;
-} Object;
+};
+
+void ObjectStrFlatten(Object *obj);
+
+/* The form the REPL prints a value in, as a malloc'd string. */
+char *ObjectToString(Object *obj);
+
+/* Writes a number in the same form, for results that are not Objects. */
+void ObjectPrintNumber(FILE *f, double value);
+
+Object *ObjectStrConcat(Object *left, Object *right);
+Object *ObjectStrRepeat(Object *str, size_t count);
+
+/* Ropes are flattened in place on first access. Both of the flat
+ * representations are NUL-terminated. */
+static inline const char *ObjectStrChars(Object *obj) {
+    if (obj->repr == STR_ROPE)
+        ObjectStrFlatten(obj);
+
+    return obj->repr == STR_SMALL ? obj->value.small : obj->value.chars;
+}
+
+static inline size_t ObjectStrLen(const Object *obj) {
+    return obj->len;
+}
+
+static inline bool ObjectIsRope(const Object *obj) {
+    return obj->type == OBJECT_STRING && obj->repr == STR_ROPE;
+}
+
+static inline void ObjectStrRelease(Object *obj) {
+    if (obj->type == OBJECT_STRING && obj->repr == STR_FLAT) {
+        MEM_TRACK_FREE(MEM_STRING, obj->value.chars);
+        free(obj->value.chars);
+    }
+}
+
+/* The number of fields an instance with n of them has room for. */
+static inline size_t ObjectFieldsCapacity(size_t n) {
+    size_t cap = OBJECT_FIELDS_MIN;
 
+    if (n == 0)
+        return 0;
+    while (cap < n)
+        cap *= 2;
+
+    return cap;
+}
+
+static inline void ObjectInstanceRelease(Object *obj) {
+    if (obj->type == OBJECT_INSTANCE && obj->value.instance.fields != NULL) {
+        MEM_TRACK_FREE(MEM_OBJECT, obj->value.instance.fields);
+        free(obj->value.instance.fields);
+    }
+}
+
+/* Stores value at index of an instance, moving it to shape first. shape is
+ * either the instance's own, or the one adding field index to it. */
+void ObjectInstanceStore(Object *obj, Shape *shape, size_t index, Object *value);
+
+static inline void __ObjectStrFill(Object *obj, const char *value, size_t len) {
+    obj->len = len;
+
+    if (len < OBJECT_SMALL_STR) {
+        obj->repr = STR_SMALL;
+        memcpy(obj->value.small, value, len);
+        obj->value.small[len] = '\0';
+        return;
+    }
+
+    obj->repr = STR_FLAT;
+    obj->value.chars = malloc(len + 1);
+    memcpy(obj->value.chars, value, len);
+    obj->value.chars[len] = '\0';
+    MEM_TRACK_ALLOC(MEM_STRING, "string constant", obj->value.chars, len + 1);
+}
+
+/* ---- CONSTANTS (owned by Literal nodes) ---- */
+
+#define ObjectConstBool(v) (Object){ .type = OBJECT_BOOL, .gen = GEN_CONST, .value.b = (v) }
+#define ObjectConstNum(v) (Object){ .type = OBJECT_NUMBER, .gen = GEN_CONST, .value.f = (v) }
+#define ObjectConstNil (Object){ .type = OBJECT_NIL, .gen = GEN_CONST }
+
+static inline Object ObjectConstStr(const char *value, size_t len) {
+    Object retval = { .type = OBJECT_STRING, .gen = GEN_CONST };
+    __ObjectStrFill(&retval, value, len);
+    return retval;
+}
+
+/* ---- HEAP OBJECTS ---- */
+
+/*
+ * What the evaluator hands back is either borrowed or owned. Constants,
+ * bound parameters and the shared booleans and nil are borrowed: they are
+ * never collected and must never be written to. Anything on the heap is
+ * owned by whoever evaluated it, until it is returned, which passes it on
+ * without a copy. An owned number can therefore be overwritten in place by
+ * the operation that consumes it.
+ */
+extern Object objectTrue;
+extern Object objectFalse;
+extern Object objectNil;
+
+static inline bool ObjectIsOwned(const Object *obj) {
+    return obj->gen != GEN_CONST;
+}
+
+/* Takes ownership of a malloc'd, NUL-terminated buffer of len bytes. */
+static inline Object *ObjectStrTake(char *str, size_t len) {
+    if (len < OBJECT_SMALL_STR) {
+        char small[OBJECT_SMALL_STR];
+        memcpy(small, str, len + 1);
+        free(str);
+
+        Object *retval = HeapAlloc();
+        retval->type = OBJECT_STRING;
+        retval->repr = STR_SMALL;
+        retval->len = len;
+        memcpy(retval->value.small, small, len + 1);
+        return retval;
+    }
+
+    Object *retval = HeapAlloc();
+    retval->type = OBJECT_STRING;
+    retval->repr = STR_FLAT;
+    retval->len = len;
+    retval->value.chars = str;
+    MEM_TRACK_ALLOC(MEM_STRING, "ObjectStrTake", str, len + 1);
+    HeapCharge(retval, len + 1);
+    return retval;
+}
+
+/* value may point into a dead nursery object, so it is copied out before
+ * anything is allocated. */
 static inline Object *ObjectStr(const char *value, size_t len) {
-    Object *retval = malloc(sizeof(Object));
+    if (len < OBJECT_SMALL_STR) {
+        char small[OBJECT_SMALL_STR];
+        memcpy(small, value, len);
+
+        Object *retval = HeapAlloc();
+        retval->type = OBJECT_STRING;
+        __ObjectStrFill(retval, small, len);
+        return retval;
+    }
 
-    *retval = (Object){ .type = OBJECT_STRING, .value.str = malloc(len + 1) };
-    retval->value.str[len] = '\0';
+    char *str = malloc(len + 1);
 
-    for (size_t i = 0; i < len; i++)
-        retval->value.str[i] = value[i];
+    memcpy(str, value, len);
+    str[len] = '\0';
 
-    return retval; 
+    return ObjectStrTake(str, len);
 }
 
 static inline Object *ObjectBool(bool value) {
-    Object *retval = malloc(sizeof(Object));
-    *retval = (Object){ .type = OBJECT_BOOL, .value.b = value };
-    return retval;    
+    return value ? &objectTrue : &objectFalse;
 }
 
 static inline Object *ObjectNum(double value) {
-    Object *retval = malloc(sizeof(Object));
-    *retval = (Object){ .type = OBJECT_NUMBER, .value.f = value };
-    return retval;    
+    Object *retval = HeapAlloc();
+    retval->type = OBJECT_NUMBER;
+    retval->value.f = value;
+    return retval;
 }
 
 static inline Object *ObjectNil() {
-    Object *retval = malloc(sizeof(Object));
-    *retval = (Object){ .type = OBJECT_NIL };
-    return retval;    
+    return &objectNil;
 }
 
-static inline void ObjectFini(Object *obj) {
-    if (obj->type == OBJECT_STRING)
-        free(obj->value.str);
-    free(obj);
+/* An instance with no fields yet. */
+static inline Object *ObjectInstance(Shape *shape) {
+    Object *retval = HeapAlloc();
+    retval->type = OBJECT_INSTANCE;
+    retval->len = 0;
+    retval->value.instance.shape = shape;
+    retval->value.instance.fields = NULL;
+    return retval;
 }
 
 #endif
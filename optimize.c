@@ -0,0 +1,679 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "optimize.h"
+#include "strkernel.h"
+#include "trace.h"
+
+typedef enum {
+    KIND_BINARY,
+    KIND_TERTIARY,
+    KIND_LOGICAL,
+    KIND_GROUPING,
+    KIND_LITERAL,
+    KIND_UNARY,
+    KIND_VARIABLE,
+    KIND_CALL,
+    KIND_NEW,
+    KIND_GET,
+    KIND_SET,
+    KIND_INVOKE,
+    KIND_SCRIPT
+} ExprKind;
+
+typedef struct Rewriter Rewriter;
+
+/* A pass rewrites a node once its children have been rewritten, returning
+ * the node that takes its place. Kinds without a hook are left alone. */
+typedef struct {
+    const char *name;
+    int level;
+    Expr *(*unary)(Rewriter *r, Unary *u);
+    Expr *(*binary)(Rewriter *r, Binary *b);
+    Expr *(*tertiary)(Rewriter *r, Tertiary *t);
+    Expr *(*logical)(Rewriter *r, Logical *l);
+    Expr *(*grouping)(Rewriter *r, Grouping *g);
+} Pass;
+
+struct Rewriter {
+    ExprVisitor base;
+    const Pass *pass;
+    size_t rewrites;
+};
+
+/* ---- HELPER FUNCTIONS ---- */
+
+static uint64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void *kindBinary(ExprVisitor *v, Binary *b) { return (void*)(uintptr_t)KIND_BINARY; }
+static void *kindTertiary(ExprVisitor *v, Tertiary *t) { return (void*)(uintptr_t)KIND_TERTIARY; }
+static void *kindLogical(ExprVisitor *v, Logical *l) { return (void*)(uintptr_t)KIND_LOGICAL; }
+static void *kindGrouping(ExprVisitor *v, Grouping *g) { return (void*)(uintptr_t)KIND_GROUPING; }
+static void *kindLiteral(ExprVisitor *v, Literal *l) { return (void*)(uintptr_t)KIND_LITERAL; }
+static void *kindUnary(ExprVisitor *v, Unary *u) { return (void*)(uintptr_t)KIND_UNARY; }
+static void *kindVariable(ExprVisitor *v, Variable *var) { return (void*)(uintptr_t)KIND_VARIABLE; }
+static void *kindCall(ExprVisitor *v, Call *c) { return (void*)(uintptr_t)KIND_CALL; }
+static void *kindNew(ExprVisitor *v, New *n) { return (void*)(uintptr_t)KIND_NEW; }
+static void *kindGet(ExprVisitor *v, Get *g) { return (void*)(uintptr_t)KIND_GET; }
+static void *kindSet(ExprVisitor *v, Set *s) { return (void*)(uintptr_t)KIND_SET; }
+static void *kindInvoke(ExprVisitor *v, Invoke *i) { return (void*)(uintptr_t)KIND_INVOKE; }
+static void *kindScript(ExprVisitor *v, Script *s) { return (void*)(uintptr_t)KIND_SCRIPT; }
+
+static ExprVisitor kindVisitor = {
+    .visitBinaryExpr = kindBinary,
+    .visitTertiaryExpr = kindTertiary,
+    .visitLogicalExpr = kindLogical,
+    .visitGroupingExpr = kindGrouping,
+    .visitLiteralExpr = kindLiteral,
+    .visitUnaryExpr = kindUnary,
+    .visitVariableExpr = kindVariable,
+    .visitCallExpr = kindCall,
+    .visitNewExpr = kindNew,
+    .visitGetExpr = kindGet,
+    .visitSetExpr = kindSet,
+    .visitInvokeExpr = kindInvoke,
+    .visitScriptExpr = kindScript
+};
+
+static inline ExprKind kindOf(Expr *e) {
+    return (ExprKind)(uintptr_t)e->accept(&kindVisitor, e);
+}
+
+static inline Object *literalOf(Expr *e) {
+    return kindOf(e) == KIND_LITERAL ? &((Literal*)e)->object : NULL;
+}
+
+static inline bool isNumber(Expr *e, double value) {
+    Object *obj = literalOf(e);
+    return obj != NULL && obj->type == OBJECT_NUMBER && obj->value.f == value &&
+           signbit(obj->value.f) == signbit(value);
+}
+
+static inline bool isBool(Expr *e, bool value) {
+    Object *obj = literalOf(e);
+    return obj != NULL && obj->type == OBJECT_BOOL && obj->value.b == value;
+}
+
+static StaticType typeOf(const Object *obj) {
+    switch (obj->type) {
+    case OBJECT_NUMBER: return TYPE_NUMBER;
+    case OBJECT_BOOL: return TYPE_BOOL;
+    case OBJECT_STRING: return TYPE_STRING;
+    default: return TYPE_NIL;
+    }
+}
+
+/* Stands in for a child that has been moved out, so that freeing its old
+ * parent leaves it alone. */
+static void finiDetached(Expr *e) {}
+static Expr detached = { .fini = finiDetached };
+
+/* Frees node, apart from *child, which takes its place. */
+static Expr *keep(Rewriter *r, Expr *node, Expr **child) {
+    Expr *retval = *child;
+
+    *child = &detached;
+    ExprFini(node);
+    r->rewrites++;
+    return retval;
+}
+
+/* Frees node, and puts replacement in its place and its source span. */
+static Expr *replace(Rewriter *r, Expr *node, Expr *replacement) {
+    replacement->line = node->line;
+    replacement->span = node->span;
+    replacement->span_len = node->span_len;
+
+    ExprFini(node);
+    r->rewrites++;
+    return replacement;
+}
+
+static Expr *literal(Rewriter *r, Expr *node, Object value) {
+    Literal *l = LiteralInit(value);
+    l->base.type = typeOf(&l->object);
+    return replace(r, node, &l->base);
+}
+
+/* Whether evaluating e can never report an error, so that dropping it
+ * changes nothing. Parameters may be unbound, strings may grow too long,
+ * calls may nest too deep and properties may be missing, so none of them
+ * is safe. Setting a field is never dropped either, as it is seen later. */
+static bool cannotFail(Expr *e) {
+    switch (kindOf(e)) {
+    case KIND_LITERAL:
+        return true;
+    case KIND_VARIABLE:
+    case KIND_CALL:
+    case KIND_NEW:
+    case KIND_GET:
+    case KIND_SET:
+    case KIND_INVOKE:
+    case KIND_SCRIPT:
+        return false;
+    case KIND_GROUPING:
+        return cannotFail(((Grouping*)e)->expr);
+    case KIND_UNARY: {
+        Unary *u = (Unary*)e;
+        StaticType want = u->operation == OPER_NEGATE ? TYPE_NUMBER : TYPE_BOOL;
+        return u->right->type == want && cannotFail(u->right);
+    }
+    case KIND_TERTIARY: {
+        Tertiary *t = (Tertiary*)e;
+        return t->condition->type == TYPE_BOOL && cannotFail(t->condition) &&
+               cannotFail(t->ifTrue) && cannotFail(t->ifFalse);
+    }
+    case KIND_LOGICAL: {
+        Logical *l = (Logical*)e;
+        for (size_t i = 0; i < l->n_operands; i++) {
+            if (l->operands[i]->type != TYPE_BOOL || !cannotFail(l->operands[i]))
+                return false;
+        }
+        return true;
+    }
+    case KIND_BINARY:
+        break;
+    }
+
+    Binary *b = (Binary*)e;
+    StaticType left = b->left->type, right = b->right->type;
+    bool safe;
+
+    switch (b->operation) {
+    case OPER_COMMA:
+    case OPER_EQUAL:
+    case OPER_NOT_EQUAL:
+        safe = true;
+        break;
+    case OPER_LESS:
+    case OPER_LESS_EQUAL:
+    case OPER_GREATER:
+    case OPER_GREATER_EQUAL:
+        safe = left == right && (left == TYPE_NUMBER || left == TYPE_STRING);
+        break;
+    default:
+        safe = left == TYPE_NUMBER && right == TYPE_NUMBER;
+        break;
+    }
+
+    return safe && cannotFail(b->left) && cannotFail(b->right);
+}
+
+/* The evaluator's semantics on two constants. False when the operation
+ * would fail, or build a string longer than OPTIMIZE_FOLD_STR_MAX. */
+static bool foldBinary(Operation op, Object *a, Object *b, Object *out) {
+    if (a->type == OBJECT_NUMBER && b->type == OBJECT_NUMBER) {
+        double x = a->value.f, y = b->value.f;
+
+        switch (op) {
+        case OPER_ADD: *out = ObjectConstNum(x + y); return true;
+        case OPER_SUB: *out = ObjectConstNum(x - y); return true;
+        case OPER_MUL: *out = ObjectConstNum(x * y); return true;
+        case OPER_DIV: *out = ObjectConstNum(x / y); return true;
+        case OPER_EQUAL: *out = ObjectConstBool(x == y); return true;
+        case OPER_NOT_EQUAL: *out = ObjectConstBool(x != y); return true;
+        case OPER_LESS: *out = ObjectConstBool(x < y); return true;
+        case OPER_LESS_EQUAL: *out = ObjectConstBool(x <= y); return true;
+        case OPER_GREATER: *out = ObjectConstBool(x > y); return true;
+        case OPER_GREATER_EQUAL: *out = ObjectConstBool(x >= y); return true;
+        default: return false;
+        }
+    }
+
+    bool strings = a->type == OBJECT_STRING && b->type == OBJECT_STRING;
+    char buffer[OPTIMIZE_FOLD_STR_MAX + 1];
+
+    switch (op) {
+    case OPER_EQUAL:
+    case OPER_NOT_EQUAL: {
+        bool same = a->type == b->type &&
+                    (a->type == OBJECT_NIL ||
+                     (a->type == OBJECT_BOOL && a->value.b == b->value.b) ||
+                     (strings && StrEqual(ObjectStrChars(a), a->len, ObjectStrChars(b), b->len)));
+        *out = ObjectConstBool(same == (op == OPER_EQUAL));
+        return true;
+    }
+
+    case OPER_LESS:
+    case OPER_LESS_EQUAL:
+    case OPER_GREATER:
+    case OPER_GREATER_EQUAL: {
+        if (!strings)
+            return false;
+
+        int order = StrCompare(ObjectStrChars(a), a->len, ObjectStrChars(b), b->len);
+        bool value = op == OPER_LESS ? order < 0 : op == OPER_LESS_EQUAL ? order <= 0 :
+                     op == OPER_GREATER ? order > 0 : order >= 0;
+        *out = ObjectConstBool(value);
+        return true;
+    }
+
+    case OPER_ADD: {
+        if (!strings || (size_t)a->len + b->len > OPTIMIZE_FOLD_STR_MAX)
+            return false;
+
+        memcpy(buffer, ObjectStrChars(a), a->len);
+        memcpy(buffer + a->len, ObjectStrChars(b), b->len);
+        *out = ObjectConstStr(buffer, (size_t)a->len + b->len);
+        return true;
+    }
+
+    case OPER_MUL: {
+        Object *str = a->type == OBJECT_STRING ? a : b;
+        Object *count = a->type == OBJECT_STRING ? b : a;
+
+        if (str->type != OBJECT_STRING || count->type != OBJECT_NUMBER)
+            return false;
+
+        double n = count->value.f;
+        if (n < 0 || n > OPTIMIZE_FOLD_STR_MAX || n != (uint32_t)n ||
+            n * str->len > OPTIMIZE_FOLD_STR_MAX)
+            return false;
+
+        for (size_t i = 0; i < (size_t)n; i++)
+            memcpy(buffer + i * str->len, ObjectStrChars(str), str->len);
+        *out = ObjectConstStr(buffer, (size_t)n * str->len);
+        return true;
+    }
+
+    default:
+        return false;
+    }
+}
+
+/* ---- PASSES ---- */
+
+static Expr *groupingPass(Rewriter *r, Grouping *g) {
+    return keep(r, &g->base, &g->expr);
+}
+
+static Expr *foldUnary(Rewriter *r, Unary *u) {
+    Object *obj = literalOf(u->right);
+
+    if (obj != NULL && u->operation == OPER_NEGATE && obj->type == OBJECT_NUMBER)
+        return literal(r, &u->base, ObjectConstNum(-obj->value.f));
+    if (obj != NULL && u->operation == OPER_BOOL_NOT && obj->type == OBJECT_BOOL)
+        return literal(r, &u->base, ObjectConstBool(!obj->value.b));
+
+    return &u->base;
+}
+
+static Expr *foldBinaryPass(Rewriter *r, Binary *b) {
+    Object *left = literalOf(b->left);
+    Object *right = literalOf(b->right);
+    Object value;
+
+    if (left == NULL || right == NULL || !foldBinary(b->operation, left, right, &value))
+        return &b->base;
+
+    return literal(r, &b->base, value);
+}
+
+static Expr *branchPass(Rewriter *r, Tertiary *t) {
+    Object *condition = literalOf(t->condition);
+
+    if (condition == NULL || condition->type != OBJECT_BOOL)
+        return &t->base;
+
+    return keep(r, &t->base, condition->value.b ? &t->ifTrue : &t->ifFalse);
+}
+
+/*
+ * A constant operand either decides the chain, so that nothing after it
+ * runs, or changes nothing and is dropped: false and true for 'and', the
+ * other way around for 'or'. A lone operand left over stands for the chain
+ * once it is a proven bool, as otherwise the chain's check is needed.
+ */
+static Expr *branchLogical(Rewriter *r, Logical *l) {
+    bool decides = l->operation == OPER_OR;
+    size_t n = 0;
+
+    for (size_t i = 0; i < l->n_operands; i++) {
+        Expr *operand = l->operands[i];
+
+        if (isBool(operand, !decides)) {
+            ExprFini(operand);
+            r->rewrites++;
+            continue;
+        }
+
+        l->operands[n++] = operand;
+        if (isBool(operand, decides)) {
+            for (size_t j = i + 1; j < l->n_operands; j++)
+                ExprFini(l->operands[j]);
+            r->rewrites += l->n_operands - i - 1;
+            break;
+        }
+    }
+
+    l->n_operands = n;
+    if (n == 0)
+        return literal(r, &l->base, ObjectConstBool(!decides));
+    if (n == 1 && l->operands[0]->type == TYPE_BOOL)
+        return keep(r, &l->base, &l->operands[0]);
+
+    return &l->base;
+}
+
+/* !!b is b, and --x is x, once the operand is known to be of the type the
+ * operator checks for. */
+static Expr *algebraUnary(Rewriter *r, Unary *u) {
+    StaticType want = u->operation == OPER_NEGATE ? TYPE_NUMBER : TYPE_BOOL;
+    if (kindOf(u->right) != KIND_UNARY)
+        return &u->base;
+
+    Unary *inner = (Unary*)u->right;
+    if (inner->operation != u->operation || inner->right->type != want)
+        return &u->base;
+
+    return keep(r, &u->base, &inner->right);
+}
+
+/*
+ * Identities that hold for every double, NaN and signed zero included:
+ * x * 1, x / 1, x - 0 and x + -0 are x, and dividing by a power of two is
+ * multiplying by its reciprocal, which rounds the same real number. x * -1
+ * is not -x, as negation flips the sign of a NaN and multiplication keeps
+ * it. For booleans, b == true is b and b == false is !b. Each needs x to be
+ * a proven number, or b a proven bool, as otherwise the evaluator's type
+ * error would be lost.
+ */
+static Expr *algebraBinary(Rewriter *r, Binary *b) {
+    bool numbers = b->left->type == TYPE_NUMBER && b->right->type == TYPE_NUMBER;
+    bool bools = b->left->type == TYPE_BOOL && b->right->type == TYPE_BOOL;
+    int exponent;
+
+    switch (b->operation) {
+    case OPER_MUL:
+        if (!numbers)
+            break;
+        if (isNumber(b->right, 1))
+            return keep(r, &b->base, &b->left);
+        if (isNumber(b->left, 1))
+            return keep(r, &b->base, &b->right);
+        break;
+
+    case OPER_DIV: {
+        Object *divisor = literalOf(b->right);
+        if (!numbers || divisor == NULL)
+            break;
+        if (isNumber(b->right, 1))
+            return keep(r, &b->base, &b->left);
+
+        double reciprocal = 1 / divisor->value.f;
+        if (fabs(frexp(divisor->value.f, &exponent)) != 0.5 || !isnormal(reciprocal) ||
+            !isnormal(divisor->value.f))
+            break;
+
+        Literal *l = LiteralInit(ObjectConstNum(reciprocal));
+        l->base.type = TYPE_NUMBER;
+        b->right = replace(r, b->right, &l->base);
+        b->operation = OPER_MUL;
+        break;
+    }
+
+    case OPER_SUB:
+        if (numbers && isNumber(b->right, 0))
+            return keep(r, &b->base, &b->left);
+        break;
+
+    case OPER_ADD:
+        if (numbers && isNumber(b->right, -0.0))
+            return keep(r, &b->base, &b->left);
+        if (numbers && isNumber(b->left, -0.0))
+            return keep(r, &b->base, &b->right);
+        break;
+
+    case OPER_EQUAL:
+    case OPER_NOT_EQUAL: {
+        if (!bools)
+            break;
+
+        bool equal = b->operation == OPER_EQUAL;
+        Expr **other = literalOf(b->right) != NULL ? &b->left : &b->right;
+        Expr *constant = other == &b->left ? b->right : b->left;
+
+        if (isBool(constant, equal))
+            return keep(r, &b->base, other);
+
+        if (isBool(constant, !equal)) {
+            Expr *x = *other;
+            *other = &detached;
+
+            Unary *u = UnaryInit(OPER_BOOL_NOT, x);
+            u->base.type = TYPE_BOOL;
+            return replace(r, &b->base, &u->base);
+        }
+        break;
+    }
+
+    default:
+        break;
+    }
+
+    return &b->base;
+}
+
+/* The left operand of ',' is only evaluated for its errors. */
+static Expr *dcePass(Rewriter *r, Binary *b) {
+    if (b->operation != OPER_COMMA || !cannotFail(b->left))
+        return &b->base;
+
+    return keep(r, &b->base, &b->right);
+}
+
+static const Pass passes[OPTIMIZE_PASS_COUNT] = {
+    { .name = "grouping", .level = 1, .grouping = groupingPass },
+    { .name = "fold", .level = 1, .unary = foldUnary, .binary = foldBinaryPass },
+    { .name = "branch", .level = 1, .tertiary = branchPass, .logical = branchLogical },
+    { .name = "algebra", .level = 2, .unary = algebraUnary, .binary = algebraBinary },
+    { .name = "dce", .level = 2, .binary = dcePass }
+};
+
+/* ---- ExprVisitorS ---- */
+
+static inline Expr *rewrite(ExprVisitor *v, Expr *expr) {
+    return expr->accept(v, expr);
+}
+
+static void *visitBinaryExpr(ExprVisitor *v, Binary *b) {
+    Rewriter *r = (Rewriter*)v;
+    b->left = rewrite(v, b->left);
+    b->right = rewrite(v, b->right);
+    return r->pass->binary != NULL ? r->pass->binary(r, b) : &b->base;
+}
+
+static void *visitTertiaryExpr(ExprVisitor *v, Tertiary *t) {
+    Rewriter *r = (Rewriter*)v;
+    t->condition = rewrite(v, t->condition);
+    t->ifTrue = rewrite(v, t->ifTrue);
+    t->ifFalse = rewrite(v, t->ifFalse);
+    return r->pass->tertiary != NULL ? r->pass->tertiary(r, t) : &t->base;
+}
+
+static void *visitLogicalExpr(ExprVisitor *v, Logical *l) {
+    Rewriter *r = (Rewriter*)v;
+
+    for (size_t i = 0; i < l->n_operands; i++)
+        l->operands[i] = rewrite(v, l->operands[i]);
+
+    return r->pass->logical != NULL ? r->pass->logical(r, l) : &l->base;
+}
+
+static void *visitGroupingExpr(ExprVisitor *v, Grouping *g) {
+    Rewriter *r = (Rewriter*)v;
+    g->expr = rewrite(v, g->expr);
+    return r->pass->grouping != NULL ? r->pass->grouping(r, g) : &g->base;
+}
+
+static void *visitUnaryExpr(ExprVisitor *v, Unary *u) {
+    Rewriter *r = (Rewriter*)v;
+    u->right = rewrite(v, u->right);
+    return r->pass->unary != NULL ? r->pass->unary(r, u) : &u->base;
+}
+
+static void *visitLiteralExpr(ExprVisitor *v, Literal *l) {
+    return &l->base;
+}
+
+static void *visitVariableExpr(ExprVisitor *v, Variable *var) {
+    return &var->base;
+}
+
+static void *visitCallExpr(ExprVisitor *v, Call *c) {
+    for (size_t i = 0; i < c->callee->arity; i++)
+        c->args[i] = rewrite(v, c->args[i]);
+
+    return &c->base;
+}
+
+static void *visitNewExpr(ExprVisitor *v, New *n) {
+    size_t arity = n->klass->init != NULL ? n->klass->init->arity - 1 : 0;
+
+    for (size_t i = 0; i < arity; i++)
+        n->args[i] = rewrite(v, n->args[i]);
+
+    return &n->base;
+}
+
+static void *visitGetExpr(ExprVisitor *v, Get *g) {
+    g->object = rewrite(v, g->object);
+    return &g->base;
+}
+
+static void *visitSetExpr(ExprVisitor *v, Set *s) {
+    s->object = rewrite(v, s->object);
+    s->value = rewrite(v, s->value);
+    return &s->base;
+}
+
+static void *visitInvokeExpr(ExprVisitor *v, Invoke *i) {
+    i->object = rewrite(v, i->object);
+
+    for (size_t k = 0; k < i->n_args; k++)
+        i->args[k] = rewrite(v, i->args[k]);
+
+    return &i->base;
+}
+
+static void *visitScriptExpr(ExprVisitor *v, Script *s) {
+    for (size_t i = 0; i < s->n_functions; i++)
+        s->functions[i].body = rewrite(v, s->functions[i].body);
+
+    for (size_t i = 0; i < s->n_classes; i++) {
+        Class *c = &s->classes[i];
+
+        for (size_t j = 0; j < c->n_methods; j++)
+            c->methods[j].body = rewrite(v, c->methods[j].body);
+    }
+
+    s->body = rewrite(v, s->body);
+    return &s->base;
+}
+
+/* ---- MAIN METHODS ---- */
+
+Optimizer OptimizerInit(int level) {
+    return (Optimizer){ .level = level };
+}
+
+Expr *OptimizerRun(Optimizer *o, Expr *expr) {
+    size_t rounds = o->level >= 2 ? OPTIMIZE_MAX_ROUNDS : 1;
+
+    for (size_t round = 0; round < rounds; round++) {
+        size_t rewrites = 0;
+
+        for (size_t i = 0; i < OPTIMIZE_PASS_COUNT; i++) {
+            const Pass *pass = &passes[i];
+            if (pass->level > o->level)
+                continue;
+
+            Rewriter r = {
+                .base = (ExprVisitor){
+                    .visitBinaryExpr = visitBinaryExpr,
+                    .visitTertiaryExpr = visitTertiaryExpr,
+                    .visitLogicalExpr = visitLogicalExpr,
+                    .visitGroupingExpr = visitGroupingExpr,
+                    .visitLiteralExpr = visitLiteralExpr,
+                    .visitUnaryExpr = visitUnaryExpr,
+                    .visitVariableExpr = visitVariableExpr,
+                    .visitCallExpr = visitCallExpr,
+                    .visitNewExpr = visitNewExpr,
+                    .visitGetExpr = visitGetExpr,
+                    .visitSetExpr = visitSetExpr,
+                    .visitInvokeExpr = visitInvokeExpr,
+                    .visitScriptExpr = visitScriptExpr
+                },
+                .pass = pass,
+                .rewrites = 0
+            };
+
+            uint64_t start = nowNs();
+            TRACE_BEGIN(pass->name, NULL, round);
+            expr = rewrite(&r.base, expr);
+            TRACE_END(pass->name);
+
+            PassStats *s = &o->stats[i];
+            s->runs++;
+            s->rewrites += r.rewrites;
+            s->ns += nowNs() - start;
+            rewrites += r.rewrites;
+
+            if (o->after != NULL && o->print_after != NULL &&
+                strcmp(o->print_after, pass->name) == 0)
+                o->after(pass->name, expr);
+        }
+
+        if (rewrites == 0)
+            break;
+    }
+
+    /* Merging makes nodes reachable from several parents, which no pass
+     * could rewrite in place, so it comes after all of them. */
+    if (o->level >= 2 && !o->keep_tree) {
+        uint64_t start = nowNs();
+        TRACE_BEGIN("share", NULL, 0);
+        expr = ExprShare(expr, &o->share);
+        TRACE_END("share");
+        o->share_ns += nowNs() - start;
+
+        if (o->after != NULL && o->print_after != NULL && strcmp(o->print_after, "share") == 0)
+            o->after("share", expr);
+    }
+
+    return expr;
+}
+
+bool OptimizerHasPass(const char *name) {
+    if (strcmp(name, "share") == 0)
+        return true;
+
+    for (size_t i = 0; i < OPTIMIZE_PASS_COUNT; i++) {
+        if (strcmp(passes[i].name, name) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+void OptimizerPrintStats(const Optimizer *o, FILE *f) {
+    for (size_t i = 0; i < OPTIMIZE_PASS_COUNT; i++) {
+        const PassStats *s = &o->stats[i];
+        if (s->runs == 0)
+            continue;
+
+        fprintf(f, "Pass %-8s: %zu runs, %zu rewrites, %.3f ms\n",
+                passes[i].name, s->runs, s->rewrites, s->ns / 1e6);
+    }
+
+    if (o->share.nodes > 0)
+        fprintf(f, "Pass %-8s: %zu nodes to %zu (%.2fx), %zu cached, %.3f ms\n", "share",
+                o->share.nodes, o->share.unique, (double)o->share.nodes / o->share.unique,
+                o->share.cached, o->share_ns / 1e6);
+}
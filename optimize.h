@@ -0,0 +1,58 @@
+#ifndef OPTIMIZE_H_
+#define OPTIMIZE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "expr.h"
+#include "share.h"
+
+#define OPTIMIZE_PASS_COUNT 5
+
+/* -O2 repeats its pipeline until nothing changes, at most this often. */
+#define OPTIMIZE_MAX_ROUNDS 4
+
+/* Strings longer than this are left for the evaluator to build. */
+#define OPTIMIZE_FOLD_STR_MAX 256
+
+typedef struct {
+    size_t runs;
+    size_t rewrites;
+    uint64_t ns;
+} PassStats;
+
+/*
+ * Rewrites a type checked tree into a cheaper one that evaluates to the
+ * same value, or fails with the same error. Every pass is exact: folding
+ * uses the evaluator's own arithmetic, and the algebraic identities hold
+ * for every IEEE double, NaN and signed zero included.
+ *
+ *   -O0  nothing
+ *   -O1  grouping, fold, branch
+ *   -O2  the above, then algebra and dce, repeated to a fixed point,
+ *        and last share, which merges identical subtrees (see ExprShare)
+ *
+ * Passes run in place and free the nodes they drop. after, when set, is
+ * called with the tree every time the pass named print_after has run.
+ * keep_tree skips share, for consumers that handle every occurrence of a
+ * subtree on its own.
+ */
+typedef struct {
+    int level;
+    bool keep_tree;
+    const char *print_after;
+    void (*after)(const char *pass, Expr *expr);
+    PassStats stats[OPTIMIZE_PASS_COUNT];
+    ShareStats share;
+    uint64_t share_ns;
+} Optimizer;
+
+Optimizer OptimizerInit(int level);
+Expr *OptimizerRun(Optimizer *o, Expr *expr);
+
+bool OptimizerHasPass(const char *name);
+void OptimizerPrintStats(const Optimizer *o, FILE *f);
+
+#endif
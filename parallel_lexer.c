@@ -0,0 +1,227 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "parallel_lexer.h"
+#include "trace.h"
+
+typedef struct {
+    const char *source;
+    size_t start;
+    size_t end;
+    size_t newlines;
+    size_t base_line;
+    TokenList tokens;
+    bool stopped;
+    size_t stop;
+} LexChunk;
+
+/* ---- HELPER FUNCTIONS ---- */
+
+static size_t countNewlines(const char *str, size_t len) {
+    size_t retval = 0;
+    const char *end = str + len;
+
+    while ((str = memchr(str, '\n', end - str)) != NULL) {
+        retval++;
+        str++;
+    }
+
+    return retval;
+}
+
+static void *lexChunk(void *arg) {
+    LexChunk *c = arg;
+    TRACE_BEGIN("lex chunk", NULL, c->start);
+    Lexer lexer = LexerInit(c->source + c->start, c->end - c->start);
+    lexer.quiet = true;
+
+    c->newlines = countNewlines(c->source + c->start, c->end - c->start);
+
+    while (!LexerIsDone(&lexer)) {
+        size_t before = lexer.current;
+        Token token = LexerGetToken(&lexer);
+
+        if (token.type == TOKEN_EOF)
+            break;
+
+        if (token.type == TOKEN_ILLEGAL) {
+            c->stopped = true;
+            c->stop = c->start + before;
+            break;
+        }
+
+        TokenListPush(&c->tokens, token);
+    }
+
+    LexerFini(&lexer);
+    TRACE_END("lex chunk");
+    return NULL;
+}
+
+static void appendChunk(TokenList *out, const LexChunk *c, size_t from) {
+    size_t n = c->tokens.len - from;
+
+    if (out->len + n > out->cap) {
+        out->cap = out->len + n;
+        out->tokens = realloc(out->tokens, out->cap * sizeof(Token));
+    }
+
+    Token *dst = &out->tokens[out->len];
+    memcpy(dst, &c->tokens.tokens[from], n * sizeof(Token));
+    for (size_t i = 0; i < n; i++)
+        dst[i].line += c->base_line;
+
+    out->len += n;
+}
+
+static size_t findChunk(const LexChunk *chunks, size_t n, size_t offset) {
+    size_t lo = 0, hi = n;
+
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (chunks[mid].start <= offset)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+/* Index of the chunk's token that starts at offset, or -1. */
+static long findToken(const LexChunk *c, size_t offset) {
+    const char *at = c->source + offset;
+    size_t lo = 0, hi = c->tokens.len;
+
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        const char *lexeme = c->tokens.tokens[mid].lexeme;
+
+        if (lexeme == at)
+            return mid;
+        if (lexeme < at)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return -1;
+}
+
+/*
+ * Lexes sequentially from the point where chunk j stopped until a token
+ * starts exactly where one of a later chunk's tokens does. Returns the index
+ * of that chunk with *resume set to the token after it, or n when the input
+ * ran out first. *ok is cleared on a genuine lexing error.
+ */
+static size_t relex(const char *source, size_t len, LexChunk *chunks, size_t n,
+                    size_t j, TokenList *out, size_t *resume, bool *ok) {
+    Lexer lexer = LexerInit(source, len);
+    lexer.current = chunks[j].stop;
+    lexer.line = chunks[j].base_line + 1 +
+                 countNewlines(source + chunks[j].start, chunks[j].stop - chunks[j].start);
+
+    size_t retval = n;
+
+    while (!LexerIsDone(&lexer)) {
+        Token token = LexerGetToken(&lexer);
+
+        if (token.type == TOKEN_EOF)
+            break;
+
+        if (token.type == TOKEN_ILLEGAL) {
+            *ok = false;
+            break;
+        }
+
+        TokenListPush(out, token);
+
+        size_t offset = token.lexeme - source;
+        size_t m = findChunk(chunks, n, offset);
+        if (m <= j)
+            continue;
+
+        long k = findToken(&chunks[m], offset);
+        if (k >= 0) {
+            *resume = k + 1;
+            retval = m;
+            break;
+        }
+    }
+
+    LexerFini(&lexer);
+    return retval;
+}
+
+/* ---- MAIN METHODS ---- */
+
+bool LexerTokenizeParallel(const char *source, size_t len, int threads, TokenList *out) {
+    if (threads <= 1 || len < LEX_PARALLEL_MIN)
+        return LexerTokenize(source, len, out);
+
+    LexChunk *chunks = calloc(threads, sizeof(LexChunk));
+    pthread_t *workers = malloc(threads * sizeof(pthread_t));
+    size_t n = 0;
+
+    for (size_t start = 0; start < len && n < (size_t)threads; n++) {
+        size_t end = n + 1 == (size_t)threads ? len : start + len / threads;
+        if (end >= len) {
+            end = len;
+        } else {
+            const char *nl = memchr(source + end, '\n', len - end);
+            end = nl == NULL ? len : (size_t)(nl - source) + 1;
+        }
+
+        chunks[n] = (LexChunk){
+            .source = source,
+            .start = start,
+            .end = end,
+            .tokens = TokenListInit()
+        };
+        start = end;
+    }
+
+    for (size_t i = 1; i < n; i++)
+        pthread_create(&workers[i], NULL, lexChunk, &chunks[i]);
+    lexChunk(&chunks[0]);
+    for (size_t i = 1; i < n; i++)
+        pthread_join(workers[i], NULL);
+
+    for (size_t i = 1; i < n; i++)
+        chunks[i].base_line = chunks[i - 1].base_line + chunks[i - 1].newlines;
+
+    size_t total = out->len;
+    for (size_t i = 0; i < n; i++)
+        total += chunks[i].tokens.len;
+
+    if (total > out->cap) {
+        out->cap = total;
+        out->tokens = realloc(out->tokens, out->cap * sizeof(Token));
+    }
+
+    bool ok = true;
+    size_t resume = 0;
+
+    TRACE_BEGIN("stitch", NULL, n);
+    for (size_t j = 0; j < n && ok;) {
+        appendChunk(out, &chunks[j], resume);
+        resume = 0;
+
+        if (!chunks[j].stopped) {
+            j++;
+            continue;
+        }
+
+        j = relex(source, len, chunks, n, j, out, &resume, &ok);
+    }
+
+    TRACE_END("stitch");
+
+    for (size_t i = 0; i < n; i++)
+        TokenListFini(&chunks[i].tokens);
+
+    free(chunks);
+    free(workers);
+    return ok;
+}
@@ -0,0 +1,25 @@
+#ifndef PARALLEL_LEXER_H_
+#define PARALLEL_LEXER_H_
+
+#include "lexer.h"
+
+/* Inputs smaller than this are not worth the thread start-up. */
+#ifndef LEX_PARALLEL_MIN
+#define LEX_PARALLEL_MIN (1 << 20)
+#endif
+
+/*
+ * Same contract and same output as LexerTokenize, token for token, but the
+ * source is split at newlines into one chunk per thread.
+ *
+ * Every chunk is lexed on the guess that it starts outside of any string
+ * or comment. A chunk whose guess turns out to be wrong ends on an illegal
+ * token, since the string or comment it starts in never closes. The
+ * stitching pass re-lexes sequentially from that point until it lands on a
+ * token boundary of a later chunk again, and takes the rest of that chunk
+ * as it is. Errors are only reported from this sequential pass, so they
+ * come out exactly as LexerTokenize would print them.
+ */
+bool LexerTokenizeParallel(const char *source, size_t len, int threads, TokenList *out);
+
+#endif
@@ -6,6 +6,14 @@
 #include "object.h"
 #include "logging.h"
 #include "parser.h"
+#include "typecheck.h"
+
+#define PARSER_MAX_ARITY 255
+
+/* Every pass after the parser walks the tree recursively, as the parser
+ * does nested rules, so neither may go deeper than this. A chain of binary
+ * operators is a tree as tall as it is long. */
+#define PARSER_MAX_DEPTH 4096
 
 /* ---- HELPER FUNCTIONS ---- */
 
@@ -92,57 +100,289 @@ static bool match(Parser *p, int n, ...) {
     return false;
 }
 
-static Expr *tertiary(Parser *p);
+static Expr *expression(Parser *p);
+static Expr *assignment(Parser *p);
+
+/* Gives expr the source text from first up to the last token consumed. */
+static Expr *spanned(Parser *p, const Token *first, Expr *expr) {
+    if (expr == NULL)
+        return NULL;
+
+    const Token *last = previous(p);
+    size_t len = last->lexeme + last->lexeme_len - first->lexeme;
+    expr->line = first->line;
+    expr->span = first->lexeme;
+    expr->span_len = len < UINT32_MAX ? len : UINT32_MAX;
+    return expr;
+}
+
+/* Errors in an operator are reported on the operator's line, not on that
+ * of its first operand. */
+static Expr *at(const Token *op, Expr *expr) {
+    if (expr != NULL)
+        expr->line = op->line;
+    return expr;
+}
+
+/* Gives expr, whose tallest child is height high, a height of its own,
+ * freeing it instead once that is too tall. */
+static Expr *nested(Parser *p, Expr *expr, size_t height) {
+    if (expr == NULL)
+        return NULL;
+
+    p->height = height + 1;
+    if (p->height > PARSER_MAX_DEPTH) {
+        parser_error(previous(p), "Expression nests too deeply.\n");
+        ExprFini(expr);
+        return NULL;
+    }
+
+    return expr;
+}
+
+/* Parses with rule one level further in. */
+static Expr *descend(Parser *p, Expr *(*rule)(Parser *p)) {
+    if (p->depth == PARSER_MAX_DEPTH) {
+        parser_error(peek(p), "Expression nests too deeply.\n");
+        return NULL;
+    }
+
+    p->depth++;
+    Expr *retval = rule(p);
+    p->depth--;
+    return retval;
+}
+
+static inline size_t max(size_t a, size_t b) {
+    return a > b ? a : b;
+}
+
+static inline bool named(const char *str, const Token *name) {
+    return strlen(str) == name->lexeme_len && strncmp(str, name->lexeme, name->lexeme_len) == 0;
+}
+
+static Function *lookup(Parser *p, const Token *name) {
+    for (size_t i = 0; i < p->n_functions; i++) {
+        if (named(p->functions[i].name, name))
+            return &p->functions[i];
+    }
+
+    return NULL;
+}
+
+static Class *lookupClass(Parser *p, const Token *name) {
+    for (size_t i = 0; i < p->n_classes; i++) {
+        if (named(p->classes[i].name, name))
+            return &p->classes[i];
+    }
+
+    return NULL;
+}
+
+/* Functions and classes are called alike, so their names must differ. */
+static bool declared(Parser *p, const Token *name) {
+    if (lookup(p, name) != NULL) {
+        parser_error(name, "Function is already declared.\n");
+        return true;
+    }
+
+    if (lookupClass(p, name) != NULL) {
+        parser_error(name, "Class is already declared.\n");
+        return true;
+    }
+
+    return false;
+}
+
+static void freeArgs(Expr **args, size_t n_args) {
+    for (size_t i = 0; i < n_args; i++)
+        ExprFini(args[i]);
+    free(args);
+}
+
+static Expr *variable(Parser *p) {
+    const Token *name = previous(p);
+    const char *const *params = p->params;
+    size_t n_params = p->n_params;
+
+    if (p->function != NULL) {
+        params = (const char *const*)p->function->params;
+        n_params = p->function->arity;
+    }
+
+    for (size_t i = 0; i < n_params; i++) {
+        if (named(params[i], name))
+            return (Expr*)VariableInit(name->lexeme, name->lexeme_len, i);
+    }
+
+    parser_error(name, "Undefined parameter.\n");
+    return NULL;
+}
+
+/* Parses arguments up to the closing ')'. They are assignments, as ','
+ * separates them here rather than being the operator. */
+static bool arguments(Parser *p, Expr ***args, size_t *n_args) {
+    size_t height = 0;
+    *args = NULL;
+    *n_args = 0;
+
+    if (!check_type(p, TOKEN_RIGHT_PAREN)) {
+        do {
+            if (*n_args == PARSER_MAX_ARITY) {
+                parser_error(peek(p), "Can't have more than 255 arguments.\n");
+                freeArgs(*args, *n_args);
+                return false;
+            }
+
+            Expr *arg = descend(p, assignment);
+            if (arg == NULL) {
+                freeArgs(*args, *n_args);
+                return false;
+            }
+
+            height = max(height, p->height);
+
+            *args = realloc(*args, (*n_args + 1) * sizeof(Expr*));
+            (*args)[(*n_args)++] = arg;
+        } while (match(p, 1, TOKEN_COMMA));
+    }
+
+    if (consume(p, TOKEN_RIGHT_PAREN, "Expected ')' after arguments.\n") == NULL) {
+        freeArgs(*args, *n_args);
+        return false;
+    }
+
+    p->height = height;
+    return true;
+}
+
+/* Calls a function, or a class, which makes an instance of it and passes
+ * the arguments on to its init. */
+static Expr *call(Parser *p) {
+    const Token *name = previous(p);
+    Function *callee = lookup(p, name);
+    Class *klass = callee == NULL ? lookupClass(p, name) : NULL;
+
+    if (callee == NULL && klass == NULL) {
+        parser_error(name, "Undefined function.\n");
+        return NULL;
+    }
+
+    readToken(p);
+
+    Expr **args;
+    size_t n_args;
+    if (!arguments(p, &args, &n_args))
+        return NULL;
+
+    size_t height = p->height;
+    size_t arity = callee != NULL ? callee->arity :
+                   klass->init != NULL ? klass->init->arity - 1 : 0;
+
+    if (n_args != arity) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "Expected %zu arguments but got %zu.\n", arity, n_args);
+        parser_error(name, msg);
+        freeArgs(args, n_args);
+        return NULL;
+    }
+
+    if (callee != NULL)
+        return nested(p, (Expr*)CallInit(callee, args), height);
+
+    return nested(p, (Expr*)NewInit(klass, args), height);
+}
 
 static Expr *primary(Parser *p) {
+    const Token *first = peek(p);
+    p->height = 1;
+
     if (match(p, 1, TOKEN_TRUE)) {
-        return (Expr*)LiteralInit(ObjectBool(true));
+        return spanned(p, first, (Expr*)LiteralInit(ObjectConstBool(true)));
     } else if (match(p, 1, TOKEN_FALSE)) {
-        return (Expr*)LiteralInit(ObjectBool(false));
+        return spanned(p, first, (Expr*)LiteralInit(ObjectConstBool(false)));
     } else if (match(p, 1, TOKEN_NUMBER)) {
-        char *str_num = malloc(previous(p)->lexeme_len + 1);
-        double num = 0.0;
-
-        str_num[previous(p)->lexeme_len] = '\0';
-
-        strncpy(str_num, previous(p)->lexeme, previous(p)->lexeme_len);
-        num = atof(str_num);
-        free(str_num);
-        
-        return (Expr*)LiteralInit(ObjectNum(num));
+        return spanned(p, first, (Expr*)LiteralInit(ObjectConstNum(TokenNumber(previous(p)))));
     } else if (match(p, 1, TOKEN_STRING)) {
-        return (Expr*)LiteralInit(ObjectStr(&previous(p)->lexeme[1], previous(p)->lexeme_len - 2));
+        return spanned(p, first, (Expr*)LiteralInit(ObjectConstStr(&previous(p)->lexeme[1], previous(p)->lexeme_len - 2)));
     } else if (match(p, 1, TOKEN_NIL)) {
-        return (Expr*)LiteralInit(ObjectNil());
+        return spanned(p, first, (Expr*)LiteralInit(ObjectConstNil));
+    } else if (match(p, 1, TOKEN_IDENTIFIER)) {
+        if (check_type(p, TOKEN_LEFT_PAREN))
+            return spanned(p, first, call(p));
+        return spanned(p, first, variable(p));
+    } else if (match(p, 1, TOKEN_THIS)) {
+        if (p->klass == NULL) {
+            parser_error(previous(p), "Can't use 'this' outside of a class.\n");
+            return NULL;
+        }
+
+        return spanned(p, first, (Expr*)VariableInit("this", 4, 0));
     } else if (match(p, 1, TOKEN_LEFT_PAREN)) {
-        Expr *expr = tertiary(p);
+        Expr *expr = descend(p, expression);
         if (expr == NULL)
             return NULL;
 
+        size_t height = p->height;
         if (consume(p, TOKEN_RIGHT_PAREN, "Expected ')' after expression.\n") == NULL) {
             ExprFini(expr);
             return NULL;
         }
 
-        return (Expr*)GroupingInit(expr);
+        return nested(p, spanned(p, first, (Expr*)GroupingInit(expr)), height);
     }
 
     parser_error(peek(p), "Expected literal.\n");
     return NULL;
 }
 
+/* Every property access is a site with an inline cache of its own. */
+static Expr *access(Parser *p) {
+    const Token *first = peek(p);
+    Expr *expr = primary(p);
+
+    while (expr != NULL && match(p, 1, TOKEN_DOT)) {
+        const Token *name = consume(p, TOKEN_IDENTIFIER, "Expected property name after '.'.\n");
+        if (name == NULL) {
+            ExprFini(expr);
+            return NULL;
+        }
+
+        if (!match(p, 1, TOKEN_LEFT_PAREN)) {
+            expr = (Expr*)GetInit(expr, name->lexeme, name->lexeme_len, p->n_sites++);
+            expr = nested(p, spanned(p, first, expr), p->height);
+            continue;
+        }
+
+        size_t height = p->height;
+        Expr **args;
+        size_t n_args;
+        if (!arguments(p, &args, &n_args)) {
+            ExprFini(expr);
+            return NULL;
+        }
+
+        expr = (Expr*)InvokeInit(expr, name->lexeme, name->lexeme_len, args, n_args, p->n_sites++);
+        expr = nested(p, spanned(p, first, expr), max(height, p->height));
+    }
+
+    return expr;
+}
 
 static Expr *unary(Parser *p) {
+    const Token *first = peek(p);
+
     if (match(p, 2, TOKEN_BANG, TOKEN_MINUS, TOKEN_PLUS)) {
         if (previous(p)->type == TOKEN_PLUS) {
             parser_error(previous(p), "Invalid unary plus");
             return NULL;
         }
 
+        const Token *op = previous(p);
         Operation oper;
         Expr *right;
 
-        switch (previous(p)->type) {
+        switch (op->type) {
         case TOKEN_BANG:
             oper = OPER_BOOL_NOT;
             break;
@@ -153,26 +393,29 @@ static Expr *unary(Parser *p) {
             break;
         }
         
-        right = unary(p);
+        right = descend(p, unary);
         if (right == NULL)
             return NULL;
 
-        return (Expr*)UnaryInit(oper, right);
+        Expr *expr = spanned(p, first, (Expr*)UnaryInit(oper, right));
+        return nested(p, at(op, expr), p->height);
     }
 
-    return primary(p);
+    return access(p);
 }
 
 static Expr *factor(Parser *p) {
+    const Token *first = peek(p);
     Expr *expr = unary(p);
     if (expr == NULL)
         return NULL;
 
     while (match(p, 2, TOKEN_SLASH, TOKEN_STAR)) {
+        const Token *op = previous(p);
         Operation oper;
         Expr *right;
 
-        switch (previous(p)->type) {
+        switch (op->type) {
         case TOKEN_SLASH:
             oper = OPER_DIV;
             break;
@@ -183,28 +426,34 @@ static Expr *factor(Parser *p) {
             break;
         }
         
+        size_t height = p->height;
         right = unary(p);
         if (right == NULL) {
             ExprFini(expr);
             return NULL;
         }
 
-        expr = (Expr*)BinaryInit(expr, oper, right);
+        expr = spanned(p, first, (Expr*)BinaryInit(expr, oper, right));
+        expr = nested(p, at(op, expr), max(height, p->height));
+        if (expr == NULL)
+            return NULL;
     }
 
     return expr;
 }
 
 static Expr *term(Parser *p) {
+    const Token *first = peek(p);
     Expr *expr = factor(p);
     if (expr == NULL)
         return NULL;
 
     while (match(p, 2, TOKEN_PLUS, TOKEN_MINUS)) {
+        const Token *op = previous(p);
         Operation oper;
         Expr *right;
 
-        switch (previous(p)->type) {
+        switch (op->type) {
         case TOKEN_PLUS:
             oper = OPER_ADD;
             break;
@@ -215,29 +464,35 @@ static Expr *term(Parser *p) {
             break;
         }
         
+        size_t height = p->height;
         right = factor(p);
         if (right == NULL) {
             ExprFini(expr);
             return NULL;
         }
         
-        expr = (Expr*)BinaryInit(expr, oper, right);
+        expr = spanned(p, first, (Expr*)BinaryInit(expr, oper, right));
+        expr = nested(p, at(op, expr), max(height, p->height));
+        if (expr == NULL)
+            return NULL;
     }
 
     return expr;
 }
 
 static Expr *comparison(Parser *p) {
+    const Token *first = peek(p);
     Expr *expr = term(p);
     if (expr == NULL)
         return NULL;
 
     while (match(p, 4, TOKEN_LESS, TOKEN_LESS_EQUAL,
                  TOKEN_GREATER, TOKEN_GREATER_EQUAL)) {
+        const Token *op = previous(p);
         Operation oper;
         Expr *right;
-        
-        switch (previous(p)->type) {
+
+        switch (op->type) {
         case TOKEN_LESS:
             oper = OPER_LESS;
             break;
@@ -254,28 +509,34 @@ static Expr *comparison(Parser *p) {
             break;
         }
 
+        size_t height = p->height;
         right = term(p);
         if (hadError) {
             ExprFini(expr);
             return NULL;
         }
 
-        expr = (Expr*)BinaryInit(expr, oper, right);
+        expr = spanned(p, first, (Expr*)BinaryInit(expr, oper, right));
+        expr = nested(p, at(op, expr), max(height, p->height));
+        if (expr == NULL)
+            return NULL;
     }
 
     return expr;
 }
 
 static Expr *equality(Parser *p) {
+    const Token *first = peek(p);
     Expr *expr = comparison(p);
     if (expr == NULL)
         return NULL;
 
     while (match(p, 2, TOKEN_BANG_EQUAL, TOKEN_EQUAL_EQUAL)) {
+        const Token *op = previous(p);
         Operation oper;
         Expr *right;
-        
-        switch (previous(p)->type) {
+
+        switch (op->type) {
         case TOKEN_BANG_EQUAL:
             oper = OPER_NOT_EQUAL;
             break;
@@ -286,36 +547,85 @@ static Expr *equality(Parser *p) {
             break;
         }
 
+        size_t height = p->height;
         right = comparison(p);
         if (right == NULL) {
             ExprFini(expr);
             return NULL;
         }
 
-        expr = (Expr*)BinaryInit(expr, oper, right);
+        expr = spanned(p, first, (Expr*)BinaryInit(expr, oper, right));
+        expr = nested(p, at(op, expr), max(height, p->height));
+        if (expr == NULL)
+            return NULL;
     }
 
     return expr;
 }
 
+/* Every operand of a chain of op goes into one node. */
+static Expr *logical(Parser *p, TokenType op, Expr *(*operand)(Parser *p)) {
+    const Token *first = peek(p);
+    Expr *expr = operand(p);
+    if (expr == NULL || !check_type(p, op))
+        return expr;
+
+    const Token *first_op = peek(p);
+    Expr **operands = malloc(sizeof(Expr*));
+    size_t n_operands = 1;
+    size_t height = p->height;
+    operands[0] = expr;
+
+    while (match(p, 1, op)) {
+        Expr *right = operand(p);
+        if (right == NULL) {
+            freeArgs(operands, n_operands);
+            return NULL;
+        }
+
+        height = max(height, p->height);
+        operands = realloc(operands, (n_operands + 1) * sizeof(Expr*));
+        operands[n_operands++] = right;
+    }
+
+    Operation oper = op == TOKEN_AND ? OPER_AND : OPER_OR;
+    expr = spanned(p, first, (Expr*)LogicalInit(oper, operands, n_operands));
+    return nested(p, at(first_op, expr), height);
+}
+
+static Expr *logicAnd(Parser *p) {
+    return logical(p, TOKEN_AND, equality);
+}
+
+static Expr *logicOr(Parser *p) {
+    return logical(p, TOKEN_OR, logicAnd);
+}
+
 static Expr *tertiary(Parser *p) {
-    Expr *condition = equality(p);
+    const Token *first = peek(p);
+    Expr *condition = logicOr(p);
     if (condition == NULL)
         return NULL;
 
     if (!match(p, 1, TOKEN_QUESTION))
         return condition;
 
-    Expr *ifTrue = equality(p);
+    const Token *question = previous(p);
+    size_t height = p->height;
+    Expr *ifTrue = logicOr(p);
     if (ifTrue == NULL) {
         ExprFini(condition);
         return NULL;
     }
 
+    height = max(height, p->height);
     if (match(p, 1, TOKEN_COLON)) {
-        Expr *ifFalse = equality(p);
-        if (ifFalse != NULL)
-            return (Expr*)TertiaryInit(condition, ifTrue, ifFalse);
+        Expr *ifFalse = logicOr(p);
+        if (ifFalse != NULL) {
+            Expr *expr = (Expr*)TertiaryInit(condition, ifTrue, ifFalse);
+            expr = spanned(p, first, expr);
+            return nested(p, at(question, expr), max(height, p->height));
+        }
 
         ExprFini(condition);
         ExprFini(ifTrue);
@@ -328,29 +638,60 @@ static Expr *tertiary(Parser *p) {
     return NULL;
 }
 
+/* Only a field can be assigned to. */
+static Expr *assignment(Parser *p) {
+    const Token *first = peek(p);
+    Expr *expr = tertiary(p);
+    if (expr == NULL || !match(p, 1, TOKEN_EQUAL))
+        return expr;
+
+    const Token *equals = previous(p);
+    size_t height = p->height;
+    Expr *value = descend(p, assignment);
+    if (value == NULL) {
+        ExprFini(expr);
+        return NULL;
+    }
+
+    if (expr->fini != GetFini) {
+        parser_error(equals, "Invalid assignment target.\n");
+        ExprFini(expr);
+        ExprFini(value);
+        return NULL;
+    }
+
+    return nested(p, spanned(p, first, (Expr*)SetInit((Get*)expr, value)), max(height, p->height));
+}
+
 static Expr *expression(Parser *p) {
     bool isWrong = false;
 
-    if (match(p, 8, TOKEN_SLASH, TOKEN_STAR, TOKEN_COMMA,
+    if (match(p, 10, TOKEN_SLASH, TOKEN_STAR, TOKEN_COMMA,
               TOKEN_LESS, TOKEN_LESS_EQUAL,
               TOKEN_GREATER, TOKEN_GREATER_EQUAL,
-              TOKEN_EQUAL_EQUAL)) {
+              TOKEN_EQUAL_EQUAL, TOKEN_AND, TOKEN_OR)) {
         parser_error(previous(p), "Missing left expression.\n");
         isWrong = true;
     }
 
-    Expr *expr = tertiary(p);
+    const Token *first = peek(p);
+    Expr *expr = assignment(p);
     if (expr == NULL)
         return NULL;
 
     while (match(p, 1, TOKEN_COMMA)) {
-        Expr *right = tertiary(p);
-        if (expr == NULL) {
+        const Token *op = previous(p);
+        size_t height = p->height;
+        Expr *right = assignment(p);
+        if (right == NULL) {
             ExprFini(expr);
             return NULL;
         }
 
-        expr = (Expr*)BinaryInit(expr, OPER_COMMA, right);
+        expr = spanned(p, first, (Expr*)BinaryInit(expr, OPER_COMMA, right));
+        expr = nested(p, at(op, expr), max(height, p->height));
+        if (expr == NULL)
+            return NULL;
     }
 
     if (isWrong) {
@@ -362,17 +703,233 @@ static Expr *expression(Parser *p) {
 }
 
 
+/*
+ * Parses the rest of a function header into f, whose name has been read.
+ * The body is skipped, to be parsed once every function and class is
+ * known, so that calls can refer to those declared later. Gives the index
+ * of the body's first token, or 0 on an error.
+ */
+static size_t signature(Parser *p, Function *f) {
+    size_t first = f->arity;
+
+    if (consume(p, TOKEN_LEFT_PAREN, "Expected '(' after function name.\n") == NULL)
+        return 0;
+
+    if (!check_type(p, TOKEN_RIGHT_PAREN)) {
+        do {
+            const Token *param = consume(p, TOKEN_IDENTIFIER, "Expected parameter name.\n");
+            if (param == NULL)
+                return 0;
+
+            if (f->arity - first == PARSER_MAX_ARITY) {
+                parser_error(param, "Can't have more than 255 parameters.\n");
+                return 0;
+            }
+
+            for (size_t i = 0; i < f->arity; i++) {
+                if (named(f->params[i], param)) {
+                    parser_error(param, "Duplicate parameter.\n");
+                    return 0;
+                }
+            }
+
+            f->params = realloc(f->params, (f->arity + 1) * sizeof(char*));
+            f->params[f->arity++] = strndup(param->lexeme, param->lexeme_len);
+        } while (match(p, 1, TOKEN_COMMA));
+    }
+
+    if (consume(p, TOKEN_RIGHT_PAREN, "Expected ')' after parameters.\n") == NULL ||
+        consume(p, TOKEN_LEFT_BRACE, "Expected '{' before function body.\n") == NULL)
+        return 0;
+
+    size_t body = p->current;
+    while (!isAtEnd(p) && !check_type(p, TOKEN_RIGHT_BRACE))
+        readToken(p);
+
+    if (consume(p, TOKEN_RIGHT_BRACE, "Expected '}' after function body.\n") == NULL)
+        return 0;
+
+    return body;
+}
+
+/* Parses the header of a function into p->functions. Gives the index of
+ * its body, as signature does. */
+static size_t declaration(Parser *p) {
+    const Token *name = consume(p, TOKEN_IDENTIFIER, "Expected function name.\n");
+    if (name == NULL || declared(p, name))
+        return 0;
+
+    p->functions = realloc(p->functions, (p->n_functions + 1) * sizeof(Function));
+    Function *f = &p->functions[p->n_functions++];
+    *f = (Function){ .name = strndup(name->lexeme, name->lexeme_len), .line = name->line };
+
+    return signature(p, f);
+}
+
+/* Parses a class into p->classes, with the header of each method, which
+ * takes this before its own parameters. The index of every method body
+ * is appended to bodies. */
+static bool classDeclaration(Parser *p, size_t **bodies, size_t *n_bodies) {
+    const Token *name = consume(p, TOKEN_IDENTIFIER, "Expected class name.\n");
+    if (name == NULL || declared(p, name))
+        return false;
+
+    p->classes = realloc(p->classes, (p->n_classes + 1) * sizeof(Class));
+    Class *c = &p->classes[p->n_classes++];
+    *c = (Class){ .name = strndup(name->lexeme, name->lexeme_len), .line = name->line };
+
+    if (consume(p, TOKEN_LEFT_BRACE, "Expected '{' before class body.\n") == NULL)
+        return false;
+
+    while (!isAtEnd(p) && !check_type(p, TOKEN_RIGHT_BRACE)) {
+        const Token *method = consume(p, TOKEN_IDENTIFIER, "Expected method name.\n");
+        if (method == NULL)
+            return false;
+
+        for (size_t i = 0; i < c->n_methods; i++) {
+            if (named(c->methods[i].name, method)) {
+                parser_error(method, "Method is already declared.\n");
+                return false;
+            }
+        }
+
+        c->methods = realloc(c->methods, (c->n_methods + 1) * sizeof(Function));
+        Function *f = &c->methods[c->n_methods++];
+        *f = (Function){
+            .name = strndup(method->lexeme, method->lexeme_len),
+            .params = malloc(sizeof(char*)),
+            .arity = 1,
+            .line = method->line
+        };
+        f->params[0] = strdup("this");
+
+        size_t start = signature(p, f);
+        if (start == 0)
+            return false;
+
+        *bodies = realloc(*bodies, (*n_bodies + 1) * sizeof(size_t));
+        (*bodies)[(*n_bodies)++] = start;
+    }
+
+    if (consume(p, TOKEN_RIGHT_BRACE, "Expected '}' after class body.\n") == NULL)
+        return false;
+
+    for (size_t i = 0; i < c->n_methods; i++) {
+        if (strcmp(c->methods[i].name, "init") == 0)
+            c->init = &c->methods[i];
+    }
+
+    return true;
+}
+
+static Expr *body(Parser *p, Function *f, size_t start) {
+    Expr *retval = NULL;
+
+    p->current = start;
+    p->function = f;
+
+    if (consume(p, TOKEN_RETURN, "Expected 'return' at the start of a function body.\n") != NULL) {
+        retval = expression(p);
+        f->height = p->height;
+    }
+
+    if (retval != NULL &&
+        (consume(p, TOKEN_SEMICOLON, "Expected ';' after return value.\n") == NULL ||
+         consume(p, TOKEN_RIGHT_BRACE, "Expected '}' after function body.\n") == NULL)) {
+        ExprFini(retval);
+        retval = NULL;
+    }
+
+    p->function = NULL;
+    return retval;
+}
+
+/* A source that only accesses properties is wrapped too, as the caches
+ * of its sites belong to a Script. */
+static Expr *script(Parser *p) {
+    const Token *first = peek(p);
+    size_t *bodies = NULL;
+    size_t *methods = NULL;
+    size_t n_methods = 0;
+    bool ok = true;
+
+    while (ok && match(p, 2, TOKEN_FUN, TOKEN_CLASS)) {
+        if (previous(p)->type == TOKEN_CLASS) {
+            ok = classDeclaration(p, &methods, &n_methods);
+            continue;
+        }
+
+        size_t start = declaration(p);
+
+        ok = start != 0;
+        if (ok) {
+            bodies = realloc(bodies, p->n_functions * sizeof(size_t));
+            bodies[p->n_functions - 1] = start;
+        }
+    }
+
+    size_t main = p->current;
+
+    for (size_t i = 0; ok && i < p->n_functions; i++) {
+        p->functions[i].body = body(p, &p->functions[i], bodies[i]);
+        ok = p->functions[i].body != NULL;
+    }
+
+    for (size_t i = 0, k = 0; ok && i < p->n_classes; i++) {
+        Class *c = &p->classes[i];
+
+        p->klass = c;
+        for (size_t j = 0; ok && j < c->n_methods; j++) {
+            c->methods[j].body = body(p, &c->methods[j], methods[k++]);
+            ok = c->methods[j].body != NULL;
+        }
+        p->klass = NULL;
+    }
+
+    p->current = main;
+    Expr *expr = ok ? expression(p) : NULL;
+    free(bodies);
+    free(methods);
+
+    if (p->n_functions == 0 && p->n_classes == 0 && (expr == NULL || p->n_sites == 0))
+        return expr;
+
+    Script *retval = ScriptInit(p->functions, p->n_functions, p->classes, p->n_classes,
+                                p->n_sites, expr);
+
+    p->functions = NULL;
+    p->n_functions = 0;
+    p->classes = NULL;
+    p->n_classes = 0;
+
+    if (expr == NULL) {
+        ExprFini(&retval->base);
+        return NULL;
+    }
+
+    return spanned(p, first, &retval->base);
+}
+
 /* ---- MAIN METHODS ---- */
 
 Parser ParserInit(const Token *tokens) {
     return (Parser){ .tokens = tokens, .current = 0 };
 }
 
+Parser ParserInitParams(const Token *tokens, const char *const *params, size_t n_params) {
+    return (Parser){ .tokens = tokens, .current = 0, .params = params, .n_params = n_params };
+}
+
 Expr *ParserParse(Parser *p) {
-    Expr *result = tertiary(p);
+    Expr *result = script(p);
     if (hadError)
         return NULL;
 
+    if (!TypeCheck(result)) {
+        ExprFini(result);
+        return NULL;
+    }
+
     return result;
 }
 
@@ -4,7 +4,50 @@
 typedef struct {
    const Token *tokens;
    size_t current;
+   const char *const *params;
+   size_t n_params;
+
+   /* Every function and class the source declares, the function or
+    * method whose body is being parsed, if any, and the class of that
+    * method. */
+   Function *functions;
+   size_t n_functions;
+   Class *classes;
+   size_t n_classes;
+   Function *function;
+   Class *klass;
+
+   /* Property accesses parsed so far, which number their caches. */
+   size_t n_sites;
+
+   /* How deep the rule being parsed is nested in others, and how tall the
+    * tree of the last expression parsed is. */
+   size_t depth;
+   size_t height;
 } Parser;
 
 Parser ParserInit(const Token tokens[]);
+
+/* Identifiers in the source must name one of params; each becomes a
+ * Variable bound to that parameter's index. Inside a function body they
+ * name the function's own parameters instead, and inside a method "this"
+ * names the instance it was called on.
+ *
+ *   script      → ( declaration | class )* expression
+ *   declaration → "fun" function
+ *   class       → "class" IDENTIFIER "{" function* "}"
+ *   function    → IDENTIFIER "(" parameters? ")"
+ *                 "{" "return" expression ";" "}"
+ *   assignment  → access "." IDENTIFIER "=" assignment | tertiary
+ *   tertiary    → logic_or ( "?" logic_or ":" logic_or )?
+ *   logic_or    → logic_and ( "or" logic_and )*
+ *   logic_and   → equality ( "and" equality )*
+ *   access      → primary ( "." IDENTIFIER ( "(" arguments? ")" )? )*
+ *   call        → IDENTIFIER "(" arguments? ")"
+ *   arguments   → assignment ( "," assignment )*
+ *
+ * where ',' between assignments is the comma operator everywhere else.
+ * A call names a function, or a class to make an instance of. A source
+ * that declares functions or classes parses to a Script. */
+Parser ParserInitParams(const Token tokens[], const char *const *params, size_t n_params);
 Expr *ParserParse(Parser *p);
@@ -0,0 +1,179 @@
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "perf.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+typedef struct {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} PerfEvent;
+
+#ifdef __linux__
+#define CACHE_MISS(cache) \
+    (cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const PerfEvent events[PERF_COUNTER_COUNT] = {
+    [PERF_CYCLES] = { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    [PERF_INSTRUCTIONS] = { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    [PERF_BRANCH_MISSES] = { "branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    [PERF_L1D_MISSES] = { "l1d_misses", PERF_TYPE_HW_CACHE, CACHE_MISS(PERF_COUNT_HW_CACHE_L1D) },
+    [PERF_LLC_MISSES] = { "llc_misses", PERF_TYPE_HW_CACHE, CACHE_MISS(PERF_COUNT_HW_CACHE_LL) },
+    [PERF_PAGE_FAULTS] = { "page_faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+};
+#else
+static const PerfEvent events[PERF_COUNTER_COUNT] = {
+    [PERF_CYCLES] = { "cycles" },
+    [PERF_INSTRUCTIONS] = { "instructions" },
+    [PERF_BRANCH_MISSES] = { "branch_misses" },
+    [PERF_L1D_MISSES] = { "l1d_misses" },
+    [PERF_LLC_MISSES] = { "llc_misses" },
+    [PERF_PAGE_FAULTS] = { "page_faults" },
+};
+#endif
+
+/* ---- HELPER FUNCTIONS ---- */
+
+static uint64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int openCounter(const PerfEvent *event) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = event->type;
+    attr.config = event->config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    int fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    return fd < 0 ? -1 : fd;
+#else
+    (void)event;
+    return -1;
+#endif
+}
+
+static uint64_t readCounter(int fd) {
+    uint64_t values[3];
+
+    if (fd < 0 || read(fd, values, sizeof(values)) != sizeof(values))
+        return 0;
+
+    if (values[2] == 0)
+        return 0;
+    if (values[2] == values[1])
+        return values[0];
+
+    return (uint64_t)((double)values[0] * values[1] / values[2]);
+}
+
+static void printPerInstruction(const PerfCounters *c, const PerfSample *s, PerfCounter counter, FILE *f) {
+    if (!PerfAvailable(c, counter) || !PerfAvailable(c, PERF_INSTRUCTIONS) ||
+        s->counts[PERF_INSTRUCTIONS] == 0)
+        fprintf(f, " %10s", "n/a");
+    else
+        fprintf(f, " %10.2f", 1000.0 * s->counts[counter] / s->counts[PERF_INSTRUCTIONS]);
+}
+
+/* ---- MAIN METHODS ---- */
+
+PerfCounters PerfCountersInit(void) {
+    PerfCounters retval;
+
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+        retval.fds[i] = openCounter(&events[i]);
+
+    return retval;
+}
+
+void PerfCountersFini(PerfCounters *c) {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (c->fds[i] >= 0)
+            close(c->fds[i]);
+        c->fds[i] = -1;
+    }
+}
+
+bool PerfAvailable(const PerfCounters *c, PerfCounter counter) {
+    return c->fds[counter] >= 0;
+}
+
+const char *PerfCounterName(PerfCounter counter) {
+    return events[counter].name;
+}
+
+void PerfRead(const PerfCounters *c, PerfSample *out) {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+        out->counts[i] = readCounter(c->fds[i]);
+
+    out->ns = nowNs();
+}
+
+void PerfAccumulate(PerfSample *total, const PerfSample *start, const PerfSample *end) {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+        total->counts[i] += end->counts[i] - start->counts[i];
+
+    total->ns += end->ns - start->ns;
+}
+
+void PerfPrintTable(const PerfCounters *c, const char *const *names,
+                    const PerfSample *samples, size_t n, FILE *f) {
+    fprintf(f, "%-10s %10s %14s %14s %6s %10s %10s %10s %12s\n", "phase", "wall ms",
+            "cycles", "instructions", "IPC", "br-miss/k", "l1d-miss/k", "llc-miss/k", "page-faults");
+
+    for (size_t i = 0; i < n; i++) {
+        const PerfSample *s = &samples[i];
+
+        fprintf(f, "%-10s %10.3f", names[i], s->ns / 1e6);
+
+        for (int k = PERF_CYCLES; k <= PERF_INSTRUCTIONS; k++) {
+            if (PerfAvailable(c, k))
+                fprintf(f, " %14llu", (unsigned long long)s->counts[k]);
+            else
+                fprintf(f, " %14s", "n/a");
+        }
+
+        if (PerfAvailable(c, PERF_CYCLES) && PerfAvailable(c, PERF_INSTRUCTIONS) &&
+            s->counts[PERF_CYCLES] > 0)
+            fprintf(f, " %6.2f", (double)s->counts[PERF_INSTRUCTIONS] / s->counts[PERF_CYCLES]);
+        else
+            fprintf(f, " %6s", "n/a");
+
+        printPerInstruction(c, s, PERF_BRANCH_MISSES, f);
+        printPerInstruction(c, s, PERF_L1D_MISSES, f);
+        printPerInstruction(c, s, PERF_LLC_MISSES, f);
+
+        if (PerfAvailable(c, PERF_PAGE_FAULTS))
+            fprintf(f, " %12llu\n", (unsigned long long)s->counts[PERF_PAGE_FAULTS]);
+        else
+            fprintf(f, " %12s\n", "n/a");
+    }
+}
+
+void PerfWriteJson(const PerfCounters *c, const PerfSample *sample, double ops, FILE *f) {
+    fputc('{', f);
+
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        fprintf(f, "%s\"%s\": ", i > 0 ? ", " : " ", events[i].name);
+
+        if (PerfAvailable(c, i))
+            fprintf(f, "%.4f", sample->counts[i] / ops);
+        else
+            fputs("null", f);
+    }
+
+    fputs(" }", f);
+}
@@ -0,0 +1,58 @@
+#ifndef PERF_H_
+#define PERF_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_PAGE_FAULTS,
+    PERF_COUNTER_COUNT
+} PerfCounter;
+
+typedef struct {
+    uint64_t ns;
+    uint64_t counts[PERF_COUNTER_COUNT];
+} PerfSample;
+
+/*
+ * Hardware and software counters for this thread, through Linux's
+ * perf_event_open. Each counter is opened on its own, so that a machine
+ * or container which refuses some of them (or all of them, as most VMs
+ * do) still gets the rest; fds holds -1 for those. Counters are user space
+ * only, which perf_event_paranoid allows up to level 2.
+ *
+ * Counts are scaled by enabled / running time in case the kernel had to
+ * multiplex them.
+ */
+typedef struct {
+    int fds[PERF_COUNTER_COUNT];
+} PerfCounters;
+
+PerfCounters PerfCountersInit(void);
+void PerfCountersFini(PerfCounters *c);
+
+bool PerfAvailable(const PerfCounters *c, PerfCounter counter);
+const char *PerfCounterName(PerfCounter counter);
+
+/* A snapshot of every counter plus the monotonic clock. */
+void PerfRead(const PerfCounters *c, PerfSample *out);
+
+/* total += end - start */
+void PerfAccumulate(PerfSample *total, const PerfSample *start, const PerfSample *end);
+
+/* One row per sample with IPC and misses per thousand instructions;
+ * counters that could not be opened print as n/a. */
+void PerfPrintTable(const PerfCounters *c, const char *const *names,
+                    const PerfSample *samples, size_t n, FILE *f);
+
+/* The counters of sample divided by ops as a JSON object, with null for
+ * the unavailable ones. */
+void PerfWriteJson(const PerfCounters *c, const PerfSample *sample, double ops, FILE *f);
+
+#endif
@@ -0,0 +1,157 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "pool.h"
+
+struct PoolSlab {
+    PoolSlab *next;
+};
+
+/* The slab header is padded so the first chunk starts on a fresh line. */
+#define SLAB_HEADER_SIZE POOL_CACHE_LINE
+
+static _Thread_local PoolArena local;
+static _Thread_local PoolArena *current = NULL;
+
+/* ---- HELPER FUNCTIONS ---- */
+
+static inline PoolClass *classes(void) {
+    return current != NULL ? current->classes : local.classes;
+}
+
+static inline size_t classIndex(size_t size) {
+    return (size + POOL_GRANULE - 1) / POOL_GRANULE - 1;
+}
+
+static inline size_t classSize(size_t i) {
+    return (i + 1) * POOL_GRANULE;
+}
+
+static inline size_t chunksPerSlab(size_t i) {
+    return (POOL_SLAB_SIZE - SLAB_HEADER_SIZE) / classSize(i);
+}
+
+static void *grow(PoolClass *c, size_t i) {
+    PoolSlab *slab = aligned_alloc(POOL_CACHE_LINE, POOL_SLAB_SIZE);
+    if (slab == NULL)
+        return NULL;
+
+    slab->next = c->slabs;
+    c->slabs = slab;
+    c->n_slabs++;
+
+    c->bump = (char*)slab + SLAB_HEADER_SIZE;
+    c->end = c->bump + chunksPerSlab(i) * classSize(i);
+
+    void *retval = c->bump;
+    c->bump += classSize(i);
+    return retval;
+}
+
+/* ---- MAIN METHODS ---- */
+
+void *PoolAlloc(size_t size) {
+    if (size == 0 || size > POOL_MAX_SIZE)
+        return malloc(size);
+
+    size_t i = classIndex(size);
+    PoolClass *c = &classes()[i];
+    void *retval;
+
+    if (c->free != NULL) {
+        retval = c->free;
+        c->free = *(void**)retval;
+        c->free_count--;
+    } else if (c->bump < c->end) {
+        retval = c->bump;
+        c->bump += classSize(i);
+    } else if ((retval = grow(c, i)) == NULL) {
+        return NULL;
+    }
+
+    c->live++;
+    return retval;
+}
+
+void PoolFree(void *ptr, size_t size) {
+    if (ptr == NULL)
+        return;
+
+    if (size == 0 || size > POOL_MAX_SIZE) {
+        free(ptr);
+        return;
+    }
+
+    PoolClass *c = &classes()[classIndex(size)];
+    assert(c->live > 0);
+
+    *(void**)ptr = c->free;
+    c->free = ptr;
+    c->free_count++;
+    c->live--;
+}
+
+static void releaseArena(PoolClass *classes) {
+    for (size_t i = 0; i < POOL_CLASS_COUNT; i++) {
+        PoolClass *c = &classes[i];
+
+        for (PoolSlab *iter = c->slabs, *next = NULL; iter != NULL; iter = next) {
+            next = iter->next;
+            free(iter);
+        }
+
+        *c = (PoolClass){0};
+    }
+}
+
+void PoolReleaseAll(void) {
+    releaseArena(classes());
+}
+
+PoolArena *PoolArenaCreate(void) {
+    return calloc(1, sizeof(PoolArena));
+}
+
+void PoolArenaDestroy(PoolArena *arena) {
+    if (current == arena)
+        current = NULL;
+
+    releaseArena(arena->classes);
+    free(arena);
+}
+
+PoolArena *PoolArenaSwitch(PoolArena *arena) {
+    PoolArena *retval = current;
+    current = arena;
+    return retval;
+}
+
+PoolStats PoolGetStats(size_t size_class) {
+    assert(size_class < POOL_CLASS_COUNT);
+
+    const PoolClass *c = &classes()[size_class];
+    size_t capacity = c->n_slabs * chunksPerSlab(size_class);
+    size_t carved = c->live + c->free_count;
+
+    return (PoolStats){
+        .size = classSize(size_class),
+        .slabs = c->n_slabs,
+        .capacity = capacity,
+        .live = c->live,
+        .free = c->free_count,
+        .occupancy = capacity ? (double)c->live / capacity : 0.0,
+        .fragmentation = carved ? (double)c->free_count / carved : 0.0
+    };
+}
+
+void PoolPrintStats(FILE *f) {
+    for (size_t i = 0; i < POOL_CLASS_COUNT; i++) {
+        PoolStats s = PoolGetStats(i);
+
+        fprintf(f, "Pool %3zu B: %zu slabs, %zu/%zu live, %zu free, "
+                   "%.1f%% occupancy, %.1f%% fragmentation\n",
+                s.size, s.slabs, s.live, s.capacity, s.free,
+                s.occupancy * 100, s.fragmentation * 100);
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef POOL_H_
+#define POOL_H_
+
+#include <stddef.h>
+#include <stdio.h>
+
+#define POOL_CACHE_LINE 64
+#define POOL_SLAB_SIZE (16 * 1024)
+#define POOL_GRANULE 16
+#define POOL_CLASS_COUNT 5
+#define POOL_MAX_SIZE (POOL_GRANULE * POOL_CLASS_COUNT)
+
+typedef struct PoolSlab PoolSlab;
+
+/*
+ * One free list and bump region per size class. Chunks come back on the
+ * free list when released and are handed out again before the bump pointer
+ * moves on, so a class only grows a new slab once its free list is empty.
+ */
+typedef struct {
+    void *free;
+    char *bump;
+    char *end;
+    PoolSlab *slabs;
+    size_t n_slabs;
+    size_t live;
+    size_t free_count;
+} PoolClass;
+
+typedef struct {
+    PoolClass classes[POOL_CLASS_COUNT];
+} PoolArena;
+
+typedef struct {
+    size_t size;
+    size_t slabs;
+    size_t capacity;
+    size_t live;
+    size_t free;
+    double occupancy;
+    double fragmentation;
+} PoolStats;
+
+/*
+ * Small fixed-size allocations for Object and Expr nodes. Every thread has
+ * its own arena, so the fast path takes no locks; the flip side is that
+ * memory must be released into the arena it came from. Sizes above
+ * POOL_MAX_SIZE fall through to malloc.
+ */
+void *PoolAlloc(size_t size);
+void PoolFree(void *ptr, size_t size);
+
+/* Drops every slab in the current arena at once, without walking the
+ * objects in them. All pointers it handed out become invalid. */
+void PoolReleaseAll(void);
+
+/*
+ * Arenas that are not tied to a thread, for memory that outlives the
+ * thread which allocated it. Switching makes arena the one PoolAlloc and
+ * PoolFree use on this thread and returns the previous one; NULL switches
+ * back to the thread's own arena.
+ */
+PoolArena *PoolArenaCreate(void);
+void PoolArenaDestroy(PoolArena *arena);
+PoolArena *PoolArenaSwitch(PoolArena *arena);
+
+PoolStats PoolGetStats(size_t size_class);
+void PoolPrintStats(FILE *f);
+
+#endif
@@ -0,0 +1,347 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "profiler.h"
+#include "strkernel.h"
+
+/* ---- HELPER FUNCTIONS ---- */
+
+static uint64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static size_t hashPointer(const void *ptr) {
+    uintptr_t x = (uintptr_t)ptr;
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDull;
+    return x ^ (x >> 33);
+}
+
+static size_t textLen(const Expr *expr) {
+    return expr->span_len < PROFILE_TEXT_MAX ? expr->span_len : PROFILE_TEXT_MAX;
+}
+
+/* Nested nodes often start with the same text, so the length of the whole
+ * span is part of the key. */
+static bool sameNode(const ProfileNode *node, const Expr *expr) {
+    return node->line == expr->line && node->span_len == expr->span_len &&
+           strncmp(node->text, expr->span, textLen(expr)) == 0;
+}
+
+static size_t hashNode(const char *text, size_t len, int line, size_t span_len) {
+    return StrHash(text, len) ^ line ^ span_len;
+}
+
+static size_t newNode(Profiler *p, const Expr *expr) {
+    if (p->n_nodes == p->nodes_cap) {
+        p->nodes_cap *= 2;
+        p->nodes = realloc(p->nodes, p->nodes_cap * sizeof(ProfileNode));
+    }
+
+    p->nodes[p->n_nodes] = (ProfileNode){
+        .text = strndup(expr->span, textLen(expr)),
+        .line = expr->line,
+        .span_len = expr->span_len
+    };
+
+    return p->n_nodes++;
+}
+
+/* Both tables are open addressing over a power of two, kept at most half
+ * full. */
+static void growIndex(Profiler *p) {
+    size_t cap = p->index_cap * 2;
+    size_t *index = calloc(cap, sizeof(size_t));
+
+    for (size_t n = 0; n < p->n_nodes; n++) {
+        const ProfileNode *node = &p->nodes[n];
+        size_t h = hashNode(node->text, strlen(node->text), node->line, node->span_len);
+
+        for (h &= cap - 1; index[h] != 0; h = (h + 1) & (cap - 1))
+            ;
+        index[h] = n + 1;
+    }
+
+    free(p->index);
+    p->index = index;
+    p->index_cap = cap;
+}
+
+static size_t findNode(Profiler *p, const Expr *expr) {
+    if (2 * (p->n_nodes + 1) > p->index_cap)
+        growIndex(p);
+
+    size_t mask = p->index_cap - 1;
+    size_t h = hashNode(expr->span, textLen(expr), expr->line, expr->span_len) & mask;
+
+    for (; p->index[h] != 0; h = (h + 1) & mask) {
+        if (sameNode(&p->nodes[p->index[h] - 1], expr))
+            return p->index[h] - 1;
+    }
+
+    size_t retval = newNode(p, expr);
+    p->index[h] = retval + 1;
+    return retval;
+}
+
+static void growSeen(Profiler *p) {
+    size_t cap = p->seen_cap * 2;
+    const Expr **seen = calloc(cap, sizeof(Expr*));
+    size_t *seen_node = malloc(cap * sizeof(size_t));
+
+    for (size_t i = 0; i < p->seen_cap; i++) {
+        if (p->seen[i] == NULL)
+            continue;
+
+        size_t h = hashPointer(p->seen[i]) & (cap - 1);
+        while (seen[h] != NULL)
+            h = (h + 1) & (cap - 1);
+
+        seen[h] = p->seen[i];
+        seen_node[h] = p->seen_node[i];
+    }
+
+    free(p->seen);
+    free(p->seen_node);
+    p->seen = seen;
+    p->seen_node = seen_node;
+    p->seen_cap = cap;
+}
+
+static size_t lookup(Profiler *p, const Expr *expr) {
+    if (2 * (p->n_seen + 1) > p->seen_cap)
+        growSeen(p);
+
+    size_t mask = p->seen_cap - 1;
+    size_t h = hashPointer(expr) & mask;
+
+    for (; p->seen[h] != NULL; h = (h + 1) & mask) {
+        if (p->seen[h] == expr)
+            return p->seen_node[h];
+    }
+
+    p->seen[h] = expr;
+    p->seen_node[h] = findNode(p, expr);
+    p->n_seen++;
+    return p->seen_node[h];
+}
+
+static size_t childFrame(Profiler *p, size_t parent, size_t node) {
+    size_t f;
+
+    for (f = p->frames[parent].first_child; f != 0; f = p->frames[f].next_sibling) {
+        if (p->frames[f].node == node)
+            return f;
+    }
+
+    if (p->n_frames == p->frames_cap) {
+        p->frames_cap *= 2;
+        p->frames = realloc(p->frames, p->frames_cap * sizeof(ProfileFrame));
+    }
+
+    f = p->n_frames++;
+    p->frames[f] = (ProfileFrame){
+        .node = node,
+        .parent = parent,
+        .next_sibling = p->frames[parent].first_child
+    };
+    p->frames[parent].first_child = f;
+    return f;
+}
+
+static void enter(Profiler *p, const Expr *expr) {
+    size_t node = lookup(p, expr);
+    size_t parent = p->stack_len > 0 ? p->stack[p->stack_len - 1].frame : 0;
+
+    if (p->stack_len == p->stack_cap) {
+        p->stack_cap *= 2;
+        p->stack = realloc(p->stack, p->stack_cap * sizeof(ProfileActive));
+    }
+
+    p->nodes[node].count++;
+    p->stack[p->stack_len++] = (ProfileActive){
+        .frame = childFrame(p, parent, node),
+        .start_ns = nowNs()
+    };
+}
+
+static void leave(Profiler *p) {
+    ProfileActive a = p->stack[--p->stack_len];
+    uint64_t elapsed = nowNs() - a.start_ns;
+    uint64_t self = elapsed > a.child_ns ? elapsed - a.child_ns : 0;
+    ProfileNode *node = &p->nodes[p->frames[a.frame].node];
+
+    p->frames[a.frame].self_ns += self;
+    node->self_ns += self;
+    node->total_ns += elapsed;
+
+    if (p->stack_len > 0)
+        p->stack[p->stack_len - 1].child_ns += elapsed;
+}
+
+/* Keeps every entry on one line of the reports. Folded stacks are also
+ * split at ';'. */
+static void writeText(const ProfileNode *node, FILE *f) {
+    for (const char *c = node->text; *c != '\0'; c++) {
+        if (*c == '\n' || *c == '\r' || *c == '\t')
+            fputc(' ', f);
+        else
+            fputc(*c == ';' ? ',' : *c, f);
+    }
+
+    if (node->span_len > PROFILE_TEXT_MAX)
+        fputs("...", f);
+}
+
+static void writeLabel(const ProfileNode *node, FILE *f) {
+    writeText(node, f);
+    fprintf(f, " (line %d)", node->line);
+}
+
+static void writeStack(const Profiler *p, size_t frame, FILE *f) {
+    size_t parent = p->frames[frame].parent;
+
+    if (parent != 0) {
+        writeStack(p, parent, f);
+        fputc(';', f);
+    }
+
+    writeLabel(&p->nodes[p->frames[frame].node], f);
+}
+
+static const Profiler *sortProfiler;
+
+static int bySelfTime(const void *a, const void *b) {
+    uint64_t x = sortProfiler->nodes[*(const size_t*)a].self_ns;
+    uint64_t y = sortProfiler->nodes[*(const size_t*)b].self_ns;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+/* ---- ExprVisitorS ---- */
+
+#define PROFILED(visit, type)                          \
+    static void *visit(ExprVisitor *v, type *node) {   \
+        Profiler *p = (Profiler*)v;                    \
+        enter(p, (Expr*)node);                         \
+        void *retval = p->inner.visit(v, node);        \
+        leave(p);                                      \
+        return retval;                                 \
+    }
+
+PROFILED(visitBinaryExpr, Binary)
+PROFILED(visitTertiaryExpr, Tertiary)
+PROFILED(visitLogicalExpr, Logical)
+PROFILED(visitGroupingExpr, Grouping)
+PROFILED(visitLiteralExpr, Literal)
+PROFILED(visitUnaryExpr, Unary)
+PROFILED(visitVariableExpr, Variable)
+PROFILED(visitCallExpr, Call)
+PROFILED(visitNewExpr, New)
+PROFILED(visitGetExpr, Get)
+PROFILED(visitSetExpr, Set)
+PROFILED(visitInvokeExpr, Invoke)
+PROFILED(visitScriptExpr, Script)
+
+/* ---- MAIN METHODS ---- */
+
+Profiler ProfilerInit(void) {
+    Profiler retval = {
+        .base = InterpreterInit(),
+        .nodes = malloc(64 * sizeof(ProfileNode)),
+        .nodes_cap = 64,
+        .frames = malloc(64 * sizeof(ProfileFrame)),
+        .n_frames = 1,
+        .frames_cap = 64,
+        .stack = malloc(64 * sizeof(ProfileActive)),
+        .stack_cap = 64,
+        .index = calloc(64, sizeof(size_t)),
+        .index_cap = 64,
+        .seen = calloc(64, sizeof(Expr*)),
+        .seen_node = malloc(64 * sizeof(size_t)),
+        .seen_cap = 64
+    };
+
+    retval.frames[0] = (ProfileFrame){0};
+    retval.inner = retval.base.base;
+    retval.base.base = (ExprVisitor){
+        .visitBinaryExpr = visitBinaryExpr,
+        .visitTertiaryExpr = visitTertiaryExpr,
+        .visitLogicalExpr = visitLogicalExpr,
+        .visitGroupingExpr = visitGroupingExpr,
+        .visitLiteralExpr = visitLiteralExpr,
+        .visitUnaryExpr = visitUnaryExpr,
+        .visitVariableExpr = visitVariableExpr,
+        .visitCallExpr = visitCallExpr,
+        .visitNewExpr = visitNewExpr,
+        .visitGetExpr = visitGetExpr,
+        .visitSetExpr = visitSetExpr,
+        .visitInvokeExpr = visitInvokeExpr,
+        .visitScriptExpr = visitScriptExpr
+    };
+
+    return retval;
+}
+
+void ProfilerFini(Profiler *p) {
+    for (size_t i = 0; i < p->n_nodes; i++)
+        free(p->nodes[i].text);
+
+    free(p->nodes);
+    free(p->frames);
+    free(p->stack);
+    free(p->index);
+    free(p->seen);
+    free(p->seen_node);
+    InterpreterFini(&p->base);
+}
+
+Object *ProfilerInterpret(Profiler *p, Expr *e) {
+    memset(p->seen, 0, p->seen_cap * sizeof(Expr*));
+    p->n_seen = 0;
+    p->stack_len = 0;
+
+    return InterpreterInterpret(&p->base, e);
+}
+
+void ProfilerWriteCollapsed(const Profiler *p, FILE *f) {
+    for (size_t i = 1; i < p->n_frames; i++) {
+        if (p->frames[i].self_ns == 0)
+            continue;
+
+        writeStack(p, i, f);
+        fprintf(f, " %llu\n", (unsigned long long)p->frames[i].self_ns);
+    }
+}
+
+void ProfilerWriteTop(const Profiler *p, FILE *f, size_t n) {
+    size_t *order = malloc((p->n_nodes + 1) * sizeof(size_t));
+    uint64_t total = 0;
+
+    for (size_t i = 0; i < p->n_nodes; i++) {
+        order[i] = i;
+        total += p->nodes[i].self_ns;
+    }
+
+    sortProfiler = p;
+    qsort(order, p->n_nodes, sizeof(size_t), bySelfTime);
+
+    if (n > p->n_nodes)
+        n = p->n_nodes;
+
+    fprintf(f, "%10s %10s %6s %10s %6s  %s\n", "self ms", "total ms", "self%", "count", "line", "source");
+    for (size_t i = 0; i < n; i++) {
+        const ProfileNode *node = &p->nodes[order[i]];
+
+        fprintf(f, "%10.3f %10.3f %5.1f%% %10llu %6d  ",
+                node->self_ns / 1e6, node->total_ns / 1e6,
+                total > 0 ? 100.0 * node->self_ns / total : 0.0,
+                (unsigned long long)node->count, node->line);
+        writeText(node, f);
+        fputc('\n', f);
+    }
+
+    free(order);
+}
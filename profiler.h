@@ -0,0 +1,88 @@
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "interpreter.h"
+
+/* Longest span text kept per node, in bytes. */
+#define PROFILE_TEXT_MAX 48
+
+typedef struct {
+    char *text;
+    int line;
+    size_t span_len;
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t self_ns;
+} ProfileNode;
+
+/* A node in the tree of distinct call stacks. */
+typedef struct {
+    size_t node;
+    size_t parent;
+    size_t first_child;
+    size_t next_sibling;
+    uint64_t self_ns;
+} ProfileFrame;
+
+typedef struct {
+    size_t frame;
+    uint64_t start_ns;
+    uint64_t child_ns;
+} ProfileActive;
+
+/*
+ * An interpreter that times every node it evaluates.
+ *
+ * It is an Interpreter whose visit functions are wrappers around the
+ * plain ones, which are kept in inner. Since the wrappers are what the
+ * plain visitors recurse through, every node is timed, and a run that is
+ * not profiled uses the plain Interpreter and pays nothing.
+ *
+ * Nodes are aggregated by line and source text, so the same expression
+ * entered twice at the prompt accumulates into one entry.
+ */
+typedef struct {
+    Interpreter base;
+    ExprVisitor inner;
+
+    ProfileNode *nodes;
+    size_t n_nodes;
+    size_t nodes_cap;
+
+    /* Node indices plus one, hashed by line and text. */
+    size_t *index;
+    size_t index_cap;
+
+    /* Frame 0 is the root, above every top-level expression. */
+    ProfileFrame *frames;
+    size_t n_frames;
+    size_t frames_cap;
+
+    ProfileActive *stack;
+    size_t stack_len;
+    size_t stack_cap;
+
+    /* Expr pointers to node indices, for the run in progress only, as
+     * nodes are recycled once their tree is freed. */
+    const Expr **seen;
+    size_t *seen_node;
+    size_t n_seen;
+    size_t seen_cap;
+} Profiler;
+
+Profiler ProfilerInit(void);
+void ProfilerFini(Profiler *p);
+
+Object *ProfilerInterpret(Profiler *p, Expr *e);
+
+/* One line per distinct stack, in the folded format flamegraph.pl reads,
+ * weighted by self time in nanoseconds. */
+void ProfilerWriteCollapsed(const Profiler *p, FILE *f);
+
+/* The n nodes with the most self time. */
+void ProfilerWriteTop(const Profiler *p, FILE *f, size_t n);
+
+#endif
@@ -0,0 +1,60 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "shape.h"
+#include "expr.h"
+
+/* ---- HELPER FUNCTIONS ---- */
+
+static Shape *shapeInit(Class *klass, const Shape *parent, const char *name, uint32_t n_fields) {
+    Shape *retval = malloc(sizeof(Shape));
+    *retval = (Shape){
+        .klass = klass,
+        .parent = parent,
+        .name = name,
+        .n_fields = n_fields
+    };
+
+    return retval;
+}
+
+/* ---- MAIN METHODS ---- */
+
+Shape *ShapeRoot(Class *klass) {
+    return shapeInit(klass, NULL, NULL, 0);
+}
+
+void ShapeFree(Shape *root) {
+    for (size_t i = 0; i < root->n_children; i++)
+        ShapeFree(root->children[i]);
+
+    free(root->children);
+    free(root);
+}
+
+/* Fields are found by walking back towards the root, so a miss costs one
+ * step per field. */
+long ShapeLookup(const Shape *s, const char *name) {
+    for (; s->parent != NULL; s = s->parent) {
+        if (strcmp(s->name, name) == 0)
+            return s->n_fields - 1;
+    }
+
+    return -1;
+}
+
+Shape *ShapeTransition(Shape *s, const char *name) {
+    for (size_t i = 0; i < s->n_children; i++) {
+        if (strcmp(s->children[i]->name, name) == 0)
+            return s->children[i];
+    }
+
+    Shape *child = shapeInit(s->klass, s, name, s->n_fields + 1);
+    s->children = realloc(s->children, (s->n_children + 1) * sizeof(Shape*));
+    s->children[s->n_children++] = child;
+    return child;
+}
+
+const char *ShapeClassName(const Shape *s) {
+    return s->klass->name;
+}
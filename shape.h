@@ -0,0 +1,48 @@
+#ifndef SHAPE_H_
+#define SHAPE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct Class Class;
+typedef struct Shape Shape;
+
+/*
+ * The layout shared by the instances of a class that were given the same
+ * fields in the same order. An instance only holds the values of its
+ * fields, in a flat array; which name is at which index is kept here, once
+ * for all of them.
+ *
+ * Each class has a root shape without fields. Adding a field to an
+ * instance moves it along a transition to a child shape, which is made the
+ * first time and taken every time after, so instances built alike end up
+ * on the same shape and a cache keyed by shape can remember where a field
+ * lives. klass and the field names belong to the Script the shapes were
+ * made for.
+ */
+struct Shape {
+    Class *klass;
+    const Shape *parent;
+
+    /* The field this shape adds to its parent, at index n_fields - 1. */
+    const char *name;
+    uint32_t n_fields;
+
+    Shape **children;
+    size_t n_children;
+};
+
+Shape *ShapeRoot(Class *klass);
+
+/* Frees root and every shape reached from it. */
+void ShapeFree(Shape *root);
+
+/* The index of field name in s, or -1 if s has no such field. */
+long ShapeLookup(const Shape *s, const char *name);
+
+/* The child of s that adds field name. */
+Shape *ShapeTransition(Shape *s, const char *name);
+
+const char *ShapeClassName(const Shape *s);
+
+#endif
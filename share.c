@@ -0,0 +1,343 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "share.h"
+#include "strkernel.h"
+
+#define SHARE_TABLE_MIN 64
+
+/* Compares what is particular to one kind of node; kind and type have
+ * already been found equal. */
+typedef bool (*SameFn)(const Expr *a, const Expr *b);
+
+typedef struct {
+    ExprVisitor base;
+
+    /* Every distinct node seen so far, open addressed by hash. */
+    Expr **table;
+    uint64_t *hashes;
+    size_t cap;
+    size_t len;
+
+    unsigned slots;
+    ShareStats *stats;
+
+    /* Set while in a Script that declares classes, where a call may set
+     * fields and so is not the same twice. */
+    bool effects;
+} Sharer;
+
+/* ---- HELPER FUNCTIONS ---- */
+
+static inline uint64_t mix(uint64_t h, uint64_t x) {
+    h = (h ^ x) * 0x9e3779b97f4a7c15u;
+    return h ^ (h >> 29);
+}
+
+/* Children are merged before their parents, so equal subtrees already
+ * are the same pointers and a node only hashes one level deep. */
+static inline uint64_t seed(const Expr *e) {
+    return mix((uintptr_t)e->accept, e->type);
+}
+
+static bool sameBinary(const Expr *a, const Expr *b) {
+    const Binary *x = (const Binary*)a, *y = (const Binary*)b;
+    return x->operation == y->operation && x->left == y->left && x->right == y->right;
+}
+
+static bool sameTertiary(const Expr *a, const Expr *b) {
+    const Tertiary *x = (const Tertiary*)a, *y = (const Tertiary*)b;
+    return x->condition == y->condition && x->ifTrue == y->ifTrue && x->ifFalse == y->ifFalse;
+}
+
+static bool sameLogical(const Expr *a, const Expr *b) {
+    const Logical *x = (const Logical*)a, *y = (const Logical*)b;
+    return x->operation == y->operation && x->n_operands == y->n_operands &&
+           memcmp(x->operands, y->operands, x->n_operands * sizeof(Expr*)) == 0;
+}
+
+static bool sameUnary(const Expr *a, const Expr *b) {
+    const Unary *x = (const Unary*)a, *y = (const Unary*)b;
+    return x->operation == y->operation && x->right == y->right;
+}
+
+static bool sameGrouping(const Expr *a, const Expr *b) {
+    return ((const Grouping*)a)->expr == ((const Grouping*)b)->expr;
+}
+
+/* Numbers compare by bits, so 0 and -0 stay apart and equal NaNs merge. */
+static bool sameLiteral(const Expr *a, const Expr *b) {
+    Object *x = &((Literal*)a)->object, *y = &((Literal*)b)->object;
+
+    switch (x->type) {
+    case OBJECT_NUMBER:
+        return memcmp(&x->value.f, &y->value.f, sizeof(double)) == 0;
+    case OBJECT_BOOL:
+        return x->value.b == y->value.b;
+    case OBJECT_STRING:
+        return StrEqual(ObjectStrChars(x), ObjectStrLen(x), ObjectStrChars(y), ObjectStrLen(y));
+    default:
+        return true;
+    }
+}
+
+/* The name only keeps parameters of different functions apart in print. */
+static bool sameVariable(const Expr *a, const Expr *b) {
+    const Variable *x = (const Variable*)a, *y = (const Variable*)b;
+    return x->slot == y->slot && strcmp(x->name, y->name) == 0;
+}
+
+static bool sameCall(const Expr *a, const Expr *b) {
+    const Call *x = (const Call*)a, *y = (const Call*)b;
+    return x->callee == y->callee && (x->callee->arity == 0 ||
+           memcmp(x->args, y->args, x->callee->arity * sizeof(Expr*)) == 0);
+}
+
+static void grow(Sharer *s) {
+    size_t cap = s->cap * 2;
+    Expr **table = calloc(cap, sizeof(Expr*));
+    uint64_t *hashes = malloc(cap * sizeof(uint64_t));
+
+    for (size_t i = 0; i < s->cap; i++) {
+        if (s->table[i] == NULL)
+            continue;
+
+        size_t j = s->hashes[i] & (cap - 1);
+        while (table[j] != NULL)
+            j = (j + 1) & (cap - 1);
+
+        table[j] = s->table[i];
+        hashes[j] = s->hashes[i];
+    }
+
+    free(s->table);
+    free(s->hashes);
+    s->table = table;
+    s->hashes = hashes;
+    s->cap = cap;
+}
+
+/*
+ * Gives the node equal to node that was seen first, freeing node if that
+ * is another one. cache says whether the node is worth a slot once it
+ * turns out to be shared; leaves and groupings are not.
+ */
+static Expr *intern(Sharer *s, Expr *node, uint64_t hash, SameFn same, bool cache) {
+    s->stats->nodes++;
+
+    if (2 * (s->len + 1) > s->cap)
+        grow(s);
+
+    size_t mask = s->cap - 1;
+    size_t i = hash & mask;
+
+    for (; s->table[i] != NULL; i = (i + 1) & mask) {
+        Expr *e = s->table[i];
+
+        if (e == node)
+            return e;
+        if (s->hashes[i] != hash || e->accept != node->accept || e->type != node->type ||
+            !same(e, node))
+            continue;
+
+        ExprFini(node);
+        e->shares++;
+
+        if (cache && e->slot == 0) {
+            e->slot = ++s->slots;
+            s->stats->cached++;
+        }
+
+        return e;
+    }
+
+    s->table[i] = node;
+    s->hashes[i] = hash;
+    s->len++;
+    s->stats->unique++;
+    return node;
+}
+
+/* Counts a node that is never merged, as it may see a field another one
+ * set in between, or set one itself. */
+static Expr *distinct(Sharer *s, Expr *node) {
+    s->stats->nodes++;
+    s->stats->unique++;
+    return node;
+}
+
+/* ---- ExprVisitorS ---- */
+
+static inline Expr *share(ExprVisitor *v, Expr *expr) {
+    return expr->accept(v, expr);
+}
+
+static void *visitBinaryExpr(ExprVisitor *v, Binary *b) {
+    b->left = share(v, b->left);
+    b->right = share(v, b->right);
+
+    uint64_t h = mix(mix(mix(seed(&b->base), b->operation), (uintptr_t)b->left),
+                     (uintptr_t)b->right);
+    return intern((Sharer*)v, &b->base, h, sameBinary, true);
+}
+
+static void *visitTertiaryExpr(ExprVisitor *v, Tertiary *t) {
+    t->condition = share(v, t->condition);
+    t->ifTrue = share(v, t->ifTrue);
+    t->ifFalse = share(v, t->ifFalse);
+
+    uint64_t h = mix(mix(mix(seed(&t->base), (uintptr_t)t->condition), (uintptr_t)t->ifTrue),
+                     (uintptr_t)t->ifFalse);
+    return intern((Sharer*)v, &t->base, h, sameTertiary, true);
+}
+
+static void *visitLogicalExpr(ExprVisitor *v, Logical *l) {
+    uint64_t h = mix(seed(&l->base), l->operation);
+
+    for (size_t i = 0; i < l->n_operands; i++) {
+        l->operands[i] = share(v, l->operands[i]);
+        h = mix(h, (uintptr_t)l->operands[i]);
+    }
+
+    return intern((Sharer*)v, &l->base, h, sameLogical, true);
+}
+
+static void *visitUnaryExpr(ExprVisitor *v, Unary *u) {
+    u->right = share(v, u->right);
+
+    uint64_t h = mix(mix(seed(&u->base), u->operation), (uintptr_t)u->right);
+    return intern((Sharer*)v, &u->base, h, sameUnary, true);
+}
+
+static void *visitGroupingExpr(ExprVisitor *v, Grouping *g) {
+    g->expr = share(v, g->expr);
+
+    uint64_t h = mix(seed(&g->base), (uintptr_t)g->expr);
+    return intern((Sharer*)v, &g->base, h, sameGrouping, false);
+}
+
+static void *visitLiteralExpr(ExprVisitor *v, Literal *l) {
+    Object *obj = &l->object;
+    uint64_t h = mix(seed(&l->base), obj->type);
+
+    switch (obj->type) {
+    case OBJECT_NUMBER: {
+        uint64_t bits;
+        memcpy(&bits, &obj->value.f, sizeof(bits));
+        h = mix(h, bits);
+        break;
+    }
+    case OBJECT_BOOL:
+        h = mix(h, obj->value.b);
+        break;
+    case OBJECT_STRING:
+        h = mix(h, StrHash(ObjectStrChars(obj), ObjectStrLen(obj)));
+        break;
+    default:
+        break;
+    }
+
+    return intern((Sharer*)v, &l->base, h, sameLiteral, false);
+}
+
+static void *visitVariableExpr(ExprVisitor *v, Variable *var) {
+    uint64_t h = mix(seed(&var->base), var->slot);
+    return intern((Sharer*)v, &var->base, h, sameVariable, false);
+}
+
+static void *visitCallExpr(ExprVisitor *v, Call *c) {
+    Sharer *s = (Sharer*)v;
+    uint64_t h = mix(seed(&c->base), (uintptr_t)c->callee);
+
+    for (size_t i = 0; i < c->callee->arity; i++) {
+        c->args[i] = share(v, c->args[i]);
+        h = mix(h, (uintptr_t)c->args[i]);
+    }
+
+    if (s->effects)
+        return distinct(s, &c->base);
+
+    return intern(s, &c->base, h, sameCall, true);
+}
+
+/* Every instance is a new one, so no two News are the same. */
+static void *visitNewExpr(ExprVisitor *v, New *n) {
+    size_t arity = n->klass->init != NULL ? n->klass->init->arity - 1 : 0;
+
+    for (size_t i = 0; i < arity; i++)
+        n->args[i] = share(v, n->args[i]);
+
+    return distinct((Sharer*)v, &n->base);
+}
+
+static void *visitGetExpr(ExprVisitor *v, Get *g) {
+    g->object = share(v, g->object);
+    return distinct((Sharer*)v, &g->base);
+}
+
+static void *visitSetExpr(ExprVisitor *v, Set *s) {
+    s->object = share(v, s->object);
+    s->value = share(v, s->value);
+    return distinct((Sharer*)v, &s->base);
+}
+
+static void *visitInvokeExpr(ExprVisitor *v, Invoke *i) {
+    i->object = share(v, i->object);
+
+    for (size_t k = 0; k < i->n_args; k++)
+        i->args[k] = share(v, i->args[k]);
+
+    return distinct((Sharer*)v, &i->base);
+}
+
+/* Parameters are numbered per function, but a node means the same in
+ * every frame it is evaluated in, so bodies share with each other and
+ * with the script's own expression. */
+static void *visitScriptExpr(ExprVisitor *v, Script *s) {
+    ((Sharer*)v)->effects = s->n_classes > 0;
+
+    for (size_t i = 0; i < s->n_functions; i++)
+        s->functions[i].body = share(v, s->functions[i].body);
+
+    for (size_t i = 0; i < s->n_classes; i++) {
+        Class *c = &s->classes[i];
+
+        for (size_t j = 0; j < c->n_methods; j++)
+            c->methods[j].body = share(v, c->methods[j].body);
+    }
+
+    s->body = share(v, s->body);
+    return &s->base;
+}
+
+/* ---- MAIN METHODS ---- */
+
+Expr *ExprShare(Expr *expr, ShareStats *stats) {
+    Sharer s = {
+        .base = (ExprVisitor){
+            .visitBinaryExpr = visitBinaryExpr,
+            .visitTertiaryExpr = visitTertiaryExpr,
+            .visitLogicalExpr = visitLogicalExpr,
+            .visitGroupingExpr = visitGroupingExpr,
+            .visitLiteralExpr = visitLiteralExpr,
+            .visitUnaryExpr = visitUnaryExpr,
+            .visitVariableExpr = visitVariableExpr,
+            .visitCallExpr = visitCallExpr,
+            .visitNewExpr = visitNewExpr,
+            .visitGetExpr = visitGetExpr,
+            .visitSetExpr = visitSetExpr,
+            .visitInvokeExpr = visitInvokeExpr,
+            .visitScriptExpr = visitScriptExpr
+        },
+        .table = calloc(SHARE_TABLE_MIN, sizeof(Expr*)),
+        .hashes = malloc(SHARE_TABLE_MIN * sizeof(uint64_t)),
+        .cap = SHARE_TABLE_MIN,
+        .stats = stats
+    };
+
+    Expr *retval = share(&s.base, expr);
+
+    free(s.table);
+    free(s.hashes);
+    return retval;
+}
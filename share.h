@@ -0,0 +1,27 @@
+#ifndef SHARE_H_
+#define SHARE_H_
+
+#include <stddef.h>
+
+#include "expr.h"
+
+typedef struct {
+    size_t nodes;
+    size_t unique;
+    size_t cached;
+} ShareStats;
+
+/*
+ * Hash-conses a tree into a DAG: nodes of the same kind, operation and
+ * static type over the same children, and literals of the same value, are
+ * merged into the first of them, and the rest freed. A merged node keeps
+ * the line and span of its first occurrence.
+ *
+ * Every merged node above a leaf is given a slot, so the interpreter can
+ * compute it once per evaluation, or per call inside a function body.
+ * Nothing may rewrite the tree in place afterwards. The node counts before
+ * and after, and the slots given out, are added to stats.
+ */
+Expr *ExprShare(Expr *expr, ShareStats *stats);
+
+#endif
@@ -0,0 +1,200 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "stream.h"
+#include "logging.h"
+#include "lexer.h"
+#include "parser.h"
+#include "interpreter.h"
+#include "trace.h"
+#include "optimize.h"
+
+typedef enum {
+    SCAN_CODE,
+    SCAN_STRING,
+    SCAN_LINE_COMMENT,
+    SCAN_BLOCK_COMMENT
+} ScanState;
+
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t cap;
+
+    /* Everything before scanned has been looked at, in state. */
+    size_t scanned;
+    ScanState state;
+
+    /* The line buf[0] is on. */
+    int line;
+
+    Lexer lexer;
+    TokenList tokens;
+    Interpreter interpreter;
+    Optimizer *optimizer;
+    FILE *out;
+} Stream;
+
+/* ---- HELPER FUNCTIONS ---- */
+
+/* Blank lines and lines holding only a comment are skipped. */
+static void evaluate(Stream *s, const char *source, size_t len) {
+    hadError = false;
+    s->tokens.len = 0;
+
+    LexerReset(&s->lexer, source, len);
+    s->lexer.line = s->line;
+    if (!LexerTokenizeAll(&s->lexer, &s->tokens) || s->tokens.len == 0)
+        return;
+
+    Token eof = TokenEOF;
+    eof.line = s->lexer.line;
+    TokenListPush(&s->tokens, eof);
+
+    Parser parser = ParserInit(s->tokens.tokens);
+    Expr *expr = ParserParse(&parser);
+    if (expr == NULL)
+        return;
+
+    expr = OptimizerRun(s->optimizer, expr);
+    Object *value = InterpreterInterpret(&s->interpreter, expr);
+    if (value != NULL) {
+        char *str = ObjectToString(value);
+        fprintf(s->out, "%s\n", str);
+        fflush(s->out);
+        free(str);
+    }
+
+    ExprFini(expr);
+}
+
+/*
+ * Scans the unread part of the buffer for delimiters and evaluates every
+ * expression it completes. Returns the offset of the first byte that has
+ * not been evaluated yet. A '/', or a '*' inside a comment, at the very end
+ * is left unscanned until the next chunk shows what follows it.
+ */
+static size_t scan(Stream *s) {
+    size_t start = 0;
+    size_t i = s->scanned;
+
+    for (; i < s->len; i++) {
+        char c = s->buf[i];
+        bool delimiter = false;
+
+        switch (s->state) {
+        case SCAN_CODE:
+            if (c == '"') {
+                s->state = SCAN_STRING;
+            } else if (c == '/') {
+                if (i + 1 == s->len)
+                    goto out;
+
+                if (s->buf[i + 1] == '/') {
+                    s->state = SCAN_LINE_COMMENT;
+                    i++;
+                } else if (s->buf[i + 1] == '*') {
+                    s->state = SCAN_BLOCK_COMMENT;
+                    i++;
+                }
+            } else {
+                delimiter = c == ';' || c == '\n';
+            }
+            break;
+
+        case SCAN_STRING:
+            if (c == '"')
+                s->state = SCAN_CODE;
+            break;
+
+        case SCAN_LINE_COMMENT:
+            if (c == '\n') {
+                s->state = SCAN_CODE;
+                delimiter = true;
+            }
+            break;
+
+        case SCAN_BLOCK_COMMENT:
+            if (c == '*') {
+                if (i + 1 == s->len)
+                    goto out;
+
+                if (s->buf[i + 1] == '/') {
+                    s->state = SCAN_CODE;
+                    i++;
+                }
+            }
+            break;
+        }
+
+        if (!delimiter)
+            continue;
+
+        TRACE_BEGIN("expression", NULL, s->line);
+        evaluate(s, s->buf + start, i - start);
+        TRACE_END("expression");
+
+        for (size_t j = start; j <= i; j++)
+            s->line += s->buf[j] == '\n';
+        start = i + 1;
+    }
+
+out:
+    s->scanned = i;
+    return start;
+}
+
+/* ---- MAIN METHODS ---- */
+
+int StreamRun(int fd, Optimizer *optimizer, FILE *out) {
+    Stream s = {
+        .buf = malloc(STREAM_CHUNK),
+        .cap = STREAM_CHUNK,
+        .state = SCAN_CODE,
+        .line = 1,
+        .lexer = LexerInit(NULL, 0),
+        .tokens = TokenListInit(),
+        .interpreter = InterpreterInit(),
+        .optimizer = optimizer,
+        .out = out
+    };
+    int retval = 0;
+    ssize_t n;
+
+    /* read rather than fread, so that a pipe is drained as soon as
+     * anything arrives instead of once a whole chunk has. */
+    while (true) {
+        if (s.cap - s.len < STREAM_CHUNK / 2) {
+            s.cap *= 2;
+            s.buf = realloc(s.buf, s.cap);
+        }
+
+        if ((n = read(fd, s.buf + s.len, s.cap - s.len)) <= 0)
+            break;
+        s.len += n;
+
+        size_t done = scan(&s);
+        memmove(s.buf, s.buf + done, s.len - done);
+        s.len -= done;
+        s.scanned -= done;
+
+        /* Give back what one long expression made us grow to. */
+        if (s.cap > 4 * STREAM_CHUNK && s.len < STREAM_CHUNK) {
+            s.cap = STREAM_CHUNK;
+            s.buf = realloc(s.buf, s.cap);
+        }
+    }
+
+    if (n < 0)
+        retval = -1;
+
+    evaluate(&s, s.buf, s.len);
+
+    InterpreterFini(&s.interpreter);
+    TokenListFini(&s.tokens);
+    LexerFini(&s.lexer);
+    free(s.buf);
+    return retval;
+}
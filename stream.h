@@ -0,0 +1,27 @@
+#ifndef STREAM_H_
+#define STREAM_H_
+
+#include <stdio.h>
+
+#include "optimize.h"
+
+/* Input is read this many bytes at a time. */
+#ifndef STREAM_CHUNK
+#define STREAM_CHUNK (64 * 1024)
+#endif
+
+/*
+ * Evaluates an unbounded stream of expressions separated by ';' or
+ * newlines, printing each result to out as soon as its delimiter has been
+ * read. Delimiters inside strings and comments do not count.
+ *
+ * Only the expression being read is buffered: the bytes left over after
+ * the last delimiter in a chunk, partial tokens included, are moved to the
+ * front of the buffer and completed by the next read. Memory use is thus
+ * bounded by the longest expression rather than by the length of the
+ * stream. Evaluation uses the current heap, and every expression goes
+ * through optimizer first.
+ */
+int StreamRun(int fd, Optimizer *optimizer, FILE *out);
+
+#endif
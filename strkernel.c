@@ -0,0 +1,240 @@
+#include <string.h>
+
+#include "strkernel.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define STR_KERNEL "avx2"
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define STR_KERNEL "sse2"
+#else
+#define STR_KERNEL "scalar"
+#endif
+
+/* Past this length libc's memcmp, which is vectorised and unrolled, beats
+ * the inline loops below. */
+#define STR_INLINE_MAX 64
+
+#define HASH_STRIPE 32
+#define HASH_PRIME1 0x9E3779B185EBCA87ull
+#define HASH_PRIME2 0xC2B2AE3D27D4EB4Full
+
+static const uint64_t hashKey[4] = {
+    0xBE4BA423396CFEB8ull, 0x1CAD21F72C81017Cull,
+    0xDB979083E96DD4DEull, 0x1F67B3B7A4A44072ull
+};
+
+/* ---- HELPER FUNCTIONS ---- */
+
+static inline uint64_t load64(const char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline int byteDiff(const char *a, const char *b) {
+    return (int)(unsigned char)*a - (int)(unsigned char)*b;
+}
+
+/* Every lane does acc += lo32(w ^ key) * hi32(w ^ key) + w, which maps
+ * directly onto a 32x32->64 vector multiply. */
+static inline void accumulateScalar(uint64_t acc[4], const char *p) {
+    for (int l = 0; l < 4; l++) {
+        uint64_t w = load64(p + 8 * l);
+        uint64_t k = w ^ hashKey[l];
+        acc[l] += (k & 0xFFFFFFFFu) * (k >> 32) + w;
+    }
+}
+
+static uint64_t hashFinish(const uint64_t acc[4], const char *str, size_t len, size_t i) {
+    uint64_t h = len * HASH_PRIME1;
+
+    for (int l = 0; l < 4; l++)
+        h = rotl64(h ^ (acc[l] * HASH_PRIME2), 27) * HASH_PRIME1;
+
+    for (; i + 8 <= len; i += 8)
+        h = rotl64(h ^ (load64(str + i) * HASH_PRIME2), 31) * HASH_PRIME1;
+
+    for (; i < len; i++)
+        h = rotl64(h ^ ((unsigned char)str[i] * HASH_PRIME1), 11) * HASH_PRIME2;
+
+    h ^= h >> 33;
+    h *= HASH_PRIME2;
+    h ^= h >> 29;
+    h *= HASH_PRIME1;
+    h ^= h >> 32;
+    return h;
+}
+
+/* ---- SCALAR ---- */
+
+bool StrEqualScalar(const char *a, size_t alen, const char *b, size_t blen) {
+    return alen == blen && memcmp(a, b, alen) == 0;
+}
+
+int StrCompareScalar(const char *a, size_t alen, const char *b, size_t blen) {
+    size_t n = alen < blen ? alen : blen;
+
+    for (size_t i = 0; i < n; i++) {
+        if (a[i] != b[i])
+            return byteDiff(&a[i], &b[i]);
+    }
+
+    return (alen > blen) - (alen < blen);
+}
+
+uint64_t StrHashScalar(const char *str, size_t len) {
+    uint64_t acc[4] = { hashKey[0], hashKey[1], hashKey[2], hashKey[3] };
+    size_t i = 0;
+
+    for (; i + HASH_STRIPE <= len; i += HASH_STRIPE)
+        accumulateScalar(acc, str + i);
+
+    return hashFinish(acc, str, len, i);
+}
+
+/* ---- VECTOR ---- */
+
+#if defined(__AVX2__)
+
+/* Index of the first differing byte in [0, n), or n. */
+static size_t firstDiff(const char *a, const char *b, size_t n) {
+    size_t i = 0;
+
+    for (; i + 32 <= n; i += 32) {
+        __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(b + i));
+        uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb));
+
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+        uint32_t mask = ~(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) & 0xFFFFu;
+
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+
+    for (; i < n && a[i] == b[i]; i++)
+        ;
+
+    return i;
+}
+
+uint64_t StrHash(const char *str, size_t len) {
+    const __m256i key = _mm256_loadu_si256((const __m256i*)hashKey);
+    __m256i acc = key;
+    size_t i = 0;
+
+    for (; i + HASH_STRIPE <= len; i += HASH_STRIPE) {
+        __m256i w = _mm256_loadu_si256((const __m256i*)(str + i));
+        __m256i k = _mm256_xor_si256(w, key);
+        __m256i prod = _mm256_mul_epu32(k, _mm256_srli_epi64(k, 32));
+        acc = _mm256_add_epi64(acc, _mm256_add_epi64(prod, w));
+    }
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, acc);
+    return hashFinish(lanes, str, len, i);
+}
+
+#elif defined(__SSE2__)
+
+static size_t firstDiff(const char *a, const char *b, size_t n) {
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+        uint32_t mask = ~(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) & 0xFFFFu;
+
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+
+    for (; i < n && a[i] == b[i]; i++)
+        ;
+
+    return i;
+}
+
+uint64_t StrHash(const char *str, size_t len) {
+    const __m128i key0 = _mm_loadu_si128((const __m128i*)&hashKey[0]);
+    const __m128i key1 = _mm_loadu_si128((const __m128i*)&hashKey[2]);
+    __m128i acc0 = key0;
+    __m128i acc1 = key1;
+    size_t i = 0;
+
+    for (; i + HASH_STRIPE <= len; i += HASH_STRIPE) {
+        __m128i w0 = _mm_loadu_si128((const __m128i*)(str + i));
+        __m128i w1 = _mm_loadu_si128((const __m128i*)(str + i + 16));
+        __m128i k0 = _mm_xor_si128(w0, key0);
+        __m128i k1 = _mm_xor_si128(w1, key1);
+
+        acc0 = _mm_add_epi64(acc0, _mm_add_epi64(_mm_mul_epu32(k0, _mm_srli_epi64(k0, 32)), w0));
+        acc1 = _mm_add_epi64(acc1, _mm_add_epi64(_mm_mul_epu32(k1, _mm_srli_epi64(k1, 32)), w1));
+    }
+
+    uint64_t lanes[4];
+    _mm_storeu_si128((__m128i*)&lanes[0], acc0);
+    _mm_storeu_si128((__m128i*)&lanes[2], acc1);
+    return hashFinish(lanes, str, len, i);
+}
+
+#else
+
+static size_t firstDiff(const char *a, const char *b, size_t n) {
+    size_t i = 0;
+
+    for (; i < n && a[i] == b[i]; i++)
+        ;
+
+    return i;
+}
+
+uint64_t StrHash(const char *str, size_t len) {
+    return StrHashScalar(str, len);
+}
+
+#endif
+
+/* ---- MAIN METHODS ---- */
+
+bool StrEqual(const char *a, size_t alen, const char *b, size_t blen) {
+    if (alen != blen)
+        return false;
+
+    if (alen > STR_INLINE_MAX)
+        return memcmp(a, b, alen) == 0;
+
+    return firstDiff(a, b, alen) == alen;
+}
+
+int StrCompare(const char *a, size_t alen, const char *b, size_t blen) {
+    size_t n = alen < blen ? alen : blen;
+
+    if (n > STR_INLINE_MAX) {
+        int order = memcmp(a, b, n);
+        if (order != 0)
+            return order;
+    } else {
+        size_t i = firstDiff(a, b, n);
+        if (i < n)
+            return byteDiff(&a[i], &b[i]);
+    }
+
+    return (alen > blen) - (alen < blen);
+}
+
+const char *StrKernelName(void) {
+    return STR_KERNEL;
+}
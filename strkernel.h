@@ -0,0 +1,29 @@
+#ifndef STRKERNEL_H_
+#define STRKERNEL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Byte-string primitives used by the interpreter. The vector paths are
+ * picked at compile time (AVX2 when built with -mavx2, SSE2 on any x86-64)
+ * and fall back to the *Scalar versions elsewhere. Both give the same
+ * results, hashes included. Long equality and ordering checks go to memcmp,
+ * which lox_bench shows is faster there than a hand-written loop.
+ */
+
+bool StrEqual(const char *a, size_t alen, const char *b, size_t blen);
+
+/* Lexicographic by unsigned byte, shorter first on a common prefix. */
+int StrCompare(const char *a, size_t alen, const char *b, size_t blen);
+
+uint64_t StrHash(const char *str, size_t len);
+
+bool StrEqualScalar(const char *a, size_t alen, const char *b, size_t blen);
+int StrCompareScalar(const char *a, size_t alen, const char *b, size_t blen);
+uint64_t StrHashScalar(const char *str, size_t len);
+
+const char *StrKernelName(void);
+
+#endif
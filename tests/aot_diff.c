@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aot.h"
+#include "csv.h"
+#include "heap.h"
+#include "lexer.h"
+#include "logging.h"
+#include "optimize.h"
+#include "parser.h"
+
+/*
+ * Modules built by AotCompile against InterpreterInterpret, on random
+ * expressions over parameters, each bound both to the kinds the module
+ * guesses from use and to others, so that both of the versions it holds
+ * run. Values and errors must be the same. Needs cc, or $CC.
+ */
+
+#define ROUNDS 100
+#define MODULE "aot_test.so"
+
+static const char *names[] = { "a", "b", "p", "q", "s" };
+#define N_NAMES (sizeof(names) / sizeof(*names))
+
+static const char *leaves[] = {
+    "0", "1", "-0", "0.5", "3", "(1/0)", "(0/0)", "true", "false", "\"ab\"", "\"\"",
+    "a", "b", "p", "q", "s", "a", "b", "p", "q"
+};
+
+static const char *binaries[] = {
+    "+", "-", "*", "/", "<", "<=", ">", ">=", "==", "!=", ",", "and", "or"
+};
+
+#define COUNT(array) (sizeof(array) / sizeof(*array))
+
+static int failed = 0;
+
+static void append(char *buf, size_t size, const char *str) {
+    size_t len = strlen(buf);
+    snprintf(buf + len, size - len, "%s", str);
+}
+
+static void generate(char *buf, size_t size, int depth) {
+    int kind = depth == 0 ? 0 : rand() % 6;
+
+    switch (kind) {
+    case 0:
+        append(buf, size, leaves[rand() % COUNT(leaves)]);
+        break;
+    case 1:
+        append(buf, size, rand() % 2 ? "-" : "!");
+        generate(buf, size, depth - 1);
+        break;
+    case 2:
+        append(buf, size, "(");
+        generate(buf, size, depth - 1);
+        append(buf, size, " ? ");
+        generate(buf, size, depth - 1);
+        append(buf, size, " : ");
+        generate(buf, size, depth - 1);
+        append(buf, size, ")");
+        break;
+    default:
+        append(buf, size, "(");
+        generate(buf, size, depth - 1);
+        append(buf, size, " ");
+        append(buf, size, binaries[rand() % COUNT(binaries)]);
+        append(buf, size, " ");
+        generate(buf, size, depth - 1);
+        append(buf, size, ")");
+        break;
+    }
+}
+
+/* NULL, quietly, for what the type checker rejects. */
+static Expr *parse(const char *source) {
+    TokenList tokens = TokenListInit();
+    Expr *retval = NULL;
+    char error[256];
+
+    reportCapture(error, sizeof(error));
+    if (LexerTokenize(source, strlen(source), &tokens)) {
+        TokenListPush(&tokens, TokenEOF);
+
+        Parser parser = ParserInitParams(tokens.tokens, names, N_NAMES);
+        retval = ParserParse(&parser);
+    }
+    TokenListFini(&tokens);
+    reportCapture(NULL, 0);
+
+    if (retval != NULL) {
+        Optimizer optimizer = OptimizerInit(2);
+        optimizer.keep_tree = true;
+        retval = OptimizerRun(&optimizer, retval);
+    }
+
+    hadError = false;
+    return retval;
+}
+
+/* The value, or the error, as text. */
+static char *result(Object *value, const char *error) {
+    return value != NULL ? ObjectToString(value) : strdup(error);
+}
+
+static void compare(const char *source, Expr *expr, AotModule *m, const Object *args, size_t n) {
+    char expected_error[256] = "", error[256] = "";
+    Interpreter interpreter = InterpreterInit();
+    InterpreterBind(&interpreter, args, n);
+
+    reportCapture(expected_error, sizeof(expected_error));
+    char *expected = result(InterpreterInterpret(&interpreter, expr), expected_error);
+    reportCapture(error, sizeof(error));
+    char *actual = result(AotRun(m, &interpreter), error);
+    reportCapture(NULL, 0);
+    hadError = false;
+
+    if (strcmp(expected, actual) != 0) {
+        printf("%s\n  interpreted: %s\n  compiled: %s\n", source, expected, actual);
+        failed++;
+    }
+
+    free(expected);
+    free(actual);
+    InterpreterFini(&interpreter);
+}
+
+static size_t differential(void) {
+    double numbers[] = { 0.0, -0.0, 1.5, -3, 1.0 / 0.0, 0.0 / 0.0 };
+    size_t built = 0;
+
+    for (int round = 0; round < ROUNDS; round++) {
+        char source[4096] = "";
+        generate(source, sizeof(source), 1 + rand() % 4);
+
+        Expr *expr = parse(source);
+        if (expr == NULL)
+            continue;
+
+        AotModule *m = AotCompile(expr, round, MODULE);
+        if (m == NULL) {
+            printf("%s: did not build\n", source);
+            failed++;
+            ExprFini(expr);
+            continue;
+        }
+        built++;
+
+        for (size_t k = 0; k < COUNT(numbers); k++) {
+            Object args[N_NAMES] = {
+                ObjectConstNum(numbers[k]),
+                ObjectConstNum(numbers[(k + 2) % COUNT(numbers)]),
+                ObjectConstBool(k & 1),
+                ObjectConstBool(k & 2),
+                ObjectConstStr("qq", 2)
+            };
+            compare(source, expr, m, args, N_NAMES);
+
+            /* Every parameter of the other kind, then some left unbound. */
+            Object swapped[N_NAMES] = { args[2], args[4], args[0], args[1], args[3] };
+            compare(source, expr, m, swapped, N_NAMES);
+            compare(source, expr, m, args, k % 3);
+        }
+
+        AotUnload(m);
+        ExprFini(expr);
+    }
+
+    return built;
+}
+
+static char *run(const char *aot) {
+    char *buf = NULL;
+    size_t len;
+    FILE *out = open_memstream(&buf, &len);
+
+    if (CsvRun("aot_test.csv", "aot_test.lox", 2, aot, out) != 0)
+        fputs("error\n", out);
+
+    fclose(out);
+    return buf;
+}
+
+/* The CSV front end runs a module a row at a time, with the columns as its
+ * parameters, and prints what the columns do. */
+static void rows(void) {
+    FILE *f = fopen("aot_test.csv", "w");
+    fputs("a,b,p\n1,2,true\n3,4,false\n0,0,true\n-1,0.5,false\n", f);
+    fclose(f);
+
+    f = fopen("aot_test.lox", "w");
+    fputs("p ? a / b : a - b * 2", f);
+    fclose(f);
+
+    char *columns = run(NULL), *built = run(MODULE), *loaded = run(MODULE);
+    if (strcmp(columns, built) != 0 || strcmp(columns, loaded) != 0) {
+        printf("columns:\n%sbuilt:\n%sloaded:\n%s", columns, built, loaded);
+        failed++;
+    }
+
+    free(columns);
+    free(built);
+    free(loaded);
+    remove("aot_test.csv");
+    remove("aot_test.lox");
+}
+
+int main(void) {
+    Heap heap = HeapInit(HEAP_NURSERY_SIZE);
+    HeapSetCurrent(&heap);
+    srand(45);
+
+    size_t built = differential();
+    if (built < ROUNDS / 5) {
+        printf("only %zu of %d expressions built\n", built, ROUNDS);
+        failed++;
+    }
+
+    rows();
+
+    remove(MODULE);
+    HeapFini(&heap);
+    return failed != 0;
+}
@@ -0,0 +1,144 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lox.h"
+
+/*
+ * Each thread keeps the interpreters it evaluates with from one lox_eval
+ * to the next. Nothing one evaluation leaves behind may change another:
+ * not the caches of a different handle with the same field names laid out
+ * in another order, nor a call stack abandoned by an error. A string
+ * result passed straight back in is bound where it is in the heap, and has
+ * to stay there for as long as the evaluation runs.
+ */
+
+#define HANDLES 16
+#define ROUNDS 40
+#define THREADS 4
+
+static lox_handle *handles[HANDLES];
+static int failed = 0;
+
+/* More handles than a thread keeps interpreters, so some share one. */
+static void compileAll(void) {
+    for (int k = 0; k < HANDLES; k++) {
+        char source[256];
+        const char *fields = k % 2 ? "this.y = %d, this.x = 0" : "this.x = 0, this.y = %d";
+        char init[64];
+        snprintf(init, sizeof(init), fields, k);
+        snprintf(source, sizeof(source),
+                 "class P { init() { return this.f%d = 0, %s; } v() { return %d; } } "
+                 "fun get(o) { return o.y + o.v(); } get(P()) + %d",
+                 k, init, k, k);
+        handles[k] = lox_compile(source);
+    }
+}
+
+static void freeAll(void) {
+    for (int k = 0; k < HANDLES; k++)
+        lox_free(handles[k]);
+}
+
+static int evalAll(void) {
+    int retval = 0;
+
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int k = 0; k < HANDLES; k++) {
+            lox_value v = lox_eval(handles[k]);
+            if (v.type != LOX_NUMBER || v.as.number != 3 * k) {
+                printf("handle %d, round %d: %s\n", k, round, lox_last_error());
+                retval++;
+            }
+        }
+    }
+
+    return retval;
+}
+
+static void *worker(void *arg) {
+    int *errors = arg;
+    *errors = evalAll();
+    return NULL;
+}
+
+static void overflow(void) {
+    const char *params[] = { "n" };
+    lox_handle *h = lox_compile_params(
+        "fun f(n) { return n == 0 ? 0 : 1 + f(n - 1); } f(n)", params, 1);
+
+    lox_value deep = { .type = LOX_NUMBER, .as.number = 100000 };
+    lox_value shallow = { .type = LOX_NUMBER, .as.number = 10 };
+
+    for (int round = 0; round < ROUNDS; round++) {
+        lox_value v = lox_eval_args(h, &deep);
+        if (v.type != LOX_ERROR || strstr(lox_last_error(), "Stack overflow") == NULL) {
+            printf("round %d: did not overflow\n", round);
+            failed++;
+        }
+
+        v = lox_eval_args(h, &shallow);
+        if (v.type != LOX_NUMBER || v.as.number != 10) {
+            printf("round %d: after an overflow, %s\n", round, lox_last_error());
+            failed++;
+        }
+    }
+
+    lox_free(h);
+}
+
+static void feedsBack(void) {
+    const char *params[] = { "s" };
+    /* Enough garbage in between for a collection in a small nursery. */
+    lox_handle *twice = lox_compile_params(
+        "(s * 2, s * 2, s * 2, s * 2, s * 2, s * 2, s * 2, s * 2, s * 2, s) + s", params, 1);
+    lox_handle *same = lox_compile_params("s", params, 1);
+    const char *piece = "0123456789abcdefghij";
+    lox_value v = { .type = LOX_STRING, .as.string = { piece, 20 } };
+    size_t len = 20;
+
+    for (int round = 0; round < 12; round++) {
+        bool doubles = round % 3 != 2;
+        v = lox_eval_args(doubles ? twice : same, &v);
+        len *= doubles ? 2 : 1;
+
+        bool same_chars = v.type == LOX_STRING && v.as.string.len == len;
+        for (size_t k = 0; same_chars && k < len; k += 20)
+            same_chars = memcmp(v.as.string.chars + k, piece, 20) == 0;
+        if (!same_chars) {
+            printf("round %d: fed back, %s\n", round, lox_last_error());
+            failed++;
+            break;
+        }
+    }
+
+    lox_free(twice);
+    lox_free(same);
+}
+
+int main(void) {
+    lox_set_tier_threshold(ROUNDS / 2);
+
+    compileAll();
+    failed += evalAll();
+
+    pthread_t threads[THREADS];
+    int errors[THREADS];
+    for (int t = 0; t < THREADS; t++)
+        pthread_create(&threads[t], NULL, worker, &errors[t]);
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+        failed += errors[t];
+    }
+
+    /* New trees may land where freed ones were. */
+    freeAll();
+    compileAll();
+    failed += evalAll();
+    freeAll();
+
+    overflow();
+    feedsBack();
+
+    return failed != 0;
+}
@@ -0,0 +1,53 @@
+#include "expect.h"
+
+/*
+ * Calls against known results: arguments evaluated in order into frames
+ * of differing arities, recursion through them, and the limits on how
+ * deep calls go, which fail with an error however deep the stack is.
+ */
+
+int main(void) {
+    expects("fun add(a, b) { return a + b; } add(1, 2)", "3");
+    expects("fun sub(a, b) { return a - b; } sub(sub(10, 3), sub(4, 1))", "4");
+    expects("fun three(a, b, c) { return a * 100 + b * 10 + c; } "
+            "fun one(x) { return three(x, x + 1, x + 2); } one(1) + three(4, 5, 6)", "579");
+    expects("fun none() { return 7; } fun twice(x) { return x + x; } twice(none())", "14");
+
+    /* Recursion, including through functions declared further on. */
+    expects("fun fib(n) { return n < 2 ? n : fib(n - 1) + fib(n - 2); } fib(20)", "6765");
+    expects("fun even(n) { return n == 0 ? true : odd(n - 1); } "
+            "fun odd(n) { return n == 0 ? false : even(n - 1); } even(101)", "false");
+    expects("fun r(n, s) { return n == 0 ? s : r(n - 1, s + \"ab\"); } r(5, \"\")",
+            "ababababab");
+
+    /* A parameter handed back is the argument, whatever it is. */
+    expects("fun id(s) { return s; } id(\"a string too long to be stored inline\") + \"!\"",
+            "a string too long to be stored inline!");
+    expects("fun first(a, b) { return a; } first(true, 1)", "true");
+
+    /* Every call to d takes a frame, the outermost included. */
+    expects("fun d(n) { return n == 0 ? 0 : 1 + d(n - 1); } d(1023)", "1023");
+    expects("fun d(n) { return n == 0 ? 0 : 1 + d(n - 1); } d(1024)",
+            "[ERROR @ line 1] Stack overflow.");
+    expects("fun d(n) { return n == 0 ? 0 : 1 + d(n - 1); } d(1023) + d(1023)", "2046");
+    expects("fun d(n) { return n == 0 ? 0 : 1 + d(n - 1); } fun f() { return d(1023); } f()",
+            "[ERROR @ line 1] Stack overflow.");
+
+    /* A call whose arguments are still being evaluated holds its frame. */
+    expects("fun d(n) { return n == 0 ? 0 : 1 + d(n - 1); } "
+            "fun add(a, b) { return a + b; } add(d(1022), d(2))", "1024");
+    expects("fun d(n) { return n == 0 ? 0 : 1 + d(n - 1); } "
+            "fun add(a, b) { return a + b; } add(d(1023), d(2))",
+            "[ERROR @ line 1] Stack overflow.");
+
+    /* Errors come from where they happen, however deep. */
+    expects("fun f(n) { return n == 0 ? -\"x\" : f(n - 1); } f(10)",
+            "[ERROR @ line 1] unary '-' expects a number.");
+    expects("fun d(n) {\n  return n == 0 ? 0 : 1 + d(n - 1);\n}\nd(5000)",
+            "[ERROR @ line 2] Stack overflow.");
+    expects("fun f(a, b) { return a; } f(1)",
+            "[ERROR @ line 1] At 'f': Expected 2 arguments but got 1.");
+    expects("f(1)", "[ERROR @ line 1] At 'f': Undefined function.");
+
+    return failed != 0;
+}
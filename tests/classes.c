@@ -0,0 +1,85 @@
+#include "expect.h"
+
+/*
+ * Classes against known results. The sites here see instances whose
+ * fields were added in different orders, classes that keep a field at
+ * different indices, and more receivers than a cache has ways, so that
+ * every cache state is taken and left again: empty, hit, missed,
+ * transitioned and megamorphic.
+ */
+
+int main(void) {
+    expects("class P { init(x) { return this.x = x; } get() { return this.x; } } P(3).get()",
+            "3");
+    expects("class C { init() { return this.n = 0; } } "
+            "fun bump(o) { return (o.n = o.n + 1, o); } bump(bump(bump(C()))).n", "3");
+    expects("class W { init() { return (this.a = 1, this.b = 2, this.c = 3, this.d = 4, "
+            "this.e = 5, this.f = 6); } } "
+            "fun s(o) { return o.a + o.b + o.c + o.d + o.e + o.f; } s(W())", "21");
+
+    /* One class, fields added in either order: two shapes at each site. */
+    expects("class P { init(k) { return k ? (this.a = 1, this.b = 2) : (this.b = 20, this.a = 10); } } "
+            "fun sum(o) { return o.a * 100 + o.b; } sum(P(true)) + sum(P(false)) + sum(P(true))",
+            "1224");
+
+    /* Two classes with x at different indices, through one site. */
+    expects("class A { init() { return (this.x = 1, this.y = 2); } } "
+            "class B { init() { return (this.y = 3, this.x = 4); } } "
+            "fun gx(o) { return o.x; } gx(A()) * 10 + gx(B()) + gx(A()) * 100", "114");
+
+    /* A store that adds a field to one shape and overwrites it in another. */
+    expects("class A { init() { return this.v = 1; } } class B { init() { return this.w = 1; } } "
+            "fun set(o) { return (o.v = 5, o); } fun get(o) { return o.v; } "
+            "get(set(A())) + get(set(B())) * 10 + get(set(A())) * 100", "555");
+
+    /* Methods are found by class, whatever fields an instance has. */
+    expects("class A { m() { return 1; } } class B { m() { return 2; } } "
+            "fun call(o) { return o.m(); } call(A()) + call(B()) * 10 + call(A()) * 100", "121");
+    expects("class A { init(k) { return k ? (this.p = 1) : (this.q = 1); } m(n) { return n + 1; } } "
+            "fun call(o) { return o.m(1); } call(A(true)) + call(A(false))", "4");
+
+    /* Six receivers through a site with four ways, twice over, each
+     * keeping what the site looks up at an index of its own. */
+    expects("class A { init() { return this.v = 1; } } "
+            "class B { init() { return (this.a = 0, this.v = 2); } } "
+            "class C { init() { return (this.a = 0, this.b = 0, this.v = 3); } } "
+            "class D { init() { return (this.a = 0, this.b = 0, this.c = 0, this.v = 4); } } "
+            "class E { init() { return (this.a = 0, this.b = 0, this.c = 0, this.d = 0, "
+            "this.v = 5); } } "
+            "class F { init() { return (this.a = 0, this.b = 0, this.c = 0, this.d = 0, "
+            "this.e = 0, this.v = 6); } } "
+            "fun v(o) { return o.v; } "
+            "fun all(n) { return v(A()) + v(B()) + v(C()) + v(D()) + v(E()) + v(F()) + n; } "
+            "all(all(0))", "42");
+    expects("class A { m() { return 1; } } "
+            "class B { a() { return 0; } m() { return 2; } } "
+            "class C { a() { return 0; } b() { return 0; } m() { return 3; } } "
+            "class D { a() { return 0; } b() { return 0; } c() { return 0; } m() { return 4; } } "
+            "class E { a() { return 0; } b() { return 0; } c() { return 0; } d() { return 0; } "
+            "m() { return 5; } } "
+            "class F { a() { return 0; } b() { return 0; } c() { return 0; } d() { return 0; } "
+            "e() { return 0; } m() { return 6; } } "
+            "fun m(o) { return o.m(); } "
+            "fun all(n) { return m(A()) + m(B()) + m(C()) + m(D()) + m(E()) + m(F()) + n; } "
+            "all(all(0))", "42");
+
+    /* Instances linked through their fields. */
+    expects("class N { init(v, next) { return (this.v = v, this.next = next); } } "
+            "fun total(n) { return n == nil ? 0 : n.v + total(n.next); } "
+            "total(N(1, N(2, N(3, nil))))", "6");
+
+    /* A miss after hits fails the same as one on an empty cache. */
+    expects("class A { init() { return this.x = 1; } } class B { init() { return this.y = 1; } } "
+            "fun gx(o) { return o.x; } gx(A()) + gx(A()) + gx(B())",
+            "[ERROR @ line 1] Undefined property 'x'.");
+    expects("class A { m() { return 1; } } class B { n() { return 1; } } "
+            "fun call(o) { return o.m(); } call(A()) + call(B())",
+            "[ERROR @ line 1] Undefined method 'm'.");
+    expects("class A { m(x) { return x; } } fun call(o) { return o.m(); } call(A())",
+            "[ERROR @ line 1] Expected 1 arguments but got 0.");
+    expects("fun get(o) { return o.x; } get(1)",
+            "[ERROR @ line 1] Only instances have properties.");
+    expects("class A { } A()", "[ERROR @ line 1] An instance cannot be returned to the host.");
+
+    return failed != 0;
+}
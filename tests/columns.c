@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "lox.h"
+
+/*
+ * lox_eval_columns against lox_eval_args, row by row. A handle keeps a
+ * program for each of its trees and each set of column types it is given,
+ * and must not run one compiled for other types. Columns of anything but
+ * numbers and booleans are turned away before the expression is looked at.
+ */
+
+#define ROWS 3000
+
+static int failed = 0;
+
+static double xs[ROWS], ys[ROWS], out[ROWS];
+static bool bs[ROWS];
+
+static void rejects(lox_type type) {
+    const char *params[] = { "x" };
+    lox_handle *h = lox_compile_params("x", params, 1);
+    lox_column input = { .type = type, .as.number = xs };
+    lox_column result = { .as.number = out };
+
+    if (lox_eval_columns(h, &input, ROWS, &result) ||
+        strstr(lox_last_error(), "neither numbers nor booleans") == NULL) {
+        printf("a column of type %d: evaluated, or failed with \"%s\"\n", type, lox_last_error());
+        failed++;
+    }
+
+    lox_free(h);
+}
+
+static void matches(lox_handle *h, const char *source, lox_type x_type) {
+    lox_column inputs[] = {
+        { .type = x_type, .as.number = xs },
+        { .type = LOX_NUMBER, .as.number = ys }
+    };
+    lox_column result = { .as.number = out };
+
+    if (x_type == LOX_BOOL)
+        inputs[0].as.boolean = bs;
+
+    if (!lox_eval_columns(h, inputs, ROWS, &result)) {
+        printf("'%s': %s\n", source, lox_last_error());
+        failed++;
+        return;
+    }
+
+    for (size_t row = 0; row < ROWS; row++) {
+        lox_value args[] = {
+            { .type = x_type },
+            { .type = LOX_NUMBER, .as.number = ys[row] }
+        };
+        if (x_type == LOX_BOOL)
+            args[0].as.boolean = bs[row];
+        else
+            args[0].as.number = xs[row];
+
+        lox_value v = lox_eval_args(h, args);
+        bool same = v.type == result.type &&
+                    (v.type == LOX_BOOL ? v.as.boolean == ((bool*)out)[row]
+                                        : v.as.number == out[row]);
+        if (!same) {
+            printf("'%s': row %zu differs\n", source, row);
+            failed++;
+            break;
+        }
+    }
+}
+
+static void compares(const char *source, lox_type x_type) {
+    const char *params[] = { "x", "y" };
+    lox_handle *h = lox_compile_params(source, params, 2);
+
+    matches(h, source, x_type);
+    lox_free(h);
+}
+
+int main(void) {
+    for (size_t row = 0; row < ROWS; row++) {
+        xs[row] = (double)row / 7;
+        ys[row] = (double)(ROWS - row) / 3;
+        bs[row] = row % 3 == 0;
+    }
+
+    rejects(LOX_STRING);
+    rejects(LOX_NIL);
+    rejects(LOX_ERROR);
+
+    compares("x * 2 + y", LOX_NUMBER);
+    compares("x < y ? x : y", LOX_NUMBER);
+    compares("x ? y : -y", LOX_BOOL);
+    compares("x < y and y > 100 or x > 400", LOX_NUMBER);
+    compares("x or y > 500 and !x", LOX_BOOL);
+
+    /* Promoted after a few rounds, so both trees see both types. */
+    const char *params[] = { "x", "y" };
+    lox_handle *h = lox_compile_params("x", params, 2);
+    lox_set_tier_threshold(4 * ROWS);
+    for (int round = 0; round < 8; round++)
+        matches(h, "x", round % 2 ? LOX_BOOL : LOX_NUMBER);
+    lox_free(h);
+
+    return failed != 0;
+}
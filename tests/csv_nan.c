@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "csv.h"
+
+/*
+ * The CSV front end prints numbers as the interpreter does, NaN included,
+ * whichever sign the hardware gave it.
+ */
+
+static int failed = 0;
+
+static void write(const char *path, const char *text) {
+    FILE *f = fopen(path, "w");
+    fputs(text, f);
+    fclose(f);
+}
+
+static void prints(const char *script, const char *expected) {
+    write("csv_test.lox", script);
+
+    char buf[256] = "";
+    FILE *out = tmpfile();
+    int status = CsvRun("csv_test.csv", "csv_test.lox", 2, NULL, out);
+    rewind(out);
+    size_t n = fread(buf, 1, sizeof(buf) - 1, out);
+    buf[n] = '\0';
+    fclose(out);
+
+    if (status != 0 || strcmp(buf, expected) != 0) {
+        printf("'%s' printed:\n%s\nexpected:\n%s\n", script, buf, expected);
+        failed++;
+    }
+}
+
+int main(void) {
+    write("csv_test.csv", "a,b\n0,0\n1,0\n-1,0\n3,2\n");
+
+    prints("a / b", "nan\ninf\n-inf\n1.500\n");
+    prints("0 / 0", "nan\nnan\nnan\nnan\n");
+    prints("a * (0 / 0)", "nan\nnan\nnan\nnan\n");
+
+    remove("csv_test.csv");
+    remove("csv_test.lox");
+    return failed != 0;
+}
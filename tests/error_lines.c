@@ -0,0 +1,49 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lox.h"
+
+/*
+ * Errors point at the line of the operator they are about, and tokens
+ * spanning several lines at the one they start on. Names too long to
+ * quote in full are cut short.
+ */
+
+static int failed = 0;
+
+static void reports(const char *source, const char *expected) {
+    lox_handle *h = lox_compile(source);
+    if (h != NULL || strncmp(lox_last_error(), expected, strlen(expected)) != 0) {
+        printf("'%s': expected \"%s\", got \"%s\"\n", source, expected, lox_last_error());
+        failed++;
+    }
+    lox_free(h);
+}
+
+static void truncates(size_t len) {
+    char *name = malloc(len + 1), expected[128];
+    memset(name, 'n', len);
+    name[len] = '\0';
+
+    snprintf(expected, sizeof(expected), "[ERROR @ line 1] At '%.44s': Undefined parameter.", name);
+    reports(name, expected);
+    free(name);
+}
+
+int main(void) {
+    reports("1 +\n2 +\n3 +\n4 + \"a\"", "[ERROR @ line 4]");
+    reports("1\n-\ntrue", "[ERROR @ line 2]");
+    reports("\n-\n\"a\"", "[ERROR @ line 2]");
+    reports("1\n?\n2 : 3", "[ERROR @ line 2]");
+    reports("1\nand true", "[ERROR @ line 2]");
+    reports("(1 \"a\nb\"", "[ERROR @ line 1]");
+    reports("(1 \"a\nb\" \"c\nd\"", "[ERROR @ line 1]");
+    reports("(\"a\nb\" \"c\nd\"", "[ERROR @ line 2]");
+
+    truncates(44);
+    truncates(45);
+    truncates(300);
+
+    return failed != 0;
+}
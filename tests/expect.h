@@ -0,0 +1,73 @@
+#ifndef EXPECT_H_
+#define EXPECT_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "lox.h"
+
+/*
+ * Checks a source against the output it is known to have, on the
+ * baseline tree and again once its handle is promoted to the optimized
+ * one. The output is the value as "%g" or the string itself, or, when
+ * compiling or evaluating fails, the error.
+ */
+
+static int failed = 0;
+
+static void show(lox_value v, char *buf, size_t size) {
+    switch (v.type) {
+    case LOX_NIL:
+        snprintf(buf, size, "nil");
+        break;
+    case LOX_BOOL:
+        snprintf(buf, size, "%s", v.as.boolean ? "true" : "false");
+        break;
+    case LOX_NUMBER:
+        snprintf(buf, size, "%g", v.as.number);
+        break;
+    case LOX_STRING:
+        snprintf(buf, size, "%.*s", (int)v.as.string.len, v.as.string.chars);
+        break;
+    case LOX_ERROR:
+        snprintf(buf, size, "%s", lox_last_error());
+        break;
+    }
+}
+
+static void compare(const char *source, const char *tier, const char *got,
+                    const char *expected) {
+    if (strcmp(got, expected) != 0) {
+        printf("'%s'%s:\n  expected %s\n  got      %s\n", source, tier, expected, got);
+        failed++;
+    }
+}
+
+static void expects(const char *source, const char *expected) {
+    char got[256];
+
+    lox_set_tier_threshold(SIZE_MAX);
+    lox_handle *h = lox_compile(source);
+    if (h == NULL) {
+        compare(source, "", lox_last_error(), expected);
+        return;
+    }
+
+    show(lox_eval(h), got, sizeof(got));
+    compare(source, " on the baseline", got, expected);
+
+    /* This evaluation starts the recompile, and still runs the baseline. */
+    lox_set_tier_threshold(0);
+    lox_eval(h);
+    for (int i = 0; i < 10000 && lox_tier(h) == 0; i++)
+        nanosleep(&(struct timespec){ .tv_nsec = 1000000 }, NULL);
+
+    show(lox_eval(h), got, sizeof(got));
+    compare(source, lox_tier(h) ? " once promoted" : " (never promoted)", got, expected);
+
+    lox_free(h);
+}
+
+#endif
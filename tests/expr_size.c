@@ -0,0 +1,41 @@
+#include <stdio.h>
+
+#include "expr.h"
+#include "pool.h"
+
+/*
+ * Every node the parser makes per token comes out of the pool rather than
+ * malloc, and the two inner nodes every chain of operators is built from
+ * take one cache line each.
+ */
+
+static int failed = 0;
+
+static void fits(const char *name, size_t size, size_t limit) {
+    if (size > limit) {
+        printf("%s is %zu bytes, more than %zu\n", name, size, limit);
+        failed++;
+    }
+}
+
+#define FITS(type, limit) fits(#type, sizeof(type), limit)
+
+int main(void) {
+    FITS(Binary, POOL_CACHE_LINE);
+    FITS(Tertiary, POOL_CACHE_LINE);
+
+    FITS(Binary, POOL_MAX_SIZE);
+    FITS(Tertiary, POOL_MAX_SIZE);
+    FITS(Unary, POOL_MAX_SIZE);
+    FITS(Logical, POOL_MAX_SIZE);
+    FITS(Grouping, POOL_MAX_SIZE);
+    FITS(Literal, POOL_MAX_SIZE);
+    FITS(Variable, POOL_MAX_SIZE);
+    FITS(Call, POOL_MAX_SIZE);
+    FITS(New, POOL_MAX_SIZE);
+    FITS(Get, POOL_MAX_SIZE);
+    FITS(Set, POOL_MAX_SIZE);
+    FITS(Invoke, POOL_MAX_SIZE);
+
+    return failed != 0;
+}
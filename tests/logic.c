@@ -0,0 +1,80 @@
+#include "expect.h"
+
+/*
+ * 'and', 'or' and '?:' against known results. Each operand of a condition
+ * records that it ran by appending to a log, so a case gives both which
+ * operands were evaluated, in what order, and what the condition came to.
+ * The optimized tier drops constant operands and cuts chains short, and
+ * must leave the log as the baseline does.
+ */
+
+#define RECORDER                                                    \
+    "class L { init() { return this.s = \"\"; } } "                 \
+    "fun t(l, s, v) { return (l.s = l.s + s, v); } "
+
+static void logs(const char *condition, const char *expected) {
+    char source[1024];
+
+    snprintf(source, sizeof(source),
+             RECORDER "fun run(l) { return (%s) ? l.s + \" true\" : l.s + \" false\"; } run(L())",
+             condition);
+    expects(source, expected);
+}
+
+int main(void) {
+    /* The right operand runs only when the left one does not decide. */
+    logs("t(l, \"a\", false) and t(l, \"b\", true)", "a false");
+    logs("t(l, \"a\", true) and t(l, \"b\", false)", "ab false");
+    logs("t(l, \"a\", true) or t(l, \"b\", false)", "a true");
+    logs("t(l, \"a\", false) or t(l, \"b\", true)", "ab true");
+
+    /* Long chains leave at the first operand that decides them. */
+    logs("t(l, \"a\", true) and t(l, \"b\", true) and t(l, \"c\", false) and "
+         "t(l, \"d\", true) and t(l, \"e\", true)", "abc false");
+    logs("t(l, \"a\", false) or t(l, \"b\", false) or t(l, \"c\", true) or "
+         "t(l, \"d\", false)", "abc true");
+    logs("t(l, \"a\", true) and t(l, \"b\", true) and t(l, \"c\", true)", "abc true");
+    logs("t(l, \"a\", false) or t(l, \"b\", false) or t(l, \"c\", false)", "abc false");
+
+    /* 'and' binds tighter than 'or'. */
+    logs("t(l, \"a\", true) and t(l, \"b\", false) or t(l, \"c\", true) and t(l, \"d\", true)",
+         "abcd true");
+    logs("t(l, \"a\", true) or t(l, \"b\", true) and t(l, \"c\", true)", "a true");
+    logs("t(l, \"a\", false) and t(l, \"b\", true) or t(l, \"c\", false)", "ac false");
+
+    /* Grouping, negation, comparisons and '?:' inside a condition. */
+    logs("(t(l, \"a\", true) or t(l, \"b\", true)) and t(l, \"c\", false)", "ac false");
+    logs("t(l, \"a\", false) and (t(l, \"b\", true) or t(l, \"c\", true))", "a false");
+    logs("!t(l, \"a\", false) and t(l, \"b\", true)", "ab true");
+    logs("t(l, \"a\", 1) == 1 and t(l, \"b\", 2) > 3", "ab false");
+    logs("(t(l, \"a\", false) or t(l, \"b\", true)) ? t(l, \"c\", false) : t(l, \"d\", true)",
+         "abc false");
+
+    /* Constant operands are dropped or end the chain, never the calls. */
+    logs("t(l, \"a\", false) or true", "a true");
+    logs("t(l, \"a\", true) and false", "a false");
+    logs("false and t(l, \"a\", true)", " false");
+    logs("true or t(l, \"a\", false)", " true");
+    logs("true and t(l, \"a\", false)", "a false");
+    logs("t(l, \"a\", true) and true and t(l, \"b\", false)", "ab false");
+    logs("false or t(l, \"a\", false) or false", "a false");
+
+    /* The result is a boolean, whatever the operands were. */
+    expects("true and true", "true");
+    expects("false or false", "false");
+    expects("1 < 2 and 2 < 3 or 1 > 2", "true");
+
+    /* Only the operands that run are checked for being booleans. */
+    expects("fun f(x) { return false and x; } f(1)", "false");
+    expects("fun f(x) { return true or x; } f(\"s\")", "true");
+    expects("fun f(x) { return true and x; } f(1)", "[ERROR @ line 1] 'and' expects booleans.");
+    expects("fun f(x) { return x and true; } f(1)", "[ERROR @ line 1] 'and' expects booleans.");
+    expects("fun f(x) { return x or false; } f(nil)", "[ERROR @ line 1] 'or' expects booleans.");
+    expects("fun f(x) { return x or false; } f(true)", "true");
+    expects(RECORDER "fun run(l) { return (t(l, \"a\", false) or t(l, \"b\", 1), l.s); } run(L())",
+            "[ERROR @ line 1] 'or' expects booleans.");
+    expects("fun f(x) { return x ? 1 : 2; } f(0)",
+            "[ERROR @ line 1] Tertiary operator expects condition to be a boolean.");
+
+    return failed != 0;
+}
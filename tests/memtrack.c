@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "logging.h"
+#include "lexer.h"
+#include "parser.h"
+#include "interpreter.h"
+#include "heap.h"
+#include "memtrack.h"
+
+/*
+ * Once its tree is freed and a major collection has run, a script leaves
+ * nothing behind, however it ends: not the strings and ropes it built, nor
+ * its instances and their fields, nor what its calls held when one of them
+ * failed.
+ */
+
+static int failed = 0;
+
+static void leaves(const char *source, bool fails) {
+    TokenList tokens = TokenListInit();
+    Expr *expr = NULL;
+    hadError = false;
+
+    if (LexerTokenize(source, strlen(source), &tokens)) {
+        TokenListPush(&tokens, TokenEOF);
+
+        Parser parser = ParserInit(tokens.tokens);
+        expr = ParserParse(&parser);
+    }
+    TokenListFini(&tokens);
+
+    Object *value = NULL;
+    if (expr != NULL) {
+        Interpreter interpreter = InterpreterInit();
+        value = InterpreterInterpret(&interpreter, expr);
+        InterpreterFini(&interpreter);
+        ExprFini(expr);
+    }
+
+    HeapCollect(HeapCurrent(), true);
+
+    if ((value == NULL) != fails) {
+        printf("'%s': %s\n", source, fails ? "did not fail" : "failed");
+        failed++;
+    }
+
+    size_t live = MemTrackLiveBytes();
+    if (live != 0) {
+        printf("'%s': %zu bytes still live\n", source, live);
+        MemTrackReport(stdout);
+        failed++;
+    }
+}
+
+int main(void) {
+    /* The failing scripts report their errors, which are expected. */
+    if (freopen("/dev/null", "w", stderr) == NULL)
+        return 1;
+
+    MemTrackEnable();
+    Heap heap = HeapInit(HEAP_NURSERY_SIZE);
+    HeapSetCurrent(&heap);
+
+    /* Strings, inline and not. */
+    leaves("\"short\" + \"a string too long to be stored inline\"", false);
+    leaves("\"abc\" * 1000 == \"abc\"", false);
+
+    /* Ropes, flattened and not. */
+    leaves("(\"x\" * 70 + \"y\" * 70) + (\"z\" * 70 + \"w\" * 70)", false);
+    leaves("((\"a\" * 40 + \"b\" * 40) + \"c\" * 40) < \"d\"", false);
+
+    /* Instances, with more fields than they start out with room for. */
+    leaves("class P { init() { return this.a = \"s\" * 50, this.b = 1, this.c = 2, "
+           "this.d = 3, this.e = \"t\" * 50; } v() { return this.a + this.e; } } P().v()", false);
+
+    /* Calls, each holding part of the result. */
+    leaves("fun f(n) { return n == 0 ? \"\" : \"ab\" * 10 + f(n - 1); } f(200)", false);
+    leaves("class N { init() { return this.s = \"n\" * 20; } } "
+           "fun f(n, o) { return n == 0 ? o.s : f(n - 1, N()) + o.s; } f(100, N())", false);
+
+    /* Errors at run time, after some of the result has been built. */
+    leaves("\"a\" * 50 + (1 - \"b\")", true);
+    leaves("fun f(n) { return \"x\" * 40 + f(n + 1); } f(0)", true);
+    leaves("class P { init() { return this.x = \"s\" * 40; } } P().y + \"z\" * 40", true);
+
+    /* And at compile time. */
+    leaves("\"a\" * 40 + (1 +", true);
+    leaves("\"a\" * 40 + nowhere", true);
+
+    HeapFini(&heap);
+
+    return failed != 0;
+}
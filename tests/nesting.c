@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lox.h"
+
+/*
+ * Expressions nested past what the recursive passes can take are rejected
+ * by the parser with an error, rather than overflowing the stack later.
+ * Those just short of the limit still compile, optimize and evaluate.
+ * Calls to deeply nested bodies are each short enough, but recursing
+ * into them adds up, and fails with an error rather than a crash.
+ */
+
+static int failed = 0;
+
+/* Source of n copies of open, then middle, then n copies of close. */
+static char *repeat(const char *open, size_t n, const char *middle, const char *close) {
+    size_t a = strlen(open), b = strlen(middle), c = strlen(close);
+    char *retval = malloc(n * (a + c) + b + 1), *at = retval;
+
+    for (size_t i = 0; i < n; i++, at += a)
+        memcpy(at, open, a);
+    memcpy(at, middle, b);
+    at += b;
+    for (size_t i = 0; i < n; i++, at += c)
+        memcpy(at, close, c);
+    *at = '\0';
+
+    return retval;
+}
+
+static void rejects(const char *what, char *source) {
+    lox_handle *h = lox_compile(source);
+    if (h != NULL || strstr(lox_last_error(), "nests too deeply") == NULL) {
+        printf("%s: compiled, or failed with \"%s\"\n", what, lox_last_error());
+        failed++;
+        lox_free(h);
+    }
+    free(source);
+}
+
+static void evaluates(const char *what, char *source, double expected) {
+    lox_handle *h = lox_compile(source);
+    if (h == NULL) {
+        printf("%s: %s\n", what, lox_last_error());
+        failed++;
+        free(source);
+        return;
+    }
+
+    /* Once on each tier, the promoted tree having gone through the
+     * optimizer as well. */
+    lox_value first = lox_eval(h);
+    for (int i = 0; i < 10000 && lox_tier(h) == 0; i++)
+        nanosleep(&(struct timespec){ .tv_nsec = 1000000 }, NULL);
+    lox_value second = lox_eval(h);
+
+    if (lox_tier(h) == 0 || first.type != LOX_NUMBER || first.as.number != expected ||
+        second.type != LOX_NUMBER || second.as.number != expected) {
+        printf("%s: did not evaluate to %g\n", what, expected);
+        failed++;
+    }
+
+    lox_free(h);
+    free(source);
+}
+
+/* A function that nests its recursive call parens deep, called as f(n),
+ * which returns n. */
+static char *recursion(size_t parens, size_t n) {
+    char *body = repeat("(", parens, "1 + f(n - 1)", ")");
+    size_t len = strlen(body) + 64;
+    char *retval = malloc(len);
+
+    snprintf(retval, len, "fun f(n) { return n == 0 ? 0 : %s; } f(%zu)", body, n);
+    free(body);
+    return retval;
+}
+
+static void overflows(const char *what, char *source) {
+    lox_handle *h = lox_compile(source);
+    lox_value v = h != NULL ? lox_eval(h) : (lox_value){ .type = LOX_ERROR };
+
+    if (v.type != LOX_ERROR || strstr(lox_last_error(), "Stack overflow") == NULL) {
+        printf("%s: evaluated, or failed with \"%s\"\n", what, lox_last_error());
+        failed++;
+    }
+
+    lox_free(h);
+    free(source);
+}
+
+int main(void) {
+    lox_set_tier_threshold(0);
+
+    rejects("50000 additions", repeat("1 + ", 50000, "1", ""));
+    rejects("30000 groupings", repeat("(", 30000, "1", ")"));
+    rejects("100000 negations", repeat("-", 100000, "1", ""));
+    rejects("30000 nested conditions", repeat("true ? 1 : (", 30000, "1", ")"));
+
+    evaluates("4000 additions", repeat("1 + ", 3999, "1", ""), 4000);
+    evaluates("4000 groupings", repeat("(", 4000, "1", ")"), 1);
+    evaluates("4000 negations", repeat("-", 4000, "1", ""), 1);
+
+    overflows("100 parens deep, 2000 calls", recursion(100, 2000));
+    overflows("3000 parens deep, 50 calls", recursion(3000, 50));
+    overflows("4000 parens deep, 2000 calls", recursion(4000, 2000));
+    evaluates("100 parens deep, 100 calls", recursion(100, 100), 100);
+    evaluates("3000 parens deep, 4 calls", recursion(3000, 4), 4);
+
+    return failed != 0;
+}
@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parallel_lexer.h"
+
+/*
+ * LexerTokenizeParallel against LexerTokenize, over random sources large
+ * enough to be split. The pieces open and close strings and comments, so
+ * chunks regularly start inside one and have to be stitched.
+ */
+
+#define ROUNDS 24
+
+static const char *pieces[] = {
+    "1 + 2", "\"str\"", "\"multi\nline\nstring\"", "/* c\n * omment */",
+    "// line comment", "\n", " ", "foo", "and", "(", ")", "<=", "3.25",
+    "!=", ";", "\n\n", "x\"\"y", "\"", "/*", "*/"
+};
+
+/* The last three unbalance strings and comments, and are kept rare so that
+ * most of the source is still lexed as tokens. */
+#define N_PIECES (sizeof(pieces) / sizeof(*pieces))
+#define N_BALANCED (N_PIECES - 3)
+
+static char *source(size_t *len) {
+    size_t target = LEX_PARALLEL_MIN + rand() % LEX_PARALLEL_MIN;
+    char *retval = malloc(target + 64);
+    *len = 0;
+
+    while (*len < target) {
+        size_t k = rand() % N_PIECES;
+        if (k >= N_BALANCED && rand() % 64 != 0)
+            k = rand() % N_BALANCED;
+
+        size_t n = strlen(pieces[k]);
+        memcpy(retval + *len, pieces[k], n);
+        *len += n;
+        retval[(*len)++] = rand() % 3 ? ' ' : '\n';
+    }
+
+    return retval;
+}
+
+static bool same(const TokenList *a, const TokenList *b) {
+    if (a->len != b->len)
+        return false;
+
+    for (size_t i = 0; i < a->len; i++) {
+        const Token *x = &a->tokens[i], *y = &b->tokens[i];
+        if (x->type != y->type || x->lexeme != y->lexeme ||
+            x->lexeme_len != y->lexeme_len || x->line != y->line)
+            return false;
+    }
+
+    return true;
+}
+
+int main(void) {
+    int failed = 0;
+    srand(31);
+
+    /* Both report the same lexical errors, which are of no interest here. */
+    if (freopen("/dev/null", "w", stderr) == NULL)
+        return 1;
+
+    for (int round = 0; round < ROUNDS; round++) {
+        size_t len;
+        char *src = source(&len);
+        int threads = 2 + rand() % 7;
+
+        TokenList serial = TokenListInit(), parallel = TokenListInit();
+        bool serial_ok = LexerTokenize(src, len, &serial);
+        bool parallel_ok = LexerTokenizeParallel(src, len, threads, &parallel);
+
+        if (serial_ok != parallel_ok || !same(&serial, &parallel)) {
+            printf("round %d: %zu bytes on %d threads gave %zu tokens, not %zu\n",
+                   round, len, threads, parallel.len, serial.len);
+            failed++;
+        }
+
+        TokenListFini(&serial);
+        TokenListFini(&parallel);
+        free(src);
+    }
+
+    return failed != 0;
+}
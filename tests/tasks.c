@@ -0,0 +1,160 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lox.h"
+#include "memtrack.h"
+
+/*
+ * Tasks against lox_eval_args. A task run a slice of steps at a time is
+ * suspended after exactly the steps it was given, and finishes with the
+ * value lox_eval_args gives, after as many steps as it takes in one go. A
+ * quota of exactly those steps is enough and one fewer fails it, as does
+ * too little memory. Freeing a task, whether suspended, finished or never
+ * run, leaves nothing behind.
+ */
+
+static int failed = 0;
+
+static const char *fib = "fun fib(n) { return n < 2 ? n : fib(n - 1) + fib(n - 2); } fib(x)";
+static const char *doubling = "fun r(n, s) { return n == 0 ? s : r(n - 1, s + s); } r(x, \"ab\")";
+static const char *params[] = { "x" };
+
+static bool same(lox_value a, lox_value b) {
+    if (a.type != b.type)
+        return false;
+
+    switch (a.type) {
+    case LOX_BOOL: return a.as.boolean == b.as.boolean;
+    case LOX_NUMBER: return a.as.number == b.as.number;
+    case LOX_STRING:
+        return a.as.string.len == b.as.string.len &&
+               memcmp(a.as.string.chars, b.as.string.chars, a.as.string.len) == 0;
+    default: return true;
+    }
+}
+
+/* The steps the whole evaluation takes, run in one go. */
+static uint64_t total(const lox_handle *h, const lox_value *args) {
+    lox_task *task = lox_start(h, args, NULL);
+    lox_value value;
+
+    lox_resume(task, 0, &value);
+    uint64_t retval = lox_task_steps(task);
+    lox_task_free(task);
+
+    return retval;
+}
+
+static void slices(const char *source, double x, uint64_t slice) {
+    lox_handle *h = lox_compile_params(source, params, 1);
+    lox_value args[] = { { .type = LOX_NUMBER, .as.number = x } };
+    lox_value expected = lox_eval_args(h, args);
+    uint64_t steps = total(h, args);
+
+    lox_task *task = lox_start(h, args, NULL);
+    lox_value value;
+    uint64_t given = 0;
+    bool done;
+
+    while (given += slice, !(done = lox_resume(task, slice, &value))) {
+        if (lox_task_steps(task) != given) {
+            printf("'%s' by %llu: suspended after %llu steps, not %llu\n", source,
+                   (unsigned long long)slice, (unsigned long long)lox_task_steps(task),
+                   (unsigned long long)given);
+            failed++;
+            break;
+        }
+    }
+
+    if (done && (lox_task_steps(task) != steps || given - steps >= slice)) {
+        printf("'%s' by %llu: finished after %llu steps of %llu given, not %llu\n", source,
+               (unsigned long long)slice, (unsigned long long)lox_task_steps(task),
+               (unsigned long long)given, (unsigned long long)steps);
+        failed++;
+    }
+    if (done && !same(value, expected)) {
+        printf("'%s' by %llu: finished with another value than lox_eval_args\n", source,
+               (unsigned long long)slice);
+        failed++;
+    }
+
+    lox_task_free(task);
+    lox_free(h);
+}
+
+/* Fails with error within q, or finishes if error is NULL. */
+static void quota(const char *source, double x, lox_quota q, const char *error) {
+    lox_handle *h = lox_compile_params(source, params, 1);
+    lox_value args[] = { { .type = LOX_NUMBER, .as.number = x } };
+    lox_task *task = lox_start(h, args, &q);
+    lox_value value;
+
+    while (!lox_resume(task, 100, &value))
+        ;
+
+    bool fails = value.type == LOX_ERROR;
+    if (fails != (error != NULL) || (fails && strstr(lox_last_error(), error) == NULL)) {
+        printf("'%s' within %llu steps and %zu bytes: %s\n", source,
+               (unsigned long long)q.max_steps, q.max_bytes,
+               fails ? lox_last_error() : "did not fail");
+        failed++;
+    }
+
+    lox_task_free(task);
+    lox_free(h);
+}
+
+/* Frees a task never run, and one suspended however deep in its calls
+ * the steps given take it. */
+static void leaves(const char *source, double x, uint64_t steps) {
+    lox_handle *h = lox_compile_params(source, params, 1);
+    lox_value args[] = { { .type = LOX_NUMBER, .as.number = x } };
+    size_t before = MemTrackLiveBytes();
+    lox_value value;
+
+    lox_task_free(lox_start(h, args, NULL));
+
+    lox_task *task = lox_start(h, args, NULL);
+    if (lox_resume(task, steps, &value)) {
+        printf("'%s': finished within %llu steps\n", source, (unsigned long long)steps);
+        failed++;
+    }
+    lox_task_free(task);
+
+    size_t live = MemTrackLiveBytes();
+    if (live != before) {
+        printf("'%s': %zu bytes live after freeing its tasks, from %zu\n", source, live, before);
+        MemTrackReport(stdout);
+        failed++;
+    }
+
+    lox_free(h);
+}
+
+int main(void) {
+    MemTrackEnable();
+    lox_set_tier_threshold(SIZE_MAX);
+
+    for (uint64_t slice = 1; slice <= 10000; slice *= 7) {
+        slices(fib, 15, slice);
+        slices(doubling, 12, slice);
+    }
+
+    lox_handle *h = lox_compile_params(fib, params, 1);
+    lox_value args[] = { { .type = LOX_NUMBER, .as.number = 15 } };
+    uint64_t steps = total(h, args);
+    lox_free(h);
+
+    quota(fib, 15, (lox_quota){ .max_steps = steps }, NULL);
+    quota(fib, 15, (lox_quota){ .max_steps = steps - 1 }, "ran out of steps");
+    quota(doubling, 18, (lox_quota){ .max_bytes = 64 << 20 }, NULL);
+    quota(doubling, 18, (lox_quota){ .max_bytes = 64 << 10 }, "ran out of memory");
+
+    leaves(fib, 20, 1000);
+    leaves(doubling, 16, 40);
+    leaves("class N { init(n) { return this.s = \"ab\" * n; } } "
+           "fun f(n, o) { return n == 0 ? o.s : f(n - 1, N(n)) + o.s; } f(x, N(1))", 200, 3000);
+
+    return failed != 0;
+}
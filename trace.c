@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include "trace.h"
+
+#define TRACE_NAME_MAX 32
+
+typedef struct TraceBuffer TraceBuffer;
+
+struct TraceBuffer {
+    TraceBuffer *next;
+    int tid;
+    char name[TRACE_NAME_MAX];
+
+    /* Total events ever recorded; the ring holds the last of them. */
+    uint64_t written;
+    TraceEvent events[TRACE_RING_SIZE];
+};
+
+bool traceEnabled = false;
+
+static uint64_t startNs;
+static _Atomic(TraceBuffer*) buffers = NULL;
+static atomic_int nextTid = 1;
+static _Thread_local TraceBuffer *local = NULL;
+
+/* ---- HELPER FUNCTIONS ---- */
+
+static uint64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static TraceBuffer *threadBuffer(void) {
+    if (local != NULL)
+        return local;
+
+    local = calloc(1, sizeof(TraceBuffer));
+    local->tid = atomic_fetch_add(&nextTid, 1);
+    snprintf(local->name, sizeof(local->name), "thread %d", local->tid);
+
+    TraceBuffer *head = atomic_load(&buffers);
+    do {
+        local->next = head;
+    } while (!atomic_compare_exchange_weak(&buffers, &head, local));
+
+    return local;
+}
+
+static void record(char phase, const char *name, const char *detail, int64_t arg) {
+    TraceBuffer *b = threadBuffer();
+
+    b->events[b->written & (TRACE_RING_SIZE - 1)] = (TraceEvent){
+        .ts_ns = nowNs(),
+        .name = name,
+        .detail = detail,
+        .arg = arg,
+        .phase = phase
+    };
+    b->written++;
+}
+
+static void writeString(FILE *f, const char *str) {
+    fputc('"', f);
+
+    for (; *str != '\0'; str++) {
+        if (*str == '"' || *str == '\\')
+            fprintf(f, "\\%c", *str);
+        else if ((unsigned char)*str < 0x20)
+            fprintf(f, "\\u%04x", *str);
+        else
+            fputc(*str, f);
+    }
+
+    fputc('"', f);
+}
+
+static void writeEvent(FILE *f, const TraceBuffer *b, const TraceEvent *e, bool *first) {
+    fprintf(f, "%s\n{\"name\":", *first ? "" : ",");
+    writeString(f, e->name);
+    fprintf(f, ",\"cat\":\"lox\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d",
+            e->phase, (e->ts_ns - startNs) / 1e3, b->tid);
+
+    if (e->phase == 'i')
+        fputs(",\"s\":\"t\"", f);
+
+    if (e->phase != 'E') {
+        fprintf(f, ",\"args\":{\"value\":%lld", (long long)e->arg);
+        if (e->detail != NULL) {
+            fputs(",\"detail\":", f);
+            writeString(f, e->detail);
+        }
+        fputc('}', f);
+    }
+
+    fputc('}', f);
+    *first = false;
+}
+
+/* ---- MAIN METHODS ---- */
+
+void TraceEnable(void) {
+    startNs = nowNs();
+    traceEnabled = true;
+}
+
+void TraceThreadName(const char *name) {
+    if (!traceEnabled)
+        return;
+
+    TraceBuffer *b = threadBuffer();
+    snprintf(b->name, sizeof(b->name), "%s", name);
+}
+
+void TraceBegin(const char *name, const char *detail, int64_t arg) {
+    record('B', name, detail, arg);
+}
+
+void TraceEnd(const char *name) {
+    record('E', name, NULL, 0);
+}
+
+void TraceInstant(const char *name, int64_t arg) {
+    record('i', name, NULL, arg);
+}
+
+bool TraceWrite(const char *path) {
+    FILE *f = fopen(path, "w");
+    bool first = true;
+    TraceBuffer *b = atomic_exchange(&buffers, NULL);
+
+    traceEnabled = false;
+    local = NULL;
+
+    if (f != NULL)
+        fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", f);
+
+    while (b != NULL) {
+        TraceBuffer *next = b->next;
+
+        if (f != NULL) {
+            uint64_t from = b->written > TRACE_RING_SIZE ? b->written - TRACE_RING_SIZE : 0;
+
+            fprintf(f, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                    "\"args\":{\"name\":", first ? "" : ",", b->tid);
+            writeString(f, b->name);
+            fputs("}}", f);
+            first = false;
+
+            for (uint64_t i = from; i < b->written; i++)
+                writeEvent(f, b, &b->events[i & (TRACE_RING_SIZE - 1)], &first);
+
+            if (from > 0)
+                fprintf(stderr, "Trace: dropped the first %llu events of %s.\n",
+                        (unsigned long long)from, b->name);
+        }
+
+        free(b);
+        b = next;
+    }
+
+    if (f == NULL)
+        return false;
+
+    fputs("\n]}\n", f);
+    fclose(f);
+    return true;
+}
@@ -0,0 +1,64 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Events kept per thread; older ones are overwritten. A power of two. */
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE (1 << 16)
+#endif
+
+typedef struct {
+    uint64_t ts_ns;
+    const char *name;
+    const char *detail;
+    int64_t arg;
+    char phase;
+} TraceEvent;
+
+/*
+ * A timeline of begin/end spans, written out in Chrome's trace event
+ * format for chrome://tracing or Perfetto.
+ *
+ * Every thread records into a ring buffer of its own, so recording takes
+ * no locks; buffers are only linked into a global list, with a
+ * compare-and-swap, on a thread's first event. Names and details are not
+ * copied and must outlive the trace, which string literals and argv do.
+ *
+ * Tracing is off unless TraceEnable is called, and the TRACE_* macros
+ * then cost a single predictable branch.
+ */
+extern bool traceEnabled;
+
+void TraceEnable(void);
+
+/* Names the calling thread's track. The name is copied. */
+void TraceThreadName(const char *name);
+
+void TraceBegin(const char *name, const char *detail, int64_t arg);
+void TraceEnd(const char *name);
+void TraceInstant(const char *name, int64_t arg);
+
+/* Only once every traced thread has finished. Frees the buffers. */
+bool TraceWrite(const char *path);
+
+#define TRACE_BEGIN(name, detail, arg)          \
+    do {                                        \
+        if (traceEnabled)                       \
+            TraceBegin(name, detail, arg);      \
+    } while (0)
+
+#define TRACE_END(name)                         \
+    do {                                        \
+        if (traceEnabled)                       \
+            TraceEnd(name);                     \
+    } while (0)
+
+#define TRACE_INSTANT(name, arg)                \
+    do {                                        \
+        if (traceEnabled)                       \
+            TraceInstant(name, arg);            \
+    } while (0)
+
+#endif
@@ -0,0 +1,260 @@
+#include <stdlib.h>
+
+#include "typecheck.h"
+#include "logging.h"
+
+typedef struct {
+    ExprVisitor base;
+
+    /* How many '?:' branches the current node is inside of. */
+    size_t branches;
+    bool ok;
+} TypeChecker;
+
+/* ---- HELPER FUNCTIONS ---- */
+
+static StaticType check(ExprVisitor *v, Expr *expr) {
+    expr->accept(v, expr);
+    return expr->type;
+}
+
+static inline bool known(StaticType type) {
+    return type != TYPE_DYNAMIC;
+}
+
+/* Whether a value of type a can be a b; dynamic values can be anything. */
+static inline bool canBe(StaticType a, StaticType b) {
+    return !known(a) || a == b;
+}
+
+static inline bool orderable(StaticType type) {
+    return canBe(type, TYPE_NUMBER) || canBe(type, TYPE_STRING);
+}
+
+/* Gives the node type, or reports msg and leaves it dynamic when well is
+ * false. */
+static void *result(ExprVisitor *v, Expr *expr, bool well, StaticType type, const char *msg) {
+    TypeChecker *c = (TypeChecker*)v;
+
+    if (well) {
+        expr->type = type;
+        return NULL;
+    }
+
+    expr->type = TYPE_DYNAMIC;
+    if (c->branches == 0) {
+        error(expr->line, msg);
+        c->ok = false;
+    }
+
+    return NULL;
+}
+
+/* ---- ExprVisitorS ---- */
+
+static void *visitLiteralExpr(ExprVisitor *v, Literal *l) {
+    static const StaticType types[] = {
+        [OBJECT_NUMBER] = TYPE_NUMBER,
+        [OBJECT_BOOL] = TYPE_BOOL,
+        [OBJECT_STRING] = TYPE_STRING,
+        [OBJECT_NIL] = TYPE_NIL
+    };
+
+    l->base.type = types[l->object.type];
+    return NULL;
+}
+
+static void *visitVariableExpr(ExprVisitor *v, Variable *var) {
+    var->base.type = TYPE_DYNAMIC;
+    return NULL;
+}
+
+static void *visitGroupingExpr(ExprVisitor *v, Grouping *g) {
+    g->base.type = check(v, g->expr);
+    return NULL;
+}
+
+static void *visitUnaryExpr(ExprVisitor *v, Unary *u) {
+    StaticType right = check(v, u->right);
+
+    if (u->operation == OPER_NEGATE)
+        return result(v, &u->base, canBe(right, TYPE_NUMBER), TYPE_NUMBER,
+                      "unary '-' expects a number.\n");
+
+    return result(v, &u->base, canBe(right, TYPE_BOOL), TYPE_BOOL, "'!' expects a boolean.\n");
+}
+
+static void *visitBinaryExpr(ExprVisitor *v, Binary *b) {
+    StaticType left = check(v, b->left);
+    StaticType right = check(v, b->right);
+    Expr *e = &b->base;
+
+    switch (b->operation) {
+    case OPER_COMMA:
+        e->type = right;
+        return NULL;
+
+    case OPER_EQUAL:
+    case OPER_NOT_EQUAL:
+        e->type = TYPE_BOOL;
+        return NULL;
+
+    case OPER_ADD:
+        return result(v, e, orderable(left) && orderable(right) &&
+                            (!known(left) || !known(right) || left == right),
+                      known(left) ? left : right,
+                      "'+' expects either two strings or two numbers.\n");
+
+    case OPER_SUB:
+        return result(v, e, canBe(left, TYPE_NUMBER) && canBe(right, TYPE_NUMBER), TYPE_NUMBER,
+                      "'-' expects numeric arguments.\n");
+
+    case OPER_DIV:
+        return result(v, e, canBe(left, TYPE_NUMBER) && canBe(right, TYPE_NUMBER), TYPE_NUMBER,
+                      "'/' expects numeric arguments.\n");
+
+    case OPER_MUL: {
+        /* A string on either side makes a repetition; a number on both a
+         * product. Only a string on one side settles which. */
+        bool well = orderable(left) && orderable(right) &&
+                    !(left == TYPE_STRING && right == TYPE_STRING);
+        StaticType type = left == TYPE_STRING || right == TYPE_STRING ? TYPE_STRING :
+                          left == TYPE_NUMBER && right == TYPE_NUMBER ? TYPE_NUMBER :
+                          TYPE_DYNAMIC;
+
+        return result(v, e, well, type, "'*' expects two numbers or a string and a count.\n");
+    }
+
+    case OPER_LESS:
+    case OPER_LESS_EQUAL:
+    case OPER_GREATER:
+    case OPER_GREATER_EQUAL:
+        return result(v, e, orderable(left) && orderable(right) &&
+                            (!known(left) || !known(right) || left == right),
+                      TYPE_BOOL, "Comparison expects either two strings or two numbers.\n");
+
+    default:
+        e->type = TYPE_DYNAMIC;
+        return NULL;
+    }
+}
+
+static void *visitTertiaryExpr(ExprVisitor *v, Tertiary *t) {
+    TypeChecker *c = (TypeChecker*)v;
+    StaticType condition = check(v, t->condition);
+
+    c->branches++;
+    StaticType ifTrue = check(v, t->ifTrue);
+    StaticType ifFalse = check(v, t->ifFalse);
+    c->branches--;
+
+    return result(v, &t->base, canBe(condition, TYPE_BOOL),
+                  ifTrue == ifFalse ? ifTrue : TYPE_DYNAMIC,
+                  "Tertiary operator expects condition to be a boolean.\n");
+}
+
+/* Only the first operand is sure to run; the rest are checked like
+ * branches. Whatever the chain does not fail on, it gives a boolean. */
+static void *visitLogicalExpr(ExprVisitor *v, Logical *l) {
+    TypeChecker *c = (TypeChecker*)v;
+    StaticType first = check(v, l->operands[0]);
+
+    c->branches++;
+    for (size_t i = 1; i < l->n_operands; i++)
+        check(v, l->operands[i]);
+    c->branches--;
+
+    return result(v, &l->base, canBe(first, TYPE_BOOL), TYPE_BOOL,
+                  l->operation == OPER_AND ? "'and' expects booleans.\n" :
+                                             "'or' expects booleans.\n");
+}
+
+/* A call has the type of its callee's body, once that is checked; a call
+ * checked before, recursive ones included, stays dynamic. */
+static void *visitCallExpr(ExprVisitor *v, Call *c) {
+    for (size_t i = 0; i < c->callee->arity; i++)
+        check(v, c->args[i]);
+
+    c->base.type = c->callee->body->type;
+    return NULL;
+}
+
+/* Whichever init runs, it hands back the new instance. */
+static void *visitNewExpr(ExprVisitor *v, New *n) {
+    size_t arity = n->klass->init != NULL ? n->klass->init->arity - 1 : 0;
+
+    for (size_t i = 0; i < arity; i++)
+        check(v, n->args[i]);
+
+    n->base.type = TYPE_DYNAMIC;
+    return NULL;
+}
+
+/* Instances have no type of their own, so any known type is not one, and
+ * nothing is known about what a field holds. */
+static void *visitGetExpr(ExprVisitor *v, Get *g) {
+    StaticType object = check(v, g->object);
+    return result(v, &g->base, !known(object), TYPE_DYNAMIC,
+                  "Only instances have properties.\n");
+}
+
+static void *visitSetExpr(ExprVisitor *v, Set *s) {
+    StaticType object = check(v, s->object);
+    StaticType value = check(v, s->value);
+    return result(v, &s->base, !known(object), value, "Only instances have fields.\n");
+}
+
+static void *visitInvokeExpr(ExprVisitor *v, Invoke *i) {
+    StaticType object = check(v, i->object);
+
+    for (size_t k = 0; k < i->n_args; k++)
+        check(v, i->args[k]);
+
+    return result(v, &i->base, !known(object), TYPE_DYNAMIC, "Only instances have methods.\n");
+}
+
+/* A function body may never run, so its errors are left to the evaluator
+ * like those of a branch. */
+static void *visitScriptExpr(ExprVisitor *v, Script *s) {
+    TypeChecker *c = (TypeChecker*)v;
+
+    c->branches++;
+    for (size_t i = 0; i < s->n_functions; i++)
+        check(v, s->functions[i].body);
+
+    for (size_t i = 0; i < s->n_classes; i++) {
+        for (size_t j = 0; j < s->classes[i].n_methods; j++)
+            check(v, s->classes[i].methods[j].body);
+    }
+    c->branches--;
+
+    s->base.type = check(v, s->body);
+    return NULL;
+}
+
+/* ---- MAIN METHODS ---- */
+
+bool TypeCheck(Expr *expr) {
+    TypeChecker c = {
+        .base = (ExprVisitor){
+            .visitBinaryExpr = visitBinaryExpr,
+            .visitGroupingExpr = visitGroupingExpr,
+            .visitLiteralExpr = visitLiteralExpr,
+            .visitTertiaryExpr = visitTertiaryExpr,
+            .visitLogicalExpr = visitLogicalExpr,
+            .visitUnaryExpr = visitUnaryExpr,
+            .visitVariableExpr = visitVariableExpr,
+            .visitCallExpr = visitCallExpr,
+            .visitNewExpr = visitNewExpr,
+            .visitGetExpr = visitGetExpr,
+            .visitSetExpr = visitSetExpr,
+            .visitInvokeExpr = visitInvokeExpr,
+            .visitScriptExpr = visitScriptExpr
+        },
+        .branches = 0,
+        .ok = true
+    };
+
+    check((ExprVisitor*)&c, expr);
+    return c.ok;
+}
@@ -0,0 +1,20 @@
+#ifndef TYPECHECK_H_
+#define TYPECHECK_H_
+
+#include <stdbool.h>
+
+#include "expr.h"
+
+/*
+ * Infers the type of every node bottom-up and stores it in Expr.type, so
+ * the evaluators can skip tag checks on operands whose type is proven.
+ * Parameters are TYPE_DYNAMIC, as are operations that may produce more than
+ * one type.
+ *
+ * A type error in code that always runs is reported at its line and makes
+ * the whole expression fail. Inside a branch of '?:' or a function body
+ * it is left for the evaluator to report, since that may never run.
+ */
+bool TypeCheck(Expr *expr);
+
+#endif